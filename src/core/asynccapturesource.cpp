@@ -0,0 +1,128 @@
+#include "asynccapturesource.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+AsyncCaptureSource::AsyncCaptureSource(FrameSource* inner, int intervalMs, const QSize& frameSize)
+    : source(inner), interval(intervalMs)
+{
+    for (FrameSlot& slot : frameSlots) {
+        slot.frame = FrameBufferPool::shared().acquire(frameSize.width(), frameSize.height());
+    }
+}
+
+AsyncCaptureSource::~AsyncCaptureSource()
+{
+    stopCapture();
+}
+
+void AsyncCaptureSource::startCapture()
+{
+    if (captureThread) {
+        return;
+    }
+
+    {
+        // 丢弃上一次截图会话留下的帧，避免消费者拿到过期画面
+        QMutexLocker locker(&readMutex);
+        for (FrameSlot& slot : frameSlots) {
+            slot.sequence = 0;
+            slot.timestamp = 0;
+        }
+        writeIndex = 0;
+        readIndex = 2;
+        sharedState.store(1);
+        readSequence = 0;
+        readTimestamp = 0;
+        publishedSequence.store(0);
+    }
+
+    stopRequested.store(false);
+    captureThread = QThread::create([this]() { captureLoop(); });
+    captureThread->start();
+    qDebug() << QString("异步截图线程已启动，间隔%1ms").arg(interval.load());
+}
+
+void AsyncCaptureSource::stopCapture()
+{
+    if (!captureThread) {
+        return;
+    }
+
+    stopRequested.store(true);
+    captureThread->wait();
+    delete captureThread;
+    captureThread = nullptr;
+    qDebug() << "异步截图线程已停止";
+}
+
+void AsyncCaptureSource::captureLoop()
+{
+    QElapsedTimer frameTimer;
+    while (!stopRequested.load()) {
+        frameTimer.start();
+
+        // 写缓冲区只属于截图线程；若消费者仍持有该缓冲区的旧帧，grabInto会换一块池缓冲区
+        FrameSlot& slot = frameSlots[writeIndex];
+        if (source->grabInto(slot.frame)) {
+            slot.sequence = nextSequence++;
+            slot.timestamp = source->timestamp();
+            publish();
+        }
+
+        qint64 remaining = interval.load() - frameTimer.elapsed();
+        if (remaining > 0) {
+            QThread::msleep(static_cast<unsigned long>(remaining));
+        }
+    }
+}
+
+void AsyncCaptureSource::publish()
+{
+    // 把写好的缓冲区换到中间位置，换回上一个中间缓冲区继续写
+    const quint64 sequence = frameSlots[writeIndex].sequence;
+    int previous = sharedState.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+    writeIndex = previous & INDEX_MASK;
+    publishedSequence.store(sequence);
+
+    QMutexLocker locker(&frameMutex);
+    frameArrived.wakeAll();
+}
+
+QImage AsyncCaptureSource::grab()
+{
+    QMutexLocker locker(&readMutex);
+
+    if (readSequence == 0 && !(sharedState.load(std::memory_order_acquire) & FRESH_BIT)) {
+        if (!waitForFrameAfter(0, firstFrameTimeoutMs)) {
+            qDebug() << "异步截图等待首帧超时";
+            return QImage();
+        }
+    }
+
+    // 中间缓冲区有新帧时与读缓冲区交换，否则继续返回上次的最新帧
+    if (sharedState.load(std::memory_order_acquire) & FRESH_BIT) {
+        int previous = sharedState.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+    }
+
+    const FrameSlot& slot = frameSlots[readIndex];
+    readSequence = slot.sequence;
+    readTimestamp = slot.timestamp;
+    return slot.frame.toImage();
+}
+
+bool AsyncCaptureSource::waitForFrameAfter(quint64 afterSequence, int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QMutexLocker locker(&frameMutex);
+    while (publishedSequence.load() <= afterSequence) {
+        qint64 remaining = timeoutMs - timer.elapsed();
+        if (remaining <= 0) {
+            return false;
+        }
+        frameArrived.wait(&frameMutex, static_cast<unsigned long>(remaining));
+    }
+    return true;
+}
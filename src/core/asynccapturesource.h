@@ -0,0 +1,77 @@
+#ifndef ASYNCCAPTURESOURCE_H
+#define ASYNCCAPTURESOURCE_H
+
+#include "framesource.h"
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+
+// 异步截图帧源：独立线程按固定间隔从底层帧源截图，通过三缓冲交给识别线程
+// 截图线程和消费者之间的交接只用一次原子交换，消费者总能立即拿到最新的完整帧
+// 帧像素位于FrameBufferPool中，消费者持有的帧不会被截图线程改写
+class AsyncCaptureSource : public FrameSource
+{
+public:
+    // 底层帧源只由截图线程访问，所有权由调用方保留
+    // 三个缓冲区按frameSize从缓冲池预先获取，截图时直接写入
+    explicit AsyncCaptureSource(FrameSource* inner, int intervalMs = 10, const QSize& frameSize = QSize(950, 596));
+    ~AsyncCaptureSource() override;
+
+    void setInterval(int intervalMs) { interval.store(intervalMs); }
+    int intervalMs() const { return interval.load(); }
+
+    // 启动/停止截图线程，停止后保留最后一帧
+    void startCapture();
+    void stopCapture();
+    bool isCapturing() const { return captureThread != nullptr; }
+
+    // 返回最新发布的帧，不等待截图；尚未发布任何帧时最多等待firstFrameTimeoutMs
+    QImage grab() override;
+    qint64 timestamp() const override { return readTimestamp; }
+
+    // 最近一次grab()返回的帧序号，从1开始，0表示还没有帧
+    quint64 sequence() const { return readSequence; }
+    // 截图线程已发布的最新帧序号
+    quint64 latestSequence() const { return publishedSequence.load(); }
+    // 等待序号大于afterSequence的帧发布（用于操作后需要新画面的场景），超时返回false
+    bool waitForFrameAfter(quint64 afterSequence, int timeoutMs);
+
+    static const int firstFrameTimeoutMs = 500;
+
+private:
+    struct FrameSlot {
+        FrameHandle frame;
+        quint64 sequence = 0;
+        qint64 timestamp = 0;
+    };
+
+    // sharedState低2位是中间缓冲区下标，FRESH_BIT表示中间缓冲区有未读的新帧
+    static const int INDEX_MASK = 0x3;
+    static const int FRESH_BIT = 0x4;
+
+    void captureLoop();
+    void publish();
+
+    FrameSource* source;
+    QThread* captureThread = nullptr;
+    FrameSlot frameSlots[3];
+    std::atomic<int> sharedState{1};
+    int writeIndex = 0;     // 仅截图线程访问
+    int readIndex = 2;      // 仅在readMutex保护下访问
+    quint64 readSequence = 0;
+    qint64 readTimestamp = 0;
+    quint64 nextSequence = 1;
+
+    std::atomic<int> interval;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<quint64> publishedSequence{0};
+
+    // 多个消费者线程之间互斥，不与截图线程竞争
+    QMutex readMutex;
+    // 仅用于waitForFrameAfter等待新帧，截图线程发布时唤醒
+    QMutex frameMutex;
+    QWaitCondition frameArrived;
+};
+
+#endif // ASYNCCAPTURESOURCE_H
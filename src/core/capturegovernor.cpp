@@ -0,0 +1,189 @@
+#include "capturegovernor.h"
+#include "stoptoken.h"
+#include <QtMath>
+
+namespace {
+
+const int SIGNATURE_ROW_STEP = 8;   // 大画面每8行抽样一行
+const int SIGNATURE_FULL_PIXELS = 256 * 256; // 不超过该像素数的画面和区域逐行计算，小区域的变化常常只有几行
+const double CPU_BURST_SECONDS = 0.25; // 允许短时间突发的CPU耗时占每秒预算的比例
+const int STOP_POLL_MS = 20;        // 等待期间检查停止令牌的间隔
+
+} // namespace
+
+CaptureGovernor::CaptureGovernor(const CaptureBudget& budget) : limits(budget)
+{
+    clock.start();
+    currentInterval = minIntervalMs();
+}
+
+void CaptureGovernor::setBudget(const CaptureBudget& budget)
+{
+    QMutexLocker locker(&mutex);
+    limits = budget;
+    currentInterval = qBound(minIntervalMs(), currentInterval, qMax(minIntervalMs(), limits.idleIntervalMs));
+    inputArrived.wakeAll();
+}
+
+CaptureBudget CaptureGovernor::budget() const
+{
+    QMutexLocker locker(&mutex);
+    return limits;
+}
+
+int CaptureGovernor::minIntervalMs() const
+{
+    return limits.maxCapturesPerSecond > 0 ? qCeil(1000.0 / limits.maxCapturesPerSecond) : 0;
+}
+
+qint64 CaptureGovernor::pendingDelayLocked(qint64 now)
+{
+    // 漏桶按预算速率消化CPU耗时
+    if (limits.maxCpuMsPerSecond > 0) {
+        cpuDebtMs = qMax(0.0, cpuDebtMs - (now - lastDecayAt) * limits.maxCpuMsPerSecond / 1000.0);
+    }
+    lastDecayAt = now;
+
+    qint64 delay = 0;
+    if (lastCaptureAt >= 0) {
+        delay = currentInterval - (now - lastCaptureAt);
+    }
+    const double burst = limits.maxCpuMsPerSecond * CPU_BURST_SECONDS;
+    if (limits.maxCpuMsPerSecond > 0 && cpuDebtMs > burst) {
+        delay = qMax(delay, static_cast<qint64>((cpuDebtMs - burst) * 1000.0 / limits.maxCpuMsPerSecond));
+    }
+    return qMax<qint64>(delay, 0);
+}
+
+void CaptureGovernor::acquire()
+{
+    const std::shared_ptr<StopToken> stop = StopToken::current();
+    QElapsedTimer timer;
+    timer.start();
+
+    // 每次醒来都重新计算需要等待的时间，等待期间的notifyInput()会缩短等待；
+    // 按停止令牌的检查间隔分段等待，会话停止后不再推迟截图
+    QMutexLocker locker(&mutex);
+    qint64 delay = pendingDelayLocked(clock.elapsed());
+    while (delay > 0 && !(stop && stop->stopRequested())) {
+        inputArrived.wait(&mutex, static_cast<unsigned long>(qMin<qint64>(delay, STOP_POLL_MS)));
+        delay = pendingDelayLocked(clock.elapsed());
+    }
+
+    throttled += timer.elapsed();
+    lastCaptureAt = clock.elapsed();
+}
+
+void CaptureGovernor::record(qint64 costUs, quint64 signature)
+{
+    QMutexLocker locker(&mutex);
+    captureCount++;
+    totalCostUs += costUs;
+    cpuDebtMs += costUs / 1000.0;
+
+    // 签名的低32位是画面布局（整窗为尺寸，多区域为全部区域位置和尺寸），同布局的截图之间比较
+    const quint64 layoutKey = signature & 0xffffffffu;
+    auto it = lastSignatures.find(layoutKey);
+    const bool changed = it == lastSignatures.end() || it.value() != signature;
+    lastSignatures.insert(layoutKey, signature);
+
+    const int fastest = minIntervalMs();
+    const int slowest = qMax(fastest, limits.idleIntervalMs);
+    if (changed) {
+        changes++;
+        currentInterval = fastest;
+    } else {
+        // 画面静止时每次放慢一半，直到空闲间隔
+        currentInterval = qMin(slowest, qMax(currentInterval + 1, currentInterval * 3 / 2));
+    }
+}
+
+quint64 CaptureGovernor::changeCount() const
+{
+    QMutexLocker locker(&mutex);
+    return changes;
+}
+
+void CaptureGovernor::notifyInput()
+{
+    QMutexLocker locker(&mutex);
+    currentInterval = minIntervalMs();
+    // 正在按静止间隔等待的截图线程立即按新间隔重新计算
+    inputArrived.wakeAll();
+}
+
+void CaptureGovernor::reset()
+{
+    QMutexLocker locker(&mutex);
+    clock.restart();
+    lastCaptureAt = -1;
+    lastDecayAt = 0;
+    cpuDebtMs = 0;
+    currentInterval = minIntervalMs();
+    lastSignatures.clear();
+    captureCount = 0;
+    totalCostUs = 0;
+    throttled = 0;
+    inputArrived.wakeAll();
+}
+
+int CaptureGovernor::intervalMs() const
+{
+    QMutexLocker locker(&mutex);
+    return currentInterval;
+}
+
+CaptureGovernor::Usage CaptureGovernor::usage() const
+{
+    QMutexLocker locker(&mutex);
+    Usage result;
+    const double seconds = qMax<qint64>(clock.elapsed(), 1) / 1000.0;
+    result.captures = captureCount;
+    result.capturesPerSecond = captureCount / seconds;
+    result.cpuMsPerSecond = totalCostUs / 1000.0 / seconds;
+    result.throttledMs = throttled;
+    result.currentIntervalMs = currentInterval;
+    return result;
+}
+
+quint64 CaptureGovernor::signature(const uchar* bits, int bytesPerLine, int width, int height)
+{
+    if (!bits || width <= 0 || height <= 0) {
+        return 0;
+    }
+    const size_t rowBytes = static_cast<size_t>(width) * 4;
+    const int step = width * height <= SIGNATURE_FULL_PIXELS ? 1 : SIGNATURE_ROW_STEP;
+    uint hash = 0;
+    for (int y = 0; y < height; y += step) {
+        hash = qHashBits(bits + static_cast<size_t>(y) * bytesPerLine, rowBytes, hash);
+    }
+    // 最后一行单独计入
+    if ((height - 1) % step != 0) {
+        hash = qHashBits(bits + static_cast<size_t>(height - 1) * bytesPerLine, rowBytes, hash);
+    }
+    return (quint64(hash) << 32) | (quint64(quint16(width)) << 16) | quint64(quint16(height));
+}
+
+quint64 CaptureGovernor::signature(const QImage& image)
+{
+    if (image.isNull() || image.depth() != 32) {
+        return 0;
+    }
+    return signature(image.constBits(), image.bytesPerLine(), image.width(), image.height());
+}
+
+quint64 CaptureGovernor::signature(const RegionFrame& frame)
+{
+    uint hash = 0;
+    uint layout = 0;
+    for (int i = 0; i < frame.count(); ++i) {
+        const QImage image = frame.image(i);
+        hash ^= uint(signature(image) >> 32) + 0x9e3779b9u + (hash << 6) + (hash >> 2);
+        const QRect region = frame.region(i);
+        layout = qHash(region.x(), layout);
+        layout = qHash(region.y(), layout);
+        layout = qHash(region.width() << 16 | region.height(), layout);
+    }
+    // 最高位置1，与整窗截图的尺寸（宽度不超过15位）区分开
+    return (quint64(hash) << 32) | layout | 0x80000000u;
+}
@@ -0,0 +1,81 @@
+#ifndef CAPTUREGOVERNOR_H
+#define CAPTUREGOVERNOR_H
+
+#include "framesource.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QWaitCondition>
+
+// 截图预算：每秒截图次数和每秒截图CPU耗时的上限
+struct CaptureBudget
+{
+    double maxCapturesPerSecond = 30.0;
+    double maxCpuMsPerSecond = 150.0;
+    int idleIntervalMs = 200;   // 画面静止时的最长截图间隔
+};
+
+// 截图节流器：所有游戏窗口截图都先经过acquire()，截图后用record()报告耗时和画面签名
+// 画面连续变化时按预算允许的最短间隔截图，画面静止时逐步放慢到idleIntervalMs，输入操作后立即恢复快速截图
+// CPU耗时按漏桶计算，超出预算时推迟下一次截图，保证多开时每个账号的CPU占用可预期
+class CaptureGovernor
+{
+public:
+    struct Usage {
+        quint64 captures = 0;
+        double capturesPerSecond = 0;   // 会话平均
+        double cpuMsPerSecond = 0;      // 会话平均
+        qint64 throttledMs = 0;         // 因预算或画面静止而推迟的总时长
+        int currentIntervalMs = 0;
+    };
+
+    explicit CaptureGovernor(const CaptureBudget& budget = CaptureBudget());
+
+    void setBudget(const CaptureBudget& budget);
+    CaptureBudget budget() const;
+
+    // 截图前调用，按需要等待，等待期间notifyInput()会立即唤醒；当前线程绑定的会话令牌请求停止时不再等待
+    void acquire();
+    // 截图后调用，costUs为本次截图（含签名计算）的耗时
+    void record(qint64 costUs, quint64 signature);
+    // 点击/拖动后界面即将变化，恢复最短截图间隔
+    void notifyInput();
+
+    // 当前两次截图之间的间隔，画面静止时逐步放慢到idleIntervalMs
+    int intervalMs() const;
+
+    // 画面变化计数，每次截图发现画面与上一次不同时加一；两次读取之间不变说明画面静止
+    quint64 changeCount() const;
+
+    // 开始新的统计会话
+    void reset();
+    Usage usage() const;
+
+    // 计算画面签名，只用于判断画面是否变化；小画面和区域逐行计算，整窗截图隔行抽样
+    static quint64 signature(const uchar* bits, int bytesPerLine, int width, int height);
+    static quint64 signature(const QImage& image);
+    // 多区域截图按全部区域的位置和尺寸区分，不与整窗截图和其他区域组合互相比较
+    static quint64 signature(const RegionFrame& frame);
+
+private:
+    qint64 pendingDelayLocked(qint64 now);
+    int minIntervalMs() const;
+
+    mutable QMutex mutex;
+    QWaitCondition inputArrived;    // notifyInput()唤醒正在acquire()中等待的线程
+    CaptureBudget limits;
+    QElapsedTimer clock;
+    qint64 lastCaptureAt = -1;
+    qint64 lastDecayAt = 0;
+    double cpuDebtMs = 0;           // 漏桶中尚未消化的CPU耗时
+    int currentInterval = 0;
+    QHash<quint64, quint64> lastSignatures; // 画面布局 -> 上一次签名，整窗和各区域组合分开比较
+
+    quint64 changes = 0;
+    quint64 captureCount = 0;
+    qint64 totalCostUs = 0;
+    qint64 throttled = 0;
+};
+
+#endif // CAPTUREGOVERNOR_H
@@ -0,0 +1,70 @@
+#include "clickverifier.h"
+#include "settledetector.h"
+#include <QDebug>
+#include <QElapsedTimer>
+
+ClickVerifier::ClickVerifier(RegionGrabber grabber, ClickFunction click, Sleeper sleeper)
+    : grabRegion(std::move(grabber)), clickAt(std::move(click)), sleep(std::move(sleeper))
+{
+}
+
+ClickReaction ClickVerifier::click(const QPoint& position, const QRect& region, const Options& options)
+{
+    counters.clicks++;
+    ClickReaction reaction;
+
+    // 没有点击前的区域图像就无法判断变化，与空图像比较会被误判为已变化；截不到时不点击，按未生效返回
+    QElapsedTimer timer;
+    timer.start();
+    QImage before = grabRegion(region);
+    while (before.isNull() && timer.elapsed() < options.reactionTimeoutMs) {
+        if (!sleep(options.pollIntervalMs)) {
+            break;
+        }
+        before = grabRegion(region);
+    }
+    if (before.isNull()) {
+        counters.unresponsive++;
+        qDebug() << QString("点击(%1,%2)前无法截取观察区域，未点击").arg(position.x()).arg(position.y());
+        return reaction;
+    }
+
+    timer.restart();
+    clickAt(position);
+
+    while (timer.elapsed() < options.timeoutMs) {
+        if (!sleep(options.pollIntervalMs)) {
+            break;
+        }
+        reaction.after = grabRegion(region);
+        if (reaction.after.isNull()) {
+            continue;
+        }
+
+        if (!reaction.changed && SettleDetector::regionDifference(before, reaction.after, QRect()) > options.threshold) {
+            reaction.changed = true;
+        }
+        reaction.matched = options.expected ? options.expected(reaction.after) : reaction.changed;
+        if (reaction.matched) {
+            reaction.latencyMs = int(timer.elapsed());
+            counters.totalLatencyMs += reaction.latencyMs;
+            counters.maxLatencyMs = qMax(counters.maxLatencyMs, reaction.latencyMs);
+            return reaction;
+        }
+
+        if (!reaction.changed && timer.elapsed() >= options.reactionTimeoutMs) {
+            break;
+        }
+    }
+
+    if (reaction.changed) {
+        counters.mismatched++;
+        qDebug() << QString("点击(%1,%2)后区域已变化但未达到期望状态，等待%3ms")
+                    .arg(position.x()).arg(position.y()).arg(timer.elapsed());
+    } else {
+        counters.unresponsive++;
+        qDebug() << QString("点击(%1,%2)后%3ms内区域无变化，点击未生效")
+                    .arg(position.x()).arg(position.y()).arg(timer.elapsed());
+    }
+    return reaction;
+}
@@ -0,0 +1,67 @@
+#ifndef CLICKVERIFIER_H
+#define CLICKVERIFIER_H
+
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <functional>
+
+// 点击反应结果
+struct ClickReaction {
+    bool changed = false;   // 点击后观察区域发生了变化
+    bool matched = false;   // 观察区域符合期望状态（未提供期望状态时与changed相同）
+    int latencyMs = -1;     // 点击到观察区域变化（或符合期望）的耗时，未反应为-1
+    QImage after;           // 结束时观察区域的图像
+};
+
+// 点击确认：点击前只截取预期会变化的区域，点击后逐帧比较该区域，
+// 区域变化超过阈值或符合期望状态即返回，不再固定等待后整帧重新识别
+// 在反应超时内区域完全没有变化视为点击未生效，立即返回由调用方重试
+// 点击前截不到观察区域时不点击，同样按未生效返回
+class ClickVerifier
+{
+public:
+    using RegionGrabber = std::function<QImage(const QRect& region)>;
+    using ClickFunction = std::function<void(const QPoint& position)>;
+    // 等待被中断（会话已停止）时返回false，调用方立即结束
+    using Sleeper = std::function<bool(int ms)>;
+    // 判断区域图像是否为期望的点击后状态，如配方槽哈希与目标配方一致
+    using StateMatcher = std::function<bool(const QImage& region)>;
+
+    struct Options {
+        int timeoutMs = 2000;           // 等待期望状态的最长时间
+        int reactionTimeoutMs = 500;    // 区域没有任何变化时提前放弃的时间
+        int pollIntervalMs = 5;
+        double threshold = 2.0;         // 区域灰度平均绝对差超过该值视为变化
+        StateMatcher expected;          // 为空时区域变化即返回
+    };
+
+    struct Stats {
+        int clicks = 0;
+        int unresponsive = 0;   // 反应超时内区域没有变化
+        int mismatched = 0;     // 区域变化但未达到期望状态
+        qint64 totalLatencyMs = 0;
+        int maxLatencyMs = 0;
+
+        double averageLatencyMs() const
+        {
+            const int reacted = clicks - unresponsive - mismatched;
+            return reacted > 0 ? double(totalLatencyMs) / reacted : 0.0;
+        }
+    };
+
+    ClickVerifier(RegionGrabber grabber, ClickFunction click, Sleeper sleeper);
+
+    ClickReaction click(const QPoint& position, const QRect& region, const Options& options = Options());
+
+    Stats stats() const { return counters; }
+    void resetStats() { counters = Stats(); }
+
+private:
+    RegionGrabber grabRegion;
+    ClickFunction clickAt;
+    Sleeper sleep;
+    Stats counters;
+};
+
+#endif // CLICKVERIFIER_H
@@ -0,0 +1,103 @@
+#include "frameanalyzer.h"
+#include <QRunnable>
+#include <cstring>
+
+namespace {
+
+class FrameJobRunnable : public QRunnable
+{
+public:
+    explicit FrameJobRunnable(std::function<void()> task) : task(std::move(task)) {}
+    void run() override { task(); }
+
+private:
+    std::function<void()> task;
+};
+
+} // namespace
+
+FrameAnalyzer::FrameAnalyzer(int threadCount)
+{
+    pool.setMaxThreadCount(threadCount);
+    // 识别任务间隔很短，保持线程常驻避免反复创建
+    pool.setExpiryTimeout(-1);
+}
+
+FrameAnalyzer::~FrameAnalyzer()
+{
+    pool.waitForDone();
+}
+
+QVector<QVariant> FrameAnalyzer::run(const QImage& frame, const QVector<FrameJob>& jobs)
+{
+    QVector<QVariant> results(jobs.size());
+    if (jobs.isEmpty()) {
+        return results;
+    }
+
+    // 各任务只写入自己的结果槽，帧数据只读共享
+    QVariant* output = results.data();
+    QSemaphore finished;
+    const int pooledCount = jobs.size() - 1;
+    for (int i = 0; i < pooledCount; ++i) {
+        const FrameJob& job = jobs[i];
+        pool.start(new FrameJobRunnable([&frame, &job, &finished, output, i]() {
+            output[i] = job(frame);
+            finished.release();
+        }));
+    }
+
+    output[pooledCount] = jobs[pooledCount](frame);
+    finished.acquire(pooledCount);
+    return results;
+}
+
+PendingFrameResult FrameAnalyzer::submit(const QImage& frame, const FrameJob& job)
+{
+    PendingFrameResult pending;
+    pending.state = std::make_shared<PendingFrameResult::State>();
+
+    // 帧和任务按值捕获，调用方可以立即复用自己的截图变量
+    std::shared_ptr<PendingFrameResult::State> state = pending.state;
+    pool.start(new FrameJobRunnable([frame, job, state]() {
+        state->result = job(frame);
+        state->finished.release();
+    }));
+    return pending;
+}
+
+QVariant PendingFrameResult::wait()
+{
+    if (!state) {
+        return QVariant();
+    }
+    // 允许多次调用wait()
+    state->finished.acquire();
+    state->finished.release();
+    return state->result;
+}
+
+FrameScratch& FrameAnalyzer::threadScratch()
+{
+    thread_local FrameScratch scratch;
+    return scratch;
+}
+
+const QImage& FrameScratch::crop(const QImage& frame, const QRect& rect)
+{
+    if (frame.isNull() || rect.isEmpty() || !frame.rect().contains(rect)) {
+        region = QImage();
+        return region;
+    }
+
+    // 尺寸和格式不变且没有被外部引用时直接覆盖像素
+    if (region.size() != rect.size() || region.format() != frame.format() || !region.isDetached()) {
+        region = QImage(rect.size(), frame.format());
+    }
+    const int bytesPerPixel = frame.depth() / 8;
+    const int rowBytes = rect.width() * bytesPerPixel;
+    for (int y = 0; y < rect.height(); ++y) {
+        memcpy(region.scanLine(y), frame.constScanLine(rect.y() + y) + rect.x() * bytesPerPixel, rowBytes);
+    }
+    return region;
+}
@@ -0,0 +1,67 @@
+#ifndef FRAMEANALYZER_H
+#define FRAMEANALYZER_H
+
+#include <QImage>
+#include <QRect>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <QVariant>
+#include <QVector>
+#include <functional>
+#include <memory>
+
+// 单帧识别任务：只读访问同一帧截图，返回识别结果
+// 任务内不操作游戏、不写共享状态，识别记录等副作用由调用方在拿到结果后完成
+using FrameJob = std::function<QVariant(const QImage& frame)>;
+
+// 每个线程一份的识别临时缓冲区，任务中裁剪ROI时复用，同一尺寸的区域不再每帧重新分配
+class FrameScratch
+{
+public:
+    // 把frame中rect区域复制到本线程的缓冲区并返回；rect超出画面时返回空图像
+    // 返回的图像在本线程下一次调用crop之前有效
+    const QImage& crop(const QImage& frame, const QRect& rect);
+
+private:
+    QImage region;
+};
+
+// 异步提交的识别任务句柄，wait()阻塞到任务完成并返回结果
+class PendingFrameResult
+{
+public:
+    bool isValid() const { return state != nullptr; }
+    QVariant wait();
+
+private:
+    friend class FrameAnalyzer;
+    struct State {
+        QSemaphore finished;
+        QVariant result;
+    };
+    std::shared_ptr<State> state;
+};
+
+// 单帧多识别器并行执行：同一帧上的多个识别任务在固定大小的线程池中并发运行，
+// 总耗时接近最慢的单个任务而不是所有任务之和；整页背包识别等耗时任务也可异步提交
+class FrameAnalyzer
+{
+public:
+    explicit FrameAnalyzer(int threadCount = 3);
+    ~FrameAnalyzer();
+
+    // 全部任务完成后按提交顺序返回结果
+    // 最后一个任务在调用线程执行，只有一个任务时不经过线程池
+    QVector<QVariant> run(const QImage& frame, const QVector<FrameJob>& jobs);
+
+    // 异步提交单个任务后立即返回，调用方可在识别的同时继续操作游戏（如翻页）
+    PendingFrameResult submit(const QImage& frame, const FrameJob& job);
+
+    // 当前线程的临时缓冲区（线程池线程和调用线程各一份）
+    static FrameScratch& threadScratch();
+
+private:
+    QThreadPool pool;
+};
+
+#endif // FRAMEANALYZER_H
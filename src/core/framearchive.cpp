@@ -0,0 +1,425 @@
+#include "framearchive.h"
+#include "sessionrecorder.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QtEndian>
+#include <cstring>
+
+using namespace FrameArchiveFormat;
+
+namespace {
+
+// 把图像统一转换为ARGB32_Premultiplied后切块
+QImage normalizedImage(const QImage& image)
+{
+    if (image.format() == QImage::Format_ARGB32_Premultiplied) {
+        return image;
+    }
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+int tilesAcross(int length)
+{
+    return (length + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+QRect tileRect(int tileIndex, const QSize& size)
+{
+    const int columns = tilesAcross(size.width());
+    const int x = (tileIndex % columns) * TILE_SIZE;
+    const int y = (tileIndex / columns) * TILE_SIZE;
+    return QRect(x, y, qMin(TILE_SIZE, size.width() - x), qMin(TILE_SIZE, size.height() - y));
+}
+
+template <typename T>
+T readValue(const uchar* data)
+{
+    return qFromLittleEndian<T>(data);
+}
+
+} // namespace
+
+// ==================== FrameArchive ====================
+
+FrameArchive::~FrameArchive()
+{
+    close();
+}
+
+bool FrameArchive::open(const QString& path)
+{
+    close();
+
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "帧归档打开失败:" << path;
+        return false;
+    }
+    mappedSize = file.size();
+    mapped = mappedSize > 0 ? file.map(0, mappedSize) : nullptr;
+    if (!mapped || mappedSize < HEADER_SIZE
+        || readValue<quint32>(mapped) != MAGIC || readValue<quint16>(mapped + 4) != VERSION) {
+        qDebug() << "帧归档格式不支持:" << path;
+        close();
+        return false;
+    }
+
+    // 只读取记录头建立索引，像素数据在访问时才解压
+    qint64 offset = HEADER_SIZE;
+    while (offset + RECORD_HEADER_SIZE <= mappedSize) {
+        const quint8 type = mapped[offset];
+        const quint32 payloadSize = readValue<quint32>(mapped + offset + 1);
+        const qint64 payload = offset + RECORD_HEADER_SIZE;
+        if (payload + payloadSize > mappedSize) {
+            qDebug() << "帧归档末尾记录不完整，已忽略";
+            break;
+        }
+
+        const uchar* p = mapped + payload;
+        if (type == TileRecord) {
+            tiles.insert(readValue<quint64>(p), payload);
+        } else if (type == FrameRecord || type == AliasRecord) {
+            FrameEntry entry;
+            entry.offset = payload;
+            entry.info.contentKey = readValue<quint64>(p);
+            entry.info.timestamp = readValue<qint64>(p + 8);
+            const int reference = readValue<qint32>(p + 16);
+            const quint16 labelLength = readValue<quint16>(p + 20);
+            entry.info.label = QString::fromUtf8(reinterpret_cast<const char*>(p + 22), labelLength);
+            const uchar* rest = p + 22 + labelLength;
+            if (type == FrameRecord) {
+                entry.contentFrame = frames.size();
+                entry.baseFrame = reference;
+                entry.info.size = QSize(readValue<quint16>(rest), readValue<quint16>(rest + 2));
+            } else if (reference >= 0 && reference < frames.size()) {
+                entry.contentFrame = frames[reference].contentFrame;
+                entry.info.size = frames[reference].info.size;
+            }
+            frames.append(entry);
+        }
+        offset = payload + payloadSize;
+    }
+    validSize = offset;
+
+    qDebug() << QString("帧归档加载完成：%1，帧%2，块%3").arg(path).arg(frames.size()).arg(tiles.size());
+    return true;
+}
+
+void FrameArchive::close()
+{
+    if (mapped) {
+        file.unmap(mapped);
+        mapped = nullptr;
+    }
+    mappedSize = 0;
+    validSize = 0;
+    file.close();
+    tiles.clear();
+    frames.clear();
+    current = -1;
+}
+
+FrameArchive::FrameInfo FrameArchive::frameInfo(int index) const
+{
+    return frames.value(index).info;
+}
+
+QVector<quint64> FrameArchive::tileKeys(int index) const
+{
+    if (index < 0 || index >= frames.size() || frames[index].contentFrame < 0) {
+        return QVector<quint64>();
+    }
+
+    // 从目标帧沿基准链回溯到关键帧，再按顺序应用各帧的变化块
+    QVector<int> chain;
+    for (int i = frames[index].contentFrame; i >= 0; i = frames[i].baseFrame) {
+        chain.prepend(i);
+    }
+
+    const QSize size = frames[index].info.size;
+    QVector<quint64> keys(tilesAcross(size.width()) * tilesAcross(size.height()), 0);
+    for (int i : chain) {
+        const FrameEntry& entry = frames[i];
+        const uchar* p = mapped + entry.offset + 22 + readValue<quint16>(mapped + entry.offset + 20) + 4;
+        const quint32 changed = readValue<quint32>(p);
+        p += 4;
+        for (quint32 c = 0; c < changed; ++c, p += 12) {
+            const quint32 tileIndex = readValue<quint32>(p);
+            if (int(tileIndex) < keys.size()) {
+                keys[tileIndex] = readValue<quint64>(p + 4);
+            }
+        }
+    }
+    return keys;
+}
+
+QImage FrameArchive::decodeTile(quint64 key) const
+{
+    auto it = tiles.constFind(key);
+    if (it == tiles.constEnd()) {
+        return QImage();
+    }
+    const uchar* p = mapped + it.value();
+    const quint32 payloadSize = readValue<quint32>(p - 4);
+    const int width = readValue<quint16>(p + 8);
+    const int height = readValue<quint16>(p + 10);
+    QByteArray raw = qUncompress(p + 12, int(payloadSize) - 12);
+    if (raw.size() != width * height * 4) {
+        return QImage();
+    }
+
+    QImage tile(width, height, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < height; ++y) {
+        memcpy(tile.scanLine(y), raw.constData() + y * width * 4, width * 4);
+    }
+    return tile;
+}
+
+QImage FrameArchive::frame(int index) const
+{
+    const QVector<quint64> keys = tileKeys(index);
+    if (keys.isEmpty()) {
+        return QImage();
+    }
+
+    const QSize size = frames[index].info.size;
+    QImage image(size, QImage::Format_ARGB32_Premultiplied);
+    for (int i = 0; i < keys.size(); ++i) {
+        const QRect rect = tileRect(i, size);
+        QImage tile = decodeTile(keys[i]);
+        if (tile.size() != rect.size()) {
+            qDebug() << "帧归档块数据缺失:" << index << i;
+            return QImage();
+        }
+        for (int y = 0; y < rect.height(); ++y) {
+            memcpy(image.scanLine(rect.y() + y) + rect.x() * 4, tile.constScanLine(y), rect.width() * 4);
+        }
+    }
+    return image;
+}
+
+QImage FrameArchive::grab()
+{
+    if (frames.isEmpty()) {
+        return QImage();
+    }
+    if (current + 1 < frames.size()) {
+        current++;
+    }
+    return frame(current);
+}
+
+qint64 FrameArchive::timestamp() const
+{
+    return current >= 0 ? frames[current].info.timestamp : 0;
+}
+
+// ==================== FrameArchiveWriter ====================
+
+FrameArchiveWriter::FrameArchiveWriter(const QString& path, int keyframeInterval)
+    : archivePath(path), keyframeInterval(keyframeInterval)
+{
+}
+
+FrameArchiveWriter::~FrameArchiveWriter()
+{
+    close();
+}
+
+bool FrameArchiveWriter::open()
+{
+    close();
+
+    // 已有归档：读取索引后从最后一条完整记录之后继续追加；连文件头都没写完的文件重新创建
+    if (QFileInfo(archivePath).size() >= HEADER_SIZE) {
+        FrameArchive existing;
+        if (!existing.open(archivePath)) {
+            return false;
+        }
+        const qint64 completeSize = existing.completeSize();
+        for (int i = 0; i < existing.frameCount(); ++i) {
+            storedFrames.insert(existing.frameInfo(i).contentKey, i);
+        }
+        framesWritten = existing.frameCount();
+        if (framesWritten > 0) {
+            previousFrame = framesWritten - 1;
+            previousTiles = existing.tileKeys(previousFrame);
+            previousSize = existing.frameInfo(previousFrame).size;
+            // 续写时从关键帧开始，避免依赖未知长度的增量链
+            deltaCount = keyframeInterval;
+        }
+        for (quint64 key : existing.storedTileKeys()) {
+            storedTiles.insert(key);
+        }
+        // 先解除映射，截掉上次异常退出留下的半条记录，再以追加方式打开
+        existing.close();
+
+        file.setFileName(archivePath);
+        if (file.size() > completeSize) {
+            qDebug() << QString("帧归档末尾有%1字节不完整记录，已截断").arg(file.size() - completeSize);
+            if (!file.resize(completeSize)) {
+                qDebug() << "帧归档截断失败:" << archivePath;
+                return false;
+            }
+        }
+        return file.open(QIODevice::WriteOnly | QIODevice::Append);
+    }
+
+    file.setFileName(archivePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "帧归档创建失败:" << archivePath;
+        return false;
+    }
+    QByteArray header(HEADER_SIZE, '\0');
+    qToLittleEndian<quint32>(MAGIC, header.data());
+    qToLittleEndian<quint16>(VERSION, header.data() + 4);
+    qToLittleEndian<quint16>(quint16(TILE_SIZE), header.data() + 6);
+    file.write(header);
+    return true;
+}
+
+void FrameArchiveWriter::close()
+{
+    if (file.isOpen()) {
+        file.close();
+    }
+    storedTiles.clear();
+    storedFrames.clear();
+    previousTiles.clear();
+    previousSize = QSize();
+    previousFrame = -1;
+    deltaCount = 0;
+    framesWritten = 0;
+}
+
+quint64 FrameArchiveWriter::contentKey(const uchar* bits, int bytesPerLine, int width, int height)
+{
+    quint64 high = 0x9e3779b9u;
+    quint64 low = 0x7f4a7c15u;
+    const size_t rowBytes = size_t(width) * 4;
+    for (int y = 0; y < height; ++y) {
+        const uchar* row = bits + y * bytesPerLine;
+        high = qHashBits(row, rowBytes, uint(high));
+        low = qHashBits(row, rowBytes, uint(low ^ y));
+    }
+    return (high << 32) ^ low ^ (quint64(width) << 48) ^ (quint64(height) << 32);
+}
+
+void FrameArchiveWriter::writeRecord(quint8 type, const QByteArray& payload)
+{
+    char header[RECORD_HEADER_SIZE];
+    header[0] = char(type);
+    qToLittleEndian<quint32>(quint32(payload.size()), header + 1);
+    file.write(header, RECORD_HEADER_SIZE);
+    file.write(payload);
+    // 帧记录是一帧的最后一条记录，写完即落盘，进程异常退出时已写入的帧仍可读取
+    if (type != TileRecord) {
+        file.flush();
+    }
+}
+
+int FrameArchiveWriter::append(const QImage& input, const QString& label, qint64 timestamp)
+{
+    if (!file.isOpen() || input.isNull()) {
+        return -1;
+    }
+    const QImage image = normalizedImage(input);
+    if (timestamp < 0) {
+        timestamp = QDateTime::currentMSecsSinceEpoch();
+    }
+    const QByteArray labelUtf8 = label.toUtf8().left(0xffff);
+
+    auto frameHeader = [&](quint64 key, qint32 reference) {
+        QByteArray payload(22, '\0');
+        qToLittleEndian<quint64>(key, payload.data());
+        qToLittleEndian<qint64>(timestamp, payload.data() + 8);
+        qToLittleEndian<qint32>(reference, payload.data() + 16);
+        qToLittleEndian<quint16>(quint16(labelUtf8.size()), payload.data() + 20);
+        payload.append(labelUtf8);
+        return payload;
+    };
+
+    // 完全相同的画面只写引用记录
+    const quint64 frameKey = contentKey(image.constBits(), image.bytesPerLine(), image.width(), image.height());
+    auto existing = storedFrames.constFind(frameKey);
+    if (existing != storedFrames.constEnd()) {
+        writeRecord(AliasRecord, frameHeader(frameKey, existing.value()));
+        return framesWritten++;
+    }
+
+    // 切块并写出新出现的块
+    const QSize size = image.size();
+    const int blockCount = tilesAcross(size.width()) * tilesAcross(size.height());
+    QVector<quint64> keys(blockCount);
+    for (int i = 0; i < blockCount; ++i) {
+        const QRect rect = tileRect(i, size);
+        const uchar* origin = image.constScanLine(rect.y()) + rect.x() * 4;
+        const quint64 key = contentKey(origin, image.bytesPerLine(), rect.width(), rect.height());
+        keys[i] = key;
+        if (storedTiles.contains(key)) {
+            continue;
+        }
+
+        QByteArray raw(rect.width() * rect.height() * 4, Qt::Uninitialized);
+        for (int y = 0; y < rect.height(); ++y) {
+            memcpy(raw.data() + y * rect.width() * 4, origin + y * image.bytesPerLine(), rect.width() * 4);
+        }
+        QByteArray payload(12, '\0');
+        qToLittleEndian<quint64>(key, payload.data());
+        qToLittleEndian<quint16>(quint16(rect.width()), payload.data() + 8);
+        qToLittleEndian<quint16>(quint16(rect.height()), payload.data() + 10);
+        payload.append(qCompress(raw));
+        writeRecord(TileRecord, payload);
+        storedTiles.insert(key);
+    }
+
+    // 与上一帧尺寸相同且未到关键帧间隔时，只记录变化的块
+    const bool delta = previousFrame >= 0 && previousSize == size && deltaCount < keyframeInterval;
+    QByteArray payload = frameHeader(frameKey, delta ? previousFrame : -1);
+    QByteArray body(8, '\0');
+    qToLittleEndian<quint16>(quint16(size.width()), body.data());
+    qToLittleEndian<quint16>(quint16(size.height()), body.data() + 2);
+    quint32 changed = 0;
+    for (int i = 0; i < blockCount; ++i) {
+        if (delta && previousTiles[i] == keys[i]) {
+            continue;
+        }
+        char entry[12];
+        qToLittleEndian<quint32>(quint32(i), entry);
+        qToLittleEndian<quint64>(keys[i], entry + 4);
+        body.append(entry, 12);
+        changed++;
+    }
+    qToLittleEndian<quint32>(changed, body.data() + 4);
+    payload.append(body);
+    writeRecord(FrameRecord, payload);
+
+    deltaCount = delta ? deltaCount + 1 : 0;
+    previousTiles = keys;
+    previousSize = size;
+    previousFrame = framesWritten;
+    storedFrames.insert(frameKey, framesWritten);
+    return framesWritten++;
+}
+
+int FrameArchiveWriter::appendSession(const QString& sessionPath, const QString& label)
+{
+    SessionPlayer player;
+    if (!player.open(sessionPath)) {
+        return 0;
+    }
+
+    int appended = 0;
+    for (const SessionEvent& event : player.sessionEvents()) {
+        if (event.type != SessionEvent::Frame) {
+            continue;
+        }
+        if (append(player.frame(event.frameKey), label, event.timestamp) >= 0) {
+            appended++;
+        }
+    }
+    file.flush();
+    return appended;
+}
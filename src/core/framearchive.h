@@ -0,0 +1,116 @@
+#ifndef FRAMEARCHIVE_H
+#define FRAMEARCHIVE_H
+
+#include "framesource.h"
+#include <QFile>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QString>
+#include <QVector>
+
+// 帧归档：按内容寻址保存截图和ROI，用于回归测试语料
+// 画面切成32x32的块，块按内容哈希只保存一次；帧只记录相对上一帧变化的块，每隔若干帧写一个完整关键帧；
+// 与已有帧完全相同的画面只写一条引用记录。整个文件只追加写入，读取时内存映射随机访问。
+namespace FrameArchiveFormat {
+const quint32 MAGIC = 0x46564152; // "FVAR"
+const quint16 VERSION = 1;
+const int TILE_SIZE = 32;
+const int HEADER_SIZE = 16;
+const int RECORD_HEADER_SIZE = 5; // quint8类型 + quint32负载长度
+
+enum RecordType : quint8 {
+    TileRecord = 1,     // quint64块哈希, quint16宽, quint16高, qCompress压缩的ARGB32像素
+    FrameRecord = 2,    // 帧头 + 变化块列表(quint32块序号, quint64块哈希)
+    AliasRecord = 3     // 与已有帧内容相同的帧，只记录目标帧序号
+};
+}
+
+// 只读访问归档文件
+class FrameArchive : public FrameSource
+{
+public:
+    struct FrameInfo {
+        QString label;
+        qint64 timestamp = 0;
+        QSize size;
+        quint64 contentKey = 0;
+    };
+
+    FrameArchive() = default;
+    ~FrameArchive() override;
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const { return mapped != nullptr; }
+    // 最后一条完整记录之后的文件位置；进程在写记录中途退出时，之后是不完整的半条记录
+    qint64 completeSize() const { return validSize; }
+
+    int frameCount() const { return frames.size(); }
+    int tileCount() const { return tiles.size(); }
+    QList<quint64> storedTileKeys() const { return tiles.keys(); }
+    FrameInfo frameInfo(int index) const;
+    QImage frame(int index) const;
+    // 该帧每个块的内容哈希（按行优先排列）
+    QVector<quint64> tileKeys(int index) const;
+
+    // 依次返回每一帧，用于基准测试；到末尾后保持最后一帧
+    QImage grab() override;
+    qint64 timestamp() const override;
+    bool atEnd() const override { return current >= frames.size() - 1; }
+    void rewind() { current = -1; }
+
+private:
+    struct FrameEntry {
+        qint64 offset = 0;      // 帧记录负载在文件中的位置
+        int contentFrame = -1;  // 引用记录指向的帧，普通帧为自身
+        int baseFrame = -1;     // 增量帧的基准帧，关键帧为-1
+        FrameInfo info;
+    };
+
+    QImage decodeTile(quint64 key) const;
+
+    QFile file;
+    uchar* mapped = nullptr;
+    qint64 mappedSize = 0;
+    qint64 validSize = 0;
+    QHash<quint64, qint64> tiles;   // 块哈希 -> 块记录负载位置
+    QVector<FrameEntry> frames;
+    int current = -1;
+};
+
+// 向归档追加帧，已存在的文件会先读取索引，截掉末尾不完整的记录后继续追加
+class FrameArchiveWriter
+{
+public:
+    explicit FrameArchiveWriter(const QString& path, int keyframeInterval = 32);
+    ~FrameArchiveWriter();
+
+    bool open();
+    void close();
+    bool isOpen() const { return file.isOpen(); }
+
+    // 追加一帧（整帧或ROI均可），返回帧序号，失败返回-1
+    int append(const QImage& image, const QString& label = QString(), qint64 timestamp = -1);
+    // 把会话录制文件中的所有帧追加到归档，返回追加的帧数
+    int appendSession(const QString& sessionPath, const QString& label = "session");
+    int frameCount() const { return framesWritten; }
+
+    static quint64 contentKey(const uchar* bits, int bytesPerLine, int width, int height);
+
+private:
+    void writeRecord(quint8 type, const QByteArray& payload);
+
+    QString archivePath;
+    int keyframeInterval;
+    QFile file;
+    QSet<quint64> storedTiles;
+    QHash<quint64, int> storedFrames;    // 帧内容哈希 -> 帧序号
+    QVector<quint64> previousTiles;
+    QSize previousSize;
+    int previousFrame = -1;
+    int deltaCount = 0;
+    int framesWritten = 0;
+};
+
+#endif // FRAMEARCHIVE_H
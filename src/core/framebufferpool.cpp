@@ -0,0 +1,195 @@
+#include "framebufferpool.h"
+#include <QDebug>
+
+namespace {
+
+quint64 bufferKey(int width, int height, QImage::Format format)
+{
+    return (quint64(quint32(width)) << 40) | (quint64(quint32(height)) << 16) | quint64(format);
+}
+
+} // namespace
+
+FrameHandle::FrameHandle(FrameBuffer* buffer) : buffer(buffer)
+{
+    if (buffer) {
+        buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+FrameHandle::FrameHandle(const FrameHandle& other) : FrameHandle(other.buffer)
+{
+}
+
+FrameHandle::FrameHandle(FrameHandle&& other) noexcept : buffer(other.buffer)
+{
+    other.buffer = nullptr;
+}
+
+FrameHandle& FrameHandle::operator=(const FrameHandle& other)
+{
+    if (buffer != other.buffer) {
+        FrameHandle copy(other);
+        std::swap(buffer, copy.buffer);
+    }
+    return *this;
+}
+
+FrameHandle& FrameHandle::operator=(FrameHandle&& other) noexcept
+{
+    if (this != &other) {
+        reset();
+        buffer = other.buffer;
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+FrameHandle::~FrameHandle()
+{
+    reset();
+}
+
+void FrameHandle::reset()
+{
+    if (buffer && buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer->pool->release(buffer);
+    }
+    buffer = nullptr;
+}
+
+FrameView FrameHandle::view() const
+{
+    FrameView view;
+    if (buffer) {
+        view.bits = buffer->data;
+        view.width = buffer->width;
+        view.height = buffer->height;
+        view.bytesPerLine = buffer->bytesPerLine;
+    }
+    return view;
+}
+
+QImage FrameHandle::toImage() const
+{
+    if (!buffer) {
+        return QImage();
+    }
+    // QImage持有的引用在其最后一个副本析构时通过releaseImage归还
+    buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    return QImage(static_cast<const uchar*>(buffer->data), buffer->width, buffer->height,
+                  buffer->bytesPerLine, buffer->format, &FrameHandle::releaseImage, buffer);
+}
+
+QImage FrameHandle::toImage(const QRect& subRect) const
+{
+    if (!buffer || !QRect(0, 0, buffer->width, buffer->height).contains(subRect)) {
+        return QImage();
+    }
+    const int bytesPerPixel = QImage::toPixelFormat(buffer->format).bitsPerPixel() / 8;
+    const uchar* origin = buffer->data + subRect.y() * buffer->bytesPerLine + subRect.x() * bytesPerPixel;
+    buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    return QImage(origin, subRect.width(), subRect.height(), buffer->bytesPerLine, buffer->format,
+                  &FrameHandle::releaseImage, buffer);
+}
+
+void FrameHandle::releaseImage(void* info)
+{
+    FrameBuffer* buffer = static_cast<FrameBuffer*>(info);
+    if (buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer->pool->release(buffer);
+    }
+}
+
+FrameBufferPool::FrameBufferPool(int maxIdlePerKey) : maxIdle(maxIdlePerKey)
+{
+}
+
+FrameBufferPool::~FrameBufferPool()
+{
+    trim();
+    if (counters.inUse > 0) {
+        qDebug() << QString("截图缓冲池析构时仍有%1块缓冲区未归还").arg(counters.inUse);
+    }
+}
+
+FrameBufferPool& FrameBufferPool::shared()
+{
+    static FrameBufferPool pool;
+    return pool;
+}
+
+FrameHandle FrameBufferPool::acquire(int width, int height, QImage::Format format)
+{
+    if (width <= 0 || height <= 0) {
+        return FrameHandle();
+    }
+
+    const quint64 key = bufferKey(width, height, format);
+    {
+        QMutexLocker locker(&mutex);
+        auto it = idleBuffers.find(key);
+        if (it != idleBuffers.end() && !it->isEmpty()) {
+            FrameBuffer* buffer = it->takeLast();
+            counters.reuses++;
+            counters.idle--;
+            counters.inUse++;
+            return FrameHandle(buffer);
+        }
+        counters.allocations++;
+        counters.inUse++;
+    }
+
+    const int bitsPerPixel = QImage::toPixelFormat(format).bitsPerPixel();
+    FrameBuffer* buffer = new FrameBuffer;
+    buffer->pool = this;
+    buffer->key = key;
+    buffer->width = width;
+    buffer->height = height;
+    buffer->bytesPerLine = ((width * bitsPerPixel + 31) / 32) * 4; // 与QImage一致按4字节对齐
+    buffer->format = format;
+    buffer->data = new uchar[size_t(buffer->bytesPerLine) * height];
+    return FrameHandle(buffer);
+}
+
+void FrameBufferPool::release(FrameBuffer* buffer)
+{
+    QMutexLocker locker(&mutex);
+    counters.inUse--;
+
+    QVector<FrameBuffer*>& idle = idleBuffers[buffer->key];
+    if (idle.size() >= maxIdle) {
+        locker.unlock();
+        destroy(buffer);
+        return;
+    }
+    if (idle.capacity() < maxIdle) {
+        idle.reserve(maxIdle);  // 只在该尺寸第一次归还时分配
+    }
+    idle.append(buffer);
+    counters.idle++;
+}
+
+FrameBufferPool::Stats FrameBufferPool::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+void FrameBufferPool::trim()
+{
+    QMutexLocker locker(&mutex);
+    for (QVector<FrameBuffer*>& idle : idleBuffers) {
+        for (FrameBuffer* buffer : idle) {
+            destroy(buffer);
+        }
+    }
+    idleBuffers.clear();
+    counters.idle = 0;
+}
+
+void FrameBufferPool::destroy(FrameBuffer* buffer)
+{
+    delete[] buffer->data;
+    delete buffer;
+}
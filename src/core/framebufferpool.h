@@ -0,0 +1,111 @@
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QRect>
+#include <QVector>
+#include <atomic>
+
+class FrameBufferPool;
+
+// 池中的一块像素缓冲区，由FrameHandle引用计数管理
+struct FrameBuffer
+{
+    FrameBufferPool* pool = nullptr;
+    quint64 key = 0;
+    int width = 0;
+    int height = 0;
+    int bytesPerLine = 0;
+    QImage::Format format = QImage::Format_Invalid;
+    uchar* data = nullptr;
+    std::atomic<int> refs{0};
+};
+
+// 像素缓冲区的只读视图，不持有缓冲区，生命周期不能超过对应的FrameHandle
+struct FrameView
+{
+    const uchar* bits = nullptr;
+    int width = 0;
+    int height = 0;
+    int bytesPerLine = 0;
+
+    bool isNull() const { return bits == nullptr; }
+    QRect rect() const { return QRect(0, 0, width, height); }
+    // 按32位像素访问，像素值与GetDIBits写入的内存布局一致
+    const quint32* scanLine(int y) const { return reinterpret_cast<const quint32*>(bits + y * bytesPerLine); }
+    quint32 pixel(int x, int y) const { return scanLine(y)[x]; }
+};
+
+// 池缓冲区的引用计数句柄，最后一个句柄释放时缓冲区回到池中
+class FrameHandle
+{
+public:
+    FrameHandle() = default;
+    FrameHandle(const FrameHandle& other);
+    FrameHandle(FrameHandle&& other) noexcept;
+    FrameHandle& operator=(const FrameHandle& other);
+    FrameHandle& operator=(FrameHandle&& other) noexcept;
+    ~FrameHandle();
+
+    bool isNull() const { return buffer == nullptr; }
+    // 缓冲区是否还被其他句柄或QImage引用，生产方写入前需要检查
+    bool isShared() const { return buffer && buffer->refs.load(std::memory_order_acquire) > 1; }
+    int width() const { return buffer ? buffer->width : 0; }
+    int height() const { return buffer ? buffer->height : 0; }
+    int bytesPerLine() const { return buffer ? buffer->bytesPerLine : 0; }
+    QImage::Format format() const { return buffer ? buffer->format : QImage::Format_Invalid; }
+
+    // 可写指针，仅供填充像素的生产方使用
+    uchar* bits() { return buffer ? buffer->data : nullptr; }
+    FrameView view() const;
+    // 共享缓冲区的只读QImage，持有一个引用直到最后一个QImage副本析构；对其写入会触发深拷贝
+    QImage toImage() const;
+    // 同上，只包含subRect范围的像素，不复制数据
+    QImage toImage(const QRect& subRect) const;
+    void reset();
+
+private:
+    friend class FrameBufferPool;
+    explicit FrameHandle(FrameBuffer* buffer);
+    static void releaseImage(void* info);
+
+    FrameBuffer* buffer = nullptr;
+};
+
+// 按尺寸和像素格式复用截图缓冲区，稳态轮询时不再分配像素内存
+class FrameBufferPool
+{
+public:
+    struct Stats {
+        quint64 allocations = 0;    // 新分配的缓冲区数
+        quint64 reuses = 0;         // 从池中复用的次数
+        int idle = 0;               // 当前空闲的缓冲区数
+        int inUse = 0;              // 当前被句柄引用的缓冲区数
+    };
+
+    // 每种尺寸最多保留maxIdlePerKey块空闲缓冲区，多余的直接释放
+    explicit FrameBufferPool(int maxIdlePerKey = 4);
+    ~FrameBufferPool();
+
+    // 全局共享的截图缓冲池，所有截图后端共用
+    static FrameBufferPool& shared();
+
+    FrameHandle acquire(int width, int height, QImage::Format format = QImage::Format_ARGB32_Premultiplied);
+    Stats stats() const;
+    // 释放所有空闲缓冲区
+    void trim();
+
+private:
+    friend class FrameHandle;
+    void release(FrameBuffer* buffer);
+    static void destroy(FrameBuffer* buffer);
+
+    int maxIdle;
+    mutable QMutex mutex;
+    QHash<quint64, QVector<FrameBuffer*>> idleBuffers;
+    Stats counters;
+};
+
+#endif // FRAMEBUFFERPOOL_H
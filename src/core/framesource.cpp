@@ -0,0 +1,243 @@
+#include "framesource.h"
+#include "framearchive.h"
+#include "sessionrecorder.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <algorithm>
+#include <cstring>
+
+RegionFrame::RegionFrame(const QVector<QRect>& regions) : regionList(regions)
+{
+    int width = 0;
+    int height = 0;
+    rowOffsets.reserve(regions.size());
+    for (const QRect& region : regions) {
+        rowOffsets.append(height);
+        width = std::max(width, region.width());
+        height += region.height();
+    }
+    buffer = FrameBufferPool::shared().acquire(width, height);
+}
+
+QImage RegionFrame::image(int index) const
+{
+    if (isNull() || index < 0 || index >= regionList.size()) {
+        return QImage();
+    }
+    const QRect& region = regionList[index];
+    return buffer.toImage(QRect(0, rowOffsets[index], region.width(), region.height()));
+}
+
+uchar* RegionFrame::regionBits(int index)
+{
+    return buffer.bits() + rowOffsets[index] * buffer.bytesPerLine();
+}
+
+void RegionFrame::copyRegion(int index, const uchar* source, int sourceBytesPerLine)
+{
+    const QRect& region = regionList[index];
+    const int rowBytes = region.width() * 4;
+    uchar* target = regionBits(index);
+    for (int y = 0; y < region.height(); ++y) {
+        memcpy(target + y * buffer.bytesPerLine(), source + y * sourceBytesPerLine, rowBytes);
+    }
+}
+
+QImage FrameSource::grabRegion(const QRect& region)
+{
+    QImage frame = grab();
+    if (frame.isNull()) {
+        return QImage();
+    }
+    return frame.copy(region);
+}
+
+RegionFrame FrameSource::grabRegions(const QVector<QRect>& regions)
+{
+    QImage frame = grab();
+    if (frame.isNull()) {
+        return RegionFrame();
+    }
+    if (frame.format() != QImage::Format_ARGB32_Premultiplied) {
+        frame = frame.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    for (const QRect& region : regions) {
+        if (!frame.rect().contains(region)) {
+            qDebug() << "区域截图超出画面范围:" << region;
+            return RegionFrame();
+        }
+    }
+
+    // 直接从整帧中按行切片，不复制整帧
+    RegionFrame result(regions);
+    for (int i = 0; i < regions.size(); ++i) {
+        const QRect& region = regions[i];
+        result.copyRegion(i, frame.constScanLine(region.y()) + region.x() * 4, frame.bytesPerLine());
+    }
+    result.setTimestamp(timestamp());
+    return result;
+}
+
+bool FrameSource::grabInto(FrameHandle& target)
+{
+    QImage frame = grab();
+    if (frame.isNull()) {
+        return false;
+    }
+
+    frame = frame.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    if (target.isNull() || target.isShared() || target.width() != frame.width()
+        || target.height() != frame.height() || target.format() != frame.format()) {
+        target = FrameBufferPool::shared().acquire(frame.width(), frame.height(), frame.format());
+    }
+
+    const int rowBytes = std::min(target.bytesPerLine(), int(frame.bytesPerLine()));
+    for (int y = 0; y < frame.height(); ++y) {
+        memcpy(target.bits() + y * target.bytesPerLine(), frame.constScanLine(y), rowBytes);
+    }
+    return true;
+}
+
+ReplayFrameSource::ReplayFrameSource(const QString& dirPath, bool realTimePlayback)
+    : directory(dirPath), realTime(realTimePlayback)
+{
+}
+
+bool ReplayFrameSource::open()
+{
+    frames.clear();
+    rewind();
+
+    static const QRegularExpression regex("^(\\d+)(_\\d+x\\d+)?$");
+    QDir dir(directory);
+    const QFileInfoList files = dir.entryInfoList({"*.png", "*.raw"}, QDir::Files);
+    for (const QFileInfo& file : files) {
+        QRegularExpressionMatch match = regex.match(file.completeBaseName());
+        if (!match.hasMatch()) {
+            qDebug() << "回放帧文件名无法解析，跳过:" << file.fileName();
+            continue;
+        }
+        frames.append({file.absoluteFilePath(), match.captured(1).toLongLong()});
+    }
+
+    std::sort(frames.begin(), frames.end(),
+              [](const FrameEntry& a, const FrameEntry& b) { return a.timestamp < b.timestamp; });
+    qDebug() << QString("回放帧序列加载完成：%1，共%2帧").arg(directory).arg(frames.size());
+    return !frames.isEmpty();
+}
+
+void ReplayFrameSource::rewind()
+{
+    current = -1;
+    currentFrame = QImage();
+    clock.invalidate();
+}
+
+bool ReplayFrameSource::atEnd() const
+{
+    return current >= frames.size() - 1;
+}
+
+QImage ReplayFrameSource::grab()
+{
+    if (frames.isEmpty()) {
+        return QImage();
+    }
+
+    int next = current;
+    if (realTime) {
+        // 第一次获取时开始计时，之后返回录制时间不晚于当前回放时间的最后一帧
+        if (!clock.isValid()) {
+            clock.start();
+        }
+        qint64 replayTime = frames.first().timestamp + clock.elapsed();
+        next = std::max(next, 0);
+        while (next + 1 < frames.size() && frames[next + 1].timestamp <= replayTime) {
+            next++;
+        }
+    } else {
+        next = std::min(current + 1, frames.size() - 1);
+    }
+
+    if (next != current) {
+        current = next;
+        currentFrame = loadFrame(frames[current].path);
+    }
+    return currentFrame;
+}
+
+qint64 ReplayFrameSource::timestamp() const
+{
+    return current >= 0 ? frames[current].timestamp : 0;
+}
+
+QImage ReplayFrameSource::loadFrame(const QString& path)
+{
+    if (!path.endsWith(".raw")) {
+        QImage image(path);
+        if (image.isNull()) {
+            qDebug() << "回放帧加载失败:" << path;
+            return QImage();
+        }
+        // 与实时截图保持相同的像素格式
+        return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+
+    static const QRegularExpression sizeRegex("_(\\d+)x(\\d+)$");
+    QRegularExpressionMatch match = sizeRegex.match(QFileInfo(path).completeBaseName());
+    QFile file(path);
+    if (!match.hasMatch() || !file.open(QIODevice::ReadOnly)) {
+        qDebug() << "回放帧加载失败:" << path;
+        return QImage();
+    }
+
+    int width = match.captured(1).toInt();
+    int height = match.captured(2).toInt();
+    QByteArray data = file.readAll();
+    const int bytesPerLine = width * 4;
+    if (data.size() != bytesPerLine * height) {
+        qDebug() << "回放帧数据大小与文件名中的尺寸不一致:" << path;
+        return QImage();
+    }
+
+    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < height; ++y) {
+        memcpy(image.scanLine(y), data.constData() + y * bytesPerLine, bytesPerLine);
+    }
+    return image;
+}
+
+std::unique_ptr<FrameSource> openRecordedFrames(const QString& path, bool realTimePlayback)
+{
+    const QFileInfo info(path);
+    if (info.isDir()) {
+        auto replay = std::make_unique<ReplayFrameSource>(path, realTimePlayback);
+        if (!replay->open()) {
+            return nullptr;
+        }
+        return replay;
+    }
+
+    const QString suffix = info.suffix().toLower();
+    if (suffix == "fvmsession") {
+        auto player = std::make_unique<SessionPlayer>();
+        if (!player->open(path)) {
+            return nullptr;
+        }
+        return player;
+    }
+    if (suffix == "fvar") {
+        auto archive = std::make_unique<FrameArchive>();
+        if (!archive->open(path)) {
+            return nullptr;
+        }
+        return archive;
+    }
+
+    qDebug() << "无法识别的录制文件格式:" << path;
+    return nullptr;
+}
@@ -0,0 +1,100 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include "framebufferpool.h"
+#include <memory>
+
+// 区域截图结果：多个区域的像素按列表顺序自上而下打包在一块池缓冲区中
+class RegionFrame
+{
+public:
+    RegionFrame() = default;
+    // 为regions分配打包缓冲区，像素内容由截图后端填充
+    explicit RegionFrame(const QVector<QRect>& regions);
+
+    bool isNull() const { return buffer.isNull(); }
+    int count() const { return regionList.size(); }
+    // 第index个区域在完整画面中的位置
+    QRect region(int index) const { return regionList.value(index); }
+    // 第index个区域的只读图像，坐标从(0,0)开始，与打包缓冲区共享像素
+    QImage image(int index) const;
+    qint64 timestamp() const { return frameTimestamp; }
+    void setTimestamp(qint64 timestamp) { frameTimestamp = timestamp; }
+
+    // 供截图后端填充：source指向该区域左上角像素，按sourceBytesPerLine逐行复制
+    void copyRegion(int index, const uchar* source, int sourceBytesPerLine);
+    // 第index个区域在打包缓冲区中的起始地址，行跨度为bytesPerLine()
+    uchar* regionBits(int index);
+    int bytesPerLine() const { return buffer.bytesPerLine(); }
+
+private:
+    FrameHandle buffer;
+    QVector<QRect> regionList;
+    QVector<int> rowOffsets;
+    qint64 frameTimestamp = 0;
+};
+
+// 帧源：识别流程获取游戏画面的统一入口
+// 实时截图和录制回放实现同一接口，识别代码不关心画面来自哪里
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    // 获取一帧完整画面，失败返回空图像
+    virtual QImage grab() = 0;
+    // 只获取指定区域，默认从完整画面中裁剪
+    virtual QImage grabRegion(const QRect& region);
+    // 一次获取多个区域并打包到一块小缓冲区，默认从完整画面中切片；任一区域超出画面时返回空结果
+    virtual RegionFrame grabRegions(const QVector<QRect>& regions);
+    // 获取一帧写入target；target为空、被共享或尺寸不符时从FrameBufferPool::shared()重新获取，失败返回false
+    virtual bool grabInto(FrameHandle& target);
+    // 最近一次获取的帧的时间戳（毫秒），回放时为录制时的原始时间
+    virtual qint64 timestamp() const = 0;
+    // 录制的帧已全部读出；实时截图永远返回false
+    virtual bool atEnd() const { return false; }
+};
+
+// 回放帧源：按原始时间间隔回放磁盘上录制的帧序列
+// 目录中的帧文件名为"<时间戳ms>.png"，或原始像素"<时间戳ms>_<宽>x<高>.raw"（ARGB32，无文件头）
+class ReplayFrameSource : public FrameSource
+{
+public:
+    // realTimePlayback为true时按录制时的时间间隔推进，为false时每次grab返回下一帧（用于基准测试）
+    explicit ReplayFrameSource(const QString& dirPath, bool realTimePlayback = true);
+
+    bool open();
+    void rewind();
+    bool atEnd() const override;
+    int frameCount() const { return frames.size(); }
+    int currentIndex() const { return current; }
+
+    QImage grab() override;
+    qint64 timestamp() const override;
+
+    static QImage loadFrame(const QString& path);
+
+private:
+    struct FrameEntry {
+        QString path;
+        qint64 timestamp;
+    };
+
+    QString directory;
+    bool realTime;
+    QVector<FrameEntry> frames;
+    int current = -1;
+    QImage currentFrame;
+    QElapsedTimer clock;
+};
+
+// 按路径打开录制的帧：目录为ReplayFrameSource，.fvmsession为SessionPlayer，.fvar为FrameArchive
+// realTimePlayback只对帧目录有效，其余格式每次grab返回下一帧；打开失败返回nullptr
+std::unique_ptr<FrameSource> openRecordedFrames(const QString& path, bool realTimePlayback = true);
+
+#endif // FRAMESOURCE_H
@@ -0,0 +1,207 @@
+#include "gdiframesource.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QDebug>
+
+GdiFrameSource::GdiFrameSource(WindowProvider windowProvider, const QRect& area)
+    : currentWindow(windowProvider), captureArea(area)
+{
+}
+
+QImage GdiFrameSource::grab()
+{
+    QElapsedTimer timer = beginCapture();
+    QImage frame = captureWindow(currentWindow(), captureArea, "主页面");
+    lastTimestamp = QDateTime::currentMSecsSinceEpoch();
+    endCapture(timer, frame);
+    return frame;
+}
+
+QImage GdiFrameSource::grabRegion(const QRect& region)
+{
+    QElapsedTimer timer = beginCapture();
+    QImage frame = captureWindow(currentWindow(), region.intersected(captureArea), "主页面区域");
+    lastTimestamp = QDateTime::currentMSecsSinceEpoch();
+    endCapture(timer, frame);
+    return frame;
+}
+
+bool GdiFrameSource::grabInto(FrameHandle& target)
+{
+    // 上一帧仍被消费者持有时换一块池缓冲区，避免改写对方正在读取的像素
+    if (target.isNull() || target.isShared() || target.width() != captureArea.width()
+        || target.height() != captureArea.height() || target.format() != QImage::Format_ARGB32_Premultiplied) {
+        target = FrameBufferPool::shared().acquire(captureArea.width(), captureArea.height());
+    }
+    QElapsedTimer timer = beginCapture();
+    bool success = blitWindow(currentWindow(), captureArea, target.bits(), "主页面");
+    lastTimestamp = QDateTime::currentMSecsSinceEpoch();
+    if (governor) {
+        const quint64 signature = success ? CaptureGovernor::signature(target.bits(), target.bytesPerLine(),
+                                                                      target.width(), target.height()) : 0;
+        governor->record(timer.nsecsElapsed() / 1000, signature);
+    }
+    return success;
+}
+
+RegionFrame GdiFrameSource::grabRegions(const QVector<QRect>& regions)
+{
+    QElapsedTimer timer = beginCapture();
+    RegionFrame result = captureRegions(regions);
+    if (governor) {
+        governor->record(timer.nsecsElapsed() / 1000, CaptureGovernor::signature(result));
+    }
+    return result;
+}
+
+QElapsedTimer GdiFrameSource::beginCapture()
+{
+    if (governor) {
+        governor->acquire();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+void GdiFrameSource::endCapture(const QElapsedTimer& timer, const QImage& frame)
+{
+    // 签名计算也计入截图耗时
+    if (governor) {
+        governor->record(timer.nsecsElapsed() / 1000, CaptureGovernor::signature(frame));
+    }
+}
+
+RegionFrame GdiFrameSource::captureRegions(const QVector<QRect>& regions)
+{
+    QRect bounds;
+    for (const QRect& region : regions) {
+        if (!QRect(QPoint(0, 0), captureArea.size()).contains(region)) {
+            qDebug() << "区域截图超出画面范围:" << region;
+            return RegionFrame();
+        }
+        bounds |= region;
+    }
+    if (bounds.isEmpty()) {
+        return RegionFrame();
+    }
+
+    RegionFrame result(regions);
+    const QRect windowBounds = bounds.translated(captureArea.topLeft());
+    lastTimestamp = QDateTime::currentMSecsSinceEpoch();
+    result.setTimestamp(lastTimestamp);
+
+    // 单个区域时直接写入打包缓冲区，行跨度与GetDIBits输出一致
+    if (regions.size() == 1) {
+        if (!blitWindow(currentWindow(), windowBounds, result.regionBits(0), "主页面区域")) {
+            return RegionFrame();
+        }
+        return result;
+    }
+
+    FrameHandle boundsFrame = captureWindowPooled(currentWindow(), windowBounds, "主页面区域");
+    if (boundsFrame.isNull()) {
+        return RegionFrame();
+    }
+    const uchar* boundsBits = boundsFrame.bits();
+    for (int i = 0; i < regions.size(); ++i) {
+        const QPoint offset = regions[i].topLeft() - bounds.topLeft();
+        result.copyRegion(i, boundsBits + offset.y() * boundsFrame.bytesPerLine() + offset.x() * 4,
+                          boundsFrame.bytesPerLine());
+    }
+    return result;
+}
+
+QImage GdiFrameSource::captureWindow(HWND hwnd, const QRect& area, const QString& windowName)
+{
+    // 缓冲区来自共享池，返回的QImage释放后缓冲区归还给池
+    return captureWindowPooled(hwnd, area, windowName).toImage();
+}
+
+FrameHandle GdiFrameSource::captureWindowPooled(HWND hwnd, const QRect& area, const QString& windowName)
+{
+    if (area.width() <= 0 || area.height() <= 0) {
+        qDebug() << QString("截图区域无效: %1").arg(windowName);
+        return FrameHandle();
+    }
+
+    FrameHandle frame = FrameBufferPool::shared().acquire(area.width(), area.height());
+    if (!blitWindow(hwnd, area, frame.bits(), windowName)) {
+        return FrameHandle();
+    }
+    return frame;
+}
+
+bool GdiFrameSource::blitWindow(HWND hwnd, const QRect& area, uchar* bits, const QString& windowName)
+{
+    if (!hwnd || !IsWindow(hwnd)) {
+        qDebug() << QString("无效的窗口句柄: %1").arg(windowName);
+        return false;
+    }
+
+    int width = area.width();
+    int height = area.height();
+
+    // 获取窗口DC
+    HDC hdcWindow = GetDC(hwnd);
+    if (!hdcWindow) {
+        qDebug() << QString("获取窗口DC失败: %1").arg(windowName);
+        return false;
+    }
+
+    // 创建兼容DC和位图
+    HDC hdcMemDC = CreateCompatibleDC(hdcWindow);
+    if (!hdcMemDC) {
+        qDebug() << QString("创建兼容DC失败: %1").arg(windowName);
+        ReleaseDC(hwnd, hdcWindow);
+        return false;
+    }
+
+    HBITMAP hBitmap = CreateCompatibleBitmap(hdcWindow, width, height);
+    if (!hBitmap) {
+        qDebug() << QString("创建兼容位图失败: %1").arg(windowName);
+        DeleteDC(hdcMemDC);
+        ReleaseDC(hwnd, hdcWindow);
+        return false;
+    }
+
+    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMemDC, hBitmap);
+
+    // 复制窗口内容到位图
+    if (!BitBlt(hdcMemDC, 0, 0, width, height, hdcWindow, area.x(), area.y(), SRCCOPY)) {
+        qDebug() << QString("复制窗口内容失败: %1").arg(windowName);
+        SelectObject(hdcMemDC, hOldBitmap);
+        DeleteObject(hBitmap);
+        DeleteDC(hdcMemDC);
+        ReleaseDC(hwnd, hdcWindow);
+        return false;
+    }
+
+    // 设置BITMAPINFO结构
+    BITMAPINFO bmi;
+    ZeroMemory(&bmi, sizeof(BITMAPINFO));
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height; // 负值表示自上而下的位图
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    // 获取位图数据
+    if (!GetDIBits(hdcMemDC, hBitmap, 0, height, bits, &bmi, DIB_RGB_COLORS)) {
+        qDebug() << QString("获取位图数据失败: %1").arg(windowName);
+        SelectObject(hdcMemDC, hOldBitmap);
+        DeleteObject(hBitmap);
+        DeleteDC(hdcMemDC);
+        ReleaseDC(hwnd, hdcWindow);
+        return false;
+    }
+
+    // 清理资源
+    SelectObject(hdcMemDC, hOldBitmap);
+    DeleteObject(hBitmap);
+    DeleteDC(hdcMemDC);
+    ReleaseDC(hwnd, hdcWindow);
+
+    return true;
+}
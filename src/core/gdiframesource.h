@@ -0,0 +1,49 @@
+#ifndef GDIFRAMESOURCE_H
+#define GDIFRAMESOURCE_H
+
+#include "capturegovernor.h"
+#include "framesource.h"
+#include "framebufferpool.h"
+#include <functional>
+#include <windows.h>
+
+// 实时帧源：通过GDI BitBlt/GetDIBits截取游戏窗口
+class GdiFrameSource : public FrameSource
+{
+public:
+    using WindowProvider = std::function<HWND()>;
+
+    // 窗口句柄在刷新游戏后会变化，每次截图时通过windowProvider获取
+    explicit GdiFrameSource(WindowProvider windowProvider, const QRect& area = QRect(0, 0, 950, 596));
+
+    QImage grab() override;
+    // 只复制指定区域的像素，不截取整帧
+    QImage grabRegion(const QRect& region) override;
+    bool grabInto(FrameHandle& target) override;
+    // 只BitBlt所有区域的外接矩形，再把各区域切片打包
+    RegionFrame grabRegions(const QVector<QRect>& regions) override;
+    qint64 timestamp() const override { return lastTimestamp; }
+
+    // 设置后每次截图前由节流器控制节奏，截图后报告耗时和画面签名；所有权由调用方保留
+    void setGovernor(CaptureGovernor* captureGovernor) { governor = captureGovernor; }
+
+    // 截取窗口客户区中area对应的区域，失败返回空图像；像素缓冲区来自FrameBufferPool::shared()
+    static QImage captureWindow(HWND hwnd, const QRect& area, const QString& windowName = QString());
+    // 同上，返回池缓冲区句柄，供直接按像素访问的调用方使用
+    static FrameHandle captureWindowPooled(HWND hwnd, const QRect& area, const QString& windowName = QString());
+
+private:
+    QElapsedTimer beginCapture();
+    void endCapture(const QElapsedTimer& timer, const QImage& frame);
+    RegionFrame captureRegions(const QVector<QRect>& regions);
+
+    // 把窗口area区域以32位自上而下的格式写入bits，bits至少能容纳area.width()*4*area.height()字节
+    static bool blitWindow(HWND hwnd, const QRect& area, uchar* bits, const QString& windowName);
+
+    WindowProvider currentWindow;
+    QRect captureArea;
+    qint64 lastTimestamp = 0;
+    CaptureGovernor* governor = nullptr;
+};
+
+#endif // GDIFRAMESOURCE_H
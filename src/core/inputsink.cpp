@@ -0,0 +1,219 @@
+#include "inputsink.h"
+#include <QDebug>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+Win32InputSink::Win32InputSink(WindowProvider windowProvider, DpiProvider dpiProvider)
+    : currentWindow(std::move(windowProvider)), currentDpi(std::move(dpiProvider))
+{
+}
+
+QPoint Win32InputSink::scaled(const QPoint& position) const
+{
+    const double scaleFactor = static_cast<double>(currentDpi()) / 96.0;
+    return QPoint(static_cast<int>(position.x() * scaleFactor), static_cast<int>(position.y() * scaleFactor));
+}
+
+bool Win32InputSink::click(const QPoint& position)
+{
+    const QPoint point = scaled(position);
+    return postClick(currentWindow(), point.x(), point.y());
+}
+
+bool Win32InputSink::drag(const QPoint& start, int distance, bool downward)
+{
+    HWND hwnd = currentWindow();
+    if (!hwnd || !IsWindow(hwnd)) {
+        qDebug() << "无效的窗口句柄，无法执行拖动";
+        return false;
+    }
+
+    const QPoint startPoint = scaled(start);
+    const QPoint endPoint = scaled(QPoint(start.x(), downward ? start.y() + distance : start.y() - distance));
+    const LPARAM startLParam = MAKELPARAM(startPoint.x(), startPoint.y());
+    const LPARAM endLParam = MAKELPARAM(endPoint.x(), endPoint.y());
+
+    BOOL result = PostMessage(hwnd, WM_LBUTTONDOWN, MK_LBUTTON, startLParam);
+    PostMessage(hwnd, WM_MOUSEMOVE, MK_LBUTTON, endLParam);
+    PostMessage(hwnd, WM_LBUTTONUP, 0, endLParam);
+    return result;
+}
+
+bool Win32InputSink::postClick(HWND hwnd, int x, int y)
+{
+    BOOL result = PostMessage(hwnd, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(x, y));
+    PostMessage(hwnd, WM_LBUTTONUP, 0, MAKELPARAM(x, y));
+    return result;
+}
+#endif
+
+#ifdef STARRYCARD_X11
+X11InputSink::X11InputSink(WindowProvider windowProvider, const QString& displayName)
+    : currentWindow(std::move(windowProvider)), input(displayName)
+{
+}
+
+bool X11InputSink::click(const QPoint& position)
+{
+    return input.click(currentWindow(), position.x(), position.y());
+}
+
+bool X11InputSink::drag(const QPoint& start, int distance, bool downward)
+{
+    return input.drag(currentWindow(), start.x(), start.y(), distance, downward);
+}
+#endif
+
+RecordingInputSink::RecordingInputSink(InputSink* target) : target(target)
+{
+    clock.start();
+}
+
+bool RecordingInputSink::click(const QPoint& position)
+{
+    InputEvent event;
+    event.type = InputEvent::Click;
+    event.position = position;
+    {
+        QMutexLocker locker(&mutex);
+        event.timestamp = clock.elapsed();
+        recorded.append(event);
+    }
+    return target ? target->click(position) : true;
+}
+
+bool RecordingInputSink::drag(const QPoint& start, int distance, bool downward)
+{
+    InputEvent event;
+    event.type = InputEvent::Drag;
+    event.position = start;
+    event.distance = distance;
+    event.downward = downward;
+    {
+        QMutexLocker locker(&mutex);
+        event.timestamp = clock.elapsed();
+        recorded.append(event);
+    }
+    return target ? target->drag(start, distance, downward) : true;
+}
+
+bool RecordingInputSink::clickIdempotent(const QPoint& position)
+{
+    // 记录时不区分幂等点击，转发时保留标记
+    InputEvent event;
+    event.type = InputEvent::Click;
+    event.position = position;
+    {
+        QMutexLocker locker(&mutex);
+        event.timestamp = clock.elapsed();
+        recorded.append(event);
+    }
+    return target ? target->clickIdempotent(position) : true;
+}
+
+QVector<InputEvent> RecordingInputSink::events() const
+{
+    QMutexLocker locker(&mutex);
+    return recorded;
+}
+
+void RecordingInputSink::clear()
+{
+    QMutexLocker locker(&mutex);
+    recorded.clear();
+}
+
+RateLimitedInputSink::RateLimitedInputSink(InputSink* target, double inputsPerSecond, int burst, int coalesceWindowMs)
+    : target(target), rate(inputsPerSecond), capacity(qMax(1, burst)), coalesceWindow(coalesceWindowMs),
+      tokens(qMax(1, burst))
+{
+    clock.start();
+}
+
+void RateLimitedInputSink::takeToken()
+{
+    qint64 waitMs = 0;
+    {
+        QMutexLocker locker(&mutex);
+        const qint64 now = clock.elapsed();
+        tokens = qMin(capacity, tokens + (now - lastRefill) * rate / 1000.0);
+        lastRefill = now;
+        tokens -= 1.0;
+        // 令牌已预先扣除，欠下的部分按速率折算成等待时间
+        if (tokens < 0 && rate > 0) {
+            waitMs = static_cast<qint64>(-tokens * 1000.0 / rate + 0.5);
+            counters.throttledMs += waitMs;
+        }
+    }
+    if (waitMs > 0) {
+        QThread::msleep(static_cast<unsigned long>(waitMs));
+    }
+}
+
+bool RateLimitedInputSink::click(const QPoint& position)
+{
+    {
+        // 普通点击不合并，但之后同位置的幂等点击仍以它为参照
+        QMutexLocker locker(&mutex);
+        lastClickPosition = position;
+        lastClickTime = clock.elapsed();
+        lastClickChanges = changeCounter ? changeCounter() : 0;
+    }
+    return send(position);
+}
+
+bool RateLimitedInputSink::clickIdempotent(const QPoint& position)
+{
+    {
+        QMutexLocker locker(&mutex);
+        const qint64 now = clock.elapsed();
+        const quint64 changes = changeCounter ? changeCounter() : 0;
+        if (changeCounter && lastClickTime >= 0 && position == lastClickPosition
+            && now - lastClickTime < coalesceWindow && changes == lastClickChanges) {
+            counters.coalesced++;
+            return true;
+        }
+        lastClickPosition = position;
+        lastClickTime = now;
+        lastClickChanges = changes;
+    }
+    return send(position);
+}
+
+bool RateLimitedInputSink::send(const QPoint& position)
+{
+    takeToken();
+    QMutexLocker locker(&mutex);
+    counters.sent++;
+    locker.unlock();
+    return target->click(position);
+}
+
+bool RateLimitedInputSink::drag(const QPoint& start, int distance, bool downward)
+{
+    {
+        // 拖动会改变画面，之后的同位置点击不再与之前的点击合并
+        QMutexLocker locker(&mutex);
+        lastClickTime = -1;
+    }
+    takeToken();
+    QMutexLocker locker(&mutex);
+    counters.sent++;
+    locker.unlock();
+    return target->drag(start, distance, downward);
+}
+
+void RateLimitedInputSink::reset()
+{
+    QMutexLocker locker(&mutex);
+    counters = Stats();
+    tokens = capacity;
+    lastRefill = clock.elapsed();
+    lastClickTime = -1;
+}
+
+RateLimitedInputSink::Stats RateLimitedInputSink::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
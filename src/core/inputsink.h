@@ -0,0 +1,158 @@
+#ifndef INPUTSINK_H
+#define INPUTSINK_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QPoint>
+#include <QVector>
+#include <functional>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+#ifdef STARRYCARD_X11
+#include "x11input.h"
+#endif
+
+// 一次输入操作，坐标为游戏窗口内的逻辑坐标（未按DPI缩放）
+struct InputEvent
+{
+    enum Type : quint8 {
+        Click = 0,
+        Drag = 1
+    };
+
+    Type type = Click;
+    QPoint position;
+    int distance = 0;       // 拖动距离
+    bool downward = true;   // 拖动方向
+    qint64 timestamp = 0;   // 相对输入端创建的毫秒数
+};
+
+// 输入端：点击和拖动的统一出口，识别流程不关心输入最终发往哪里
+class InputSink
+{
+public:
+    virtual ~InputSink() = default;
+
+    virtual bool click(const QPoint& position) = 0;
+    // 重复点击没有额外效果的按钮（如已在顶部时继续点上翻），中间层可以合并画面没有变化的重复点击
+    virtual bool clickIdempotent(const QPoint& position) { return click(position); }
+    // 按下、移动到终点、释放，三步完成
+    virtual bool drag(const QPoint& start, int distance, bool downward) = 0;
+};
+
+#ifdef Q_OS_WIN
+// Windows输入端：向游戏窗口PostMessage鼠标消息，坐标按DPI缩放
+class Win32InputSink : public InputSink
+{
+public:
+    using WindowProvider = std::function<HWND()>;
+    using DpiProvider = std::function<int()>;
+
+    // 窗口句柄和DPI在刷新游戏或切换显示器后会变化，每次输入时重新获取
+    Win32InputSink(WindowProvider windowProvider, DpiProvider dpiProvider);
+
+    bool click(const QPoint& position) override;
+    bool drag(const QPoint& start, int distance, bool downward) override;
+
+    // 向任意窗口发送一次不缩放的点击（大厅、选服等非游戏窗口）
+    static bool postClick(HWND hwnd, int x, int y);
+
+private:
+    QPoint scaled(const QPoint& position) const;
+
+    WindowProvider currentWindow;
+    DpiProvider currentDpi;
+};
+#endif
+
+#ifdef STARRYCARD_X11
+// Linux输入端：通过XTest向X11窗口发送点击和拖动，坐标为窗口内坐标，不做DPI缩放
+class X11InputSink : public InputSink
+{
+public:
+    using WindowProvider = std::function<unsigned long()>;
+
+    explicit X11InputSink(WindowProvider windowProvider, const QString& displayName = QString());
+
+    bool isValid() const { return input.isValid(); }
+
+    bool click(const QPoint& position) override;
+    bool drag(const QPoint& start, int distance, bool downward) override;
+
+private:
+    WindowProvider currentWindow;
+    X11Input input;
+};
+#endif
+
+// 记录输入端：只记录不发送，用于回放和断言输入序列
+// 设置了target时同时转发，可串在真实输入端前面记录实际发出的输入
+class RecordingInputSink : public InputSink
+{
+public:
+    explicit RecordingInputSink(InputSink* target = nullptr);
+
+    bool click(const QPoint& position) override;
+    bool clickIdempotent(const QPoint& position) override;
+    bool drag(const QPoint& start, int distance, bool downward) override;
+
+    QVector<InputEvent> events() const;
+    void clear();
+
+private:
+    InputSink* target;
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    QVector<InputEvent> recorded;
+};
+
+// 限流输入端：令牌桶限制每秒输入次数，令牌不足时等待而不是丢弃
+// 只有调用方标记为幂等的点击（clickIdempotent）才会合并：同一位置在coalesceWindowMs内、且期间画面没有任何变化时直接丢掉
+// 普通点击即使位置相同、画面未变也照常发送，同步截图时画面计数不更新，合并会吞掉正常的重试
+class RateLimitedInputSink : public InputSink
+{
+public:
+    struct Stats {
+        quint64 sent = 0;
+        quint64 coalesced = 0;
+        qint64 throttledMs = 0;
+    };
+
+    // target的所有权由调用方保留
+    explicit RateLimitedInputSink(InputSink* target, double inputsPerSecond = 20.0, int burst = 5,
+                                  int coalesceWindowMs = 150);
+
+    // 返回画面变化计数，两次点击之间计数不变说明画面没有变化；未设置时不合并点击
+    void setChangeCounter(std::function<quint64()> counter) { changeCounter = std::move(counter); }
+
+    bool click(const QPoint& position) override;
+    bool clickIdempotent(const QPoint& position) override;
+    bool drag(const QPoint& start, int distance, bool downward) override;
+
+    // 开始新的统计会话
+    void reset();
+    Stats stats() const;
+
+private:
+    void takeToken();
+    bool send(const QPoint& position);
+
+    InputSink* target;
+    double rate;
+    double capacity;
+    int coalesceWindow;
+    std::function<quint64()> changeCounter;
+
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    double tokens;
+    qint64 lastRefill = 0;
+    QPoint lastClickPosition;
+    qint64 lastClickTime = -1;
+    quint64 lastClickChanges = 0;
+    Stats counters;
+};
+
+#endif // INPUTSINK_H
@@ -0,0 +1,74 @@
+#include "orderednavigator.h"
+#include <QDebug>
+#include <QVector>
+#include <algorithm>
+
+OrderedListNavigator::OrderedListNavigator(const QStringList& order)
+{
+    setOrder(order);
+}
+
+void OrderedListNavigator::setOrder(const QStringList& order)
+{
+    itemOrder = order;
+    ranks.clear();
+    for (int i = 0; i < order.size(); ++i) {
+        ranks.insert(order[i], i);
+    }
+}
+
+OrderedListNavigator::Result OrderedListNavigator::find(const QString& target, int minPosition, int maxPosition,
+                                                        const Probe& probe, const Mover& move, int maxProbes) const
+{
+    Result result;
+    const int targetRank = rank(target);
+    if (targetRank < 0) {
+        return result;
+    }
+
+    int low = minPosition;
+    int high = maxPosition;
+    while (low <= high && result.probes < maxProbes) {
+        const int middle = low + (high - low) / 2;
+        const int position = move(middle);
+        const QStringList visible = probe();
+        result.probes++;
+
+        if (visible.contains(target)) {
+            result.outcome = Found;
+            result.position = position;
+            return result;
+        }
+
+        QVector<int> visibleRanks;
+        for (const QString& item : visible) {
+            const int itemRank = rank(item);
+            if (itemRank >= 0) {
+                visibleRanks.append(itemRank);
+            }
+        }
+        if (visibleRanks.isEmpty()) {
+            result.outcome = Unknown;
+            return result;
+        }
+        if (!std::is_sorted(visibleRanks.begin(), visibleRanks.end())) {
+            qDebug() << "可见列表项与已知顺序不一致:" << visible;
+            result.outcome = OrderViolated;
+            return result;
+        }
+
+        // 滚动条可能被列表末端挡住，以实际到达的位置收缩区间
+        if (targetRank < visibleRanks.first()) {
+            high = qMin(middle, position) - 1;
+        } else if (targetRank > visibleRanks.last()) {
+            low = qMax(middle, position) + 1;
+        } else {
+            // 目标应在当前页却没有出现：已用完，或顺序发生了变化
+            result.outcome = OrderViolated;
+            return result;
+        }
+    }
+
+    result.outcome = NotFound;
+    return result;
+}
@@ -0,0 +1,48 @@
+#ifndef ORDEREDNAVIGATOR_H
+#define ORDEREDNAVIGATOR_H
+
+#include <QHash>
+#include <QStringList>
+#include <functional>
+
+// 有序列表导航：列表项按游戏固定的顺序排列时，在滚动范围内二分查找目标项
+// 每次滚动到区间中点，识别可见项，根据可见项与目标的先后关系缩小区间，拖动次数为O(log 页数)
+// 可见项顺序与已知顺序不一致、或目标应当可见却没有出现时返回OrderViolated，由调用方改为逐页查找
+class OrderedListNavigator
+{
+public:
+    enum Outcome {
+        Found,
+        NotFound,       // 区间已缩为空
+        OrderViolated,  // 顺序假设不成立
+        Unknown         // 目标不在已知顺序中，或当前页没有可识别的已知项
+    };
+
+    struct Result {
+        Outcome outcome = Unknown;
+        int position = -1;  // 找到时的滚动条位置
+        int probes = 0;     // 拖动并识别的次数
+    };
+
+    // 识别当前可见的列表项，按列表顺序（从上到下、从左到右）返回
+    using Probe = std::function<QStringList()>;
+    // 滚动到指定位置，返回实际到达的位置
+    using Mover = std::function<int(int position)>;
+
+    explicit OrderedListNavigator(const QStringList& order = QStringList());
+
+    void setOrder(const QStringList& order);
+    const QStringList& order() const { return itemOrder; }
+    bool contains(const QString& item) const { return ranks.contains(item); }
+    int rank(const QString& item) const { return ranks.value(item, -1); }
+
+    // 在[minPosition, maxPosition]滚动范围内查找target
+    Result find(const QString& target, int minPosition, int maxPosition, const Probe& probe, const Mover& move,
+                int maxProbes = 12) const;
+
+private:
+    QStringList itemOrder;
+    QHash<QString, int> ranks;
+};
+
+#endif // ORDEREDNAVIGATOR_H
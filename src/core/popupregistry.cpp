@@ -0,0 +1,77 @@
+#include "popupregistry.h"
+#include <QDebug>
+
+PopupRegistry::PopupRegistry(HashFunction hashFunction)
+    : calculateHash(hashFunction)
+{
+}
+
+bool PopupRegistry::registerPopup(const QString& name, const QString& templatePath, const QRect& roi,
+                                  const QVector<QPoint>& dismissClicks, bool blocking)
+{
+    QImage templateImage(templatePath);
+    if (templateImage.isNull()) {
+        qDebug() << "弹窗模板加载失败:" << templatePath;
+        return false;
+    }
+
+    if (templateImage.size() != roi.size()) {
+        qDebug() << "弹窗模板尺寸与签名区域不一致:" << templatePath;
+        return false;
+    }
+
+    PopupEntry entry;
+    entry.name = name;
+    entry.roi = roi;
+    entry.hash = calculateHash(templateImage, QRect());
+    entry.dismissClicks = dismissClicks;
+    entry.blocking = blocking;
+    entries.append(entry);
+    return true;
+}
+
+void PopupRegistry::registerFallback(const QString& name, const QVector<QPoint>& dismissClicks)
+{
+    PopupEntry entry;
+    entry.name = name;
+    entry.dismissClicks = dismissClicks;
+    fallbackEntries.append(entry);
+}
+
+const PopupEntry* PopupRegistry::match(const QImage& screenshot) const
+{
+    if (screenshot.isNull()) {
+        return nullptr;
+    }
+
+    for (const PopupEntry& entry : entries) {
+        if (!screenshot.rect().contains(entry.roi)) {
+            continue;
+        }
+        if (calculateHash(screenshot, entry.roi) == entry.hash) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool PopupRegistry::isVisible(const QImage& screenshot, const QString& name) const
+{
+    const PopupEntry* entry = find(name);
+    if (!entry || screenshot.isNull() || !screenshot.rect().contains(entry->roi)) {
+        return false;
+    }
+    return calculateHash(screenshot, entry->roi) == entry->hash;
+}
+
+const PopupEntry* PopupRegistry::find(const QString& name) const
+{
+    for (const QVector<PopupEntry>* list : {&entries, &fallbackEntries}) {
+        for (const PopupEntry& entry : *list) {
+            if (entry.name == name) {
+                return &entry;
+            }
+        }
+    }
+    return nullptr;
+}
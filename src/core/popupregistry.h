@@ -0,0 +1,58 @@
+#ifndef POPUPREGISTRY_H
+#define POPUPREGISTRY_H
+
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// 弹窗签名及关闭方式
+struct PopupEntry {
+    QString name;                   // 弹窗名称
+    QRect roi;                      // 签名区域（游戏窗口坐标）
+    QString hash;                   // 缓存的模板哈希值
+    QVector<QPoint> dismissClicks;  // 关闭弹窗需依次点击的位置，为空表示无法自动关闭
+    bool blocking = false;          // 是否为需要中断流程的状态（如背包已满）
+};
+
+// 弹窗检测结果
+enum class PopupCheckResult {
+    None,           // 未检测到弹窗
+    Dismissed,      // 检测到已知弹窗并已关闭
+    Blocking,       // 检测到需要中断流程的已知弹窗
+    UnknownOverlay  // 画面被未知弹窗遮挡
+};
+
+// 弹窗注册表：启动时加载一次模板哈希，之后每帧仅做哈希比较
+class PopupRegistry
+{
+public:
+    using HashFunction = std::function<QString(const QImage&, const QRect&)>;
+
+    explicit PopupRegistry(HashFunction hashFunction);
+
+    // 从模板图片注册弹窗，模板哈希只在此处计算一次
+    bool registerPopup(const QString& name, const QString& templatePath, const QRect& roi,
+                       const QVector<QPoint>& dismissClicks, bool blocking = false);
+    // 注册没有签名的关闭方式：画面持续被不认识的界面遮挡时，判定为未知弹窗之前先依次尝试
+    void registerFallback(const QString& name, const QVector<QPoint>& dismissClicks);
+
+    // 在截图中查找已注册的弹窗，未找到返回nullptr
+    const PopupEntry* match(const QImage& screenshot) const;
+
+    // 判断截图中是否出现指定弹窗
+    bool isVisible(const QImage& screenshot, const QString& name) const;
+
+    const PopupEntry* find(const QString& name) const;
+    const QVector<PopupEntry>& fallbacks() const { return fallbackEntries; }
+    int size() const { return entries.size() + fallbackEntries.size(); }
+
+private:
+    HashFunction calculateHash;
+    QVector<PopupEntry> entries;
+    QVector<PopupEntry> fallbackEntries;
+};
+
+#endif // POPUPREGISTRY_H
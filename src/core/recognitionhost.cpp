@@ -0,0 +1,448 @@
+#include "recognitionhost.h"
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+const int MAX_ATTEMPTS = 2;         // 同一任务让识别进程崩溃两次后不再重试
+const int RESTART_DELAY_MS = 500;   // 首次崩溃后的重启延迟，之后每次连续崩溃加倍
+const int MAX_RESTART_DELAY_MS = 8000;
+const int MAX_CONSECUTIVE_CRASHES = 5; // 连续崩溃（期间没有返回过结果）超过该次数后不再重启
+
+} // namespace
+
+namespace RecognitionProtocol {
+
+void writeMessage(QLocalSocket* socket, const QByteArray& body)
+{
+    QByteArray message;
+    QDataStream stream(&message, QIODevice::WriteOnly);
+    stream << quint32(body.size());
+    message.append(body);
+    socket->write(message);
+}
+
+bool takeMessage(QByteArray& buffer, QByteArray& body)
+{
+    if (buffer.size() < 4) {
+        return false;
+    }
+    QDataStream stream(buffer);
+    quint32 length = 0;
+    stream >> length;
+    if (buffer.size() < 4 + int(length)) {
+        return false;
+    }
+    body = buffer.mid(4, int(length));
+    buffer.remove(0, 4 + int(length));
+    return true;
+}
+
+QByteArray encodeCards(const QVector<CardInfo>& cards)
+{
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    stream << quint32(cards.size());
+    for (const CardInfo& card : cards) {
+        stream << card.name << qint32(card.level) << card.isBound << card.centerPosition
+               << qint32(card.row) << qint32(card.col);
+    }
+    return payload;
+}
+
+QVector<CardInfo> decodeCards(const QByteArray& payload)
+{
+    QDataStream stream(payload);
+    quint32 count = 0;
+    stream >> count;
+    QVector<CardInfo> cards;
+    cards.reserve(int(count));
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        CardInfo card;
+        qint32 level = 0, row = 0, col = 0;
+        stream >> card.name >> level >> card.isBound >> card.centerPosition >> row >> col;
+        card.level = level;
+        card.row = row;
+        card.col = col;
+        cards.append(card);
+    }
+    return cards;
+}
+
+} // namespace RecognitionProtocol
+
+RecognitionHost::RecognitionHost(int workerCount)
+    : workerCount(workerCount),
+      ring(QString("FvmStarryCard_frames_%1").arg(QCoreApplication::applicationPid()))
+{
+}
+
+RecognitionHost::~RecognitionHost()
+{
+    stop();
+}
+
+bool RecognitionHost::start()
+{
+    if (context) {
+        return true;
+    }
+    if (!ring.create()) {
+        return false;
+    }
+
+    stopping.store(false);
+    context = new QObject;
+    context->moveToThread(&hostThread);
+    hostThread.start();
+
+    bool listening = false;
+    QMetaObject::invokeMethod(context, [this, &listening]() {
+        const QString name = QString("FvmStarryCard_recognition_%1").arg(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(name);
+        server = new QLocalServer(context);
+        QObject::connect(server, &QLocalServer::newConnection, context, [this]() {
+            while (QLocalSocket* socket = server->nextPendingConnection()) {
+                onConnection(socket);
+            }
+        });
+        listening = server->listen(name);
+        if (!listening) {
+            qDebug() << "识别进程服务启动失败:" << server->errorString();
+            return;
+        }
+        workers.resize(workerCount);
+        for (int i = 0; i < workerCount; ++i) {
+            workers[i].index = i;
+            launchWorker(i);
+        }
+    }, Qt::BlockingQueuedConnection);
+
+    if (!listening) {
+        stop();
+        return false;
+    }
+    qDebug() << QString("识别进程宿主已启动，%1个识别进程").arg(workerCount);
+    return true;
+}
+
+void RecognitionHost::stop()
+{
+    if (!context) {
+        return;
+    }
+    stopping.store(true);
+
+    QMetaObject::invokeMethod(context, [this]() {
+        for (Worker& worker : workers) {
+            if (worker.socket) {
+                worker.socket->abort();
+            }
+            if (worker.process) {
+                worker.process->disconnect(context);
+                worker.process->kill();
+                worker.process->waitForFinished(1000);
+            }
+        }
+        workers.clear();
+        while (!queue.isEmpty()) {
+            finishJob(queue.dequeue(), false, QByteArray());
+        }
+        delete server;
+        server = nullptr;
+    }, Qt::BlockingQueuedConnection);
+
+    hostThread.quit();
+    hostThread.wait();
+    delete context;     // 同时删除子对象（进程、套接字）
+    context = nullptr;
+    connectedWorkers.store(0);
+    ring.detach();
+}
+
+void RecognitionHost::launchWorker(int index)
+{
+    QProcess* process = new QProcess(context);
+    process->setProgram(QCoreApplication::applicationFilePath());
+    process->setArguments({RecognitionProtocol::WORKER_ARGUMENT, server->fullServerName(),
+                           ring.key(), QString::number(index)});
+    process->setProcessChannelMode(QProcess::ForwardedChannels);
+    QObject::connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), context,
+                     [this, index]() { onWorkerExited(index); });
+    workers[index].process = process;
+    process->start();
+}
+
+void RecognitionHost::onConnection(QLocalSocket* socket)
+{
+    // 连接后第一条消息是Hello，收到后才知道对应哪个识别进程
+    auto buffer = std::make_shared<QByteArray>();
+    QObject::connect(socket, &QLocalSocket::readyRead, context, [this, socket, buffer]() {
+        buffer->append(socket->readAll());
+        QByteArray body;
+        while (RecognitionProtocol::takeMessage(*buffer, body)) {
+            onMessage(socket, body);
+        }
+    });
+}
+
+void RecognitionHost::onMessage(QLocalSocket* socket, const QByteArray& body)
+{
+    QDataStream stream(body);
+    quint8 type = 0;
+    stream >> type;
+
+    if (type == RecognitionProtocol::Hello) {
+        qint32 index = -1;
+        stream >> index;
+        if (index < 0 || index >= workers.size() || workers[index].socket) {
+            socket->abort();
+            socket->deleteLater();
+            return;
+        }
+        workers[index].socket = socket;
+        connectedWorkers.fetch_add(1);
+        dispatch();
+        return;
+    }
+
+    if (type != RecognitionProtocol::Result) {
+        return;
+    }
+    quint32 jobId = 0;
+    bool ok = false;
+    QByteArray payload;
+    stream >> jobId >> ok >> payload;
+    for (Worker& worker : workers) {
+        if (worker.socket == socket && worker.current && worker.current->id == jobId) {
+            finishJob(worker.current, ok, payload);
+            worker.current.reset();
+            worker.consecutiveCrashes = 0;
+            break;
+        }
+    }
+    dispatch();
+}
+
+void RecognitionHost::onWorkerExited(int index)
+{
+    Worker& worker = workers[index];
+    if (worker.socket) {
+        connectedWorkers.fetch_sub(1);
+        worker.socket->abort();
+        worker.socket->deleteLater();
+        worker.socket = nullptr;
+    }
+    worker.process->deleteLater();
+    worker.process = nullptr;
+
+    // 正在处理的任务重新排队；同一任务反复导致崩溃时判定失败，由调用方在本进程内识别
+    if (worker.current) {
+        std::shared_ptr<Job> job = worker.current;
+        worker.current.reset();
+        if (++job->attempts < MAX_ATTEMPTS) {
+            queue.prepend(job);
+        } else {
+            finishJob(job, false, QByteArray());
+        }
+    }
+
+    if (stopping.load()) {
+        return;
+    }
+    // 连续崩溃时重启间隔逐次加倍；始终起不来的识别进程不再重启，全部放弃后调用方在本进程内识别
+    if (++worker.consecutiveCrashes > MAX_CONSECUTIVE_CRASHES) {
+        qDebug() << QString("识别进程%1连续崩溃%2次，不再重启").arg(index).arg(MAX_CONSECUTIVE_CRASHES);
+        const bool allRetired = std::all_of(workers.begin(), workers.end(), [](const Worker& other) {
+            return other.consecutiveCrashes > MAX_CONSECUTIVE_CRASHES;
+        });
+        if (allRetired) {
+            qDebug() << "识别进程全部放弃，卡片识别改在主进程中进行";
+            while (!queue.isEmpty()) {
+                finishJob(queue.dequeue(), false, QByteArray());
+            }
+        } else {
+            dispatch();
+        }
+        return;
+    }
+    const int delay = qMin(MAX_RESTART_DELAY_MS, RESTART_DELAY_MS << (worker.consecutiveCrashes - 1));
+    qDebug() << QString("识别进程%1已退出，%2ms后重启").arg(index).arg(delay);
+    {
+        QMutexLocker locker(&resultMutex);
+        counters.restarts++;
+    }
+    QTimer::singleShot(delay, context, [this, index]() {
+        if (!stopping.load() && index < workers.size() && !workers[index].process) {
+            launchWorker(index);
+        }
+    });
+    dispatch();
+}
+
+void RecognitionHost::dispatch()
+{
+    for (Worker& worker : workers) {
+        if (!worker.socket || worker.current) {
+            continue;
+        }
+        while (!queue.isEmpty()) {
+            std::shared_ptr<Job> job = queue.dequeue();
+            {
+                QMutexLocker locker(&resultMutex);
+                if (job->abandoned) {
+                    continue;
+                }
+            }
+            worker.current = job;
+            RecognitionProtocol::writeMessage(worker.socket, job->request);
+            break;
+        }
+    }
+}
+
+void RecognitionHost::finishJob(const std::shared_ptr<Job>& job, bool ok, const QByteArray& payload)
+{
+    QMutexLocker locker(&resultMutex);
+    job->done = true;
+    job->ok = ok;
+    job->payload = payload;
+    if (ok) {
+        counters.completed++;
+    } else {
+        counters.failed++;
+    }
+    resultReady.wakeAll();
+}
+
+bool RecognitionHost::submit(const QImage& frame, const QString& task, const QStringList& args,
+                             QByteArray& payload, int timeoutMs)
+{
+    if (!context || !isAvailable()) {
+        return false;
+    }
+    const quint64 sequence = ring.publish(frame);
+    if (sequence == 0) {
+        return false;
+    }
+
+    auto job = std::make_shared<Job>();
+    job->id = nextJobId.fetch_add(1);
+    QDataStream stream(&job->request, QIODevice::WriteOnly);
+    stream << quint8(RecognitionProtocol::Request) << job->id << sequence << task << args;
+
+    QMetaObject::invokeMethod(context, [this, job]() {
+        queue.enqueue(job);
+        dispatch();
+    }, Qt::QueuedConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    QMutexLocker locker(&resultMutex);
+    while (!job->done) {
+        const qint64 remaining = timeoutMs - timer.elapsed();
+        if (remaining <= 0 || !resultReady.wait(&resultMutex, static_cast<unsigned long>(remaining))) {
+            if (!job->done) {
+                job->abandoned = true;
+                counters.failed++;
+                qDebug() << QString("识别进程任务%1超时").arg(job->id);
+                return false;
+            }
+        }
+    }
+    payload = job->payload;
+    return job->ok;
+}
+
+bool RecognitionHost::recognizeCards(const QImage& frame, const QStringList& cardTypes,
+                                     QVector<CardInfo>& cards, int timeoutMs)
+{
+    QByteArray payload;
+    if (!submit(frame, RecognitionProtocol::TASK_CARDS, cardTypes, payload, timeoutMs)) {
+        return false;
+    }
+    cards = RecognitionProtocol::decodeCards(payload);
+    return true;
+}
+
+RecognitionHost::Stats RecognitionHost::stats() const
+{
+    QMutexLocker locker(&resultMutex);
+    Stats result = counters;
+    result.connectedWorkers = connectedWorkers.load();
+    return result;
+}
+
+int runRecognitionWorker(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const int argIndex = args.indexOf(RecognitionProtocol::WORKER_ARGUMENT);
+    if (argIndex < 0 || argIndex + 3 >= args.size()) {
+        qDebug() << "识别进程参数不完整:" << args;
+        return 1;
+    }
+    const QString serverName = args[argIndex + 1];
+    const QString ringKey = args[argIndex + 2];
+    const qint32 workerIndex = args[argIndex + 3].toInt();
+
+    SharedFrameRing ring(ringKey);
+    if (!ring.attach()) {
+        return 1;
+    }
+    CardRecognizer cardRecognizer;
+
+    QLocalSocket socket;
+    socket.connectToServer(serverName);
+    if (!socket.waitForConnected(3000)) {
+        qDebug() << "识别进程连接主进程失败:" << socket.errorString();
+        return 1;
+    }
+
+    QByteArray hello;
+    QDataStream helloStream(&hello, QIODevice::WriteOnly);
+    helloStream << quint8(RecognitionProtocol::Hello) << workerIndex;
+    RecognitionProtocol::writeMessage(&socket, hello);
+
+    QByteArray buffer;
+    QObject::connect(&socket, &QLocalSocket::readyRead, [&]() {
+        buffer.append(socket.readAll());
+        QByteArray body;
+        while (RecognitionProtocol::takeMessage(buffer, body)) {
+            QDataStream stream(body);
+            quint8 type = 0;
+            quint32 jobId = 0;
+            quint64 sequence = 0;
+            QString task;
+            QStringList taskArgs;
+            stream >> type >> jobId >> sequence >> task >> taskArgs;
+            if (type != RecognitionProtocol::Request) {
+                continue;
+            }
+
+            // 帧在排队期间被新帧覆盖时返回失败，由主进程自行识别
+            const QImage frame = ring.read(sequence);
+            bool ok = !frame.isNull() && task == RecognitionProtocol::TASK_CARDS;
+            QByteArray payload;
+            if (ok) {
+                payload = RecognitionProtocol::encodeCards(cardRecognizer.recognizeCards(frame, taskArgs));
+            }
+
+            QByteArray reply;
+            QDataStream replyStream(&reply, QIODevice::WriteOnly);
+            replyStream << quint8(RecognitionProtocol::Result) << jobId << ok << payload;
+            RecognitionProtocol::writeMessage(&socket, reply);
+        }
+    });
+    // 主进程退出或崩溃时随之退出
+    QObject::connect(&socket, &QLocalSocket::disconnected, &app, &QCoreApplication::quit);
+
+    return app.exec();
+}
@@ -0,0 +1,113 @@
+#ifndef RECOGNITIONHOST_H
+#define RECOGNITIONHOST_H
+
+#include "sharedframering.h"
+#include "../recognition/cardrecognizer.h"
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+class QLocalServer;
+class QLocalSocket;
+class QProcess;
+
+// 主进程与识别进程之间的消息：quint32长度 + QDataStream编码的消息体
+namespace RecognitionProtocol {
+const char WORKER_ARGUMENT[] = "--recognition-worker";
+
+enum MessageType : quint8 {
+    Hello = 1,      // 识别进程 -> 主进程：qint32进程序号
+    Request = 2,    // 主进程 -> 识别进程：quint32任务号, quint64帧序号, QString任务名, QStringList参数
+    Result = 3      // 识别进程 -> 主进程：quint32任务号, bool成功, QByteArray结果
+};
+
+const QString TASK_CARDS = "cards";
+
+void writeMessage(QLocalSocket* socket, const QByteArray& body);
+// 从接收缓冲区中取出一条完整消息，不完整时返回false
+bool takeMessage(QByteArray& buffer, QByteArray& body);
+
+QByteArray encodeCards(const QVector<CardInfo>& cards);
+QVector<CardInfo> decodeCards(const QByteArray& payload);
+}
+
+// 识别进程宿主：帧通过共享内存帧环交给若干识别进程，结果经本地套接字返回
+// 重量级识别在其他进程中运行，不再阻塞界面和强化线程；识别进程崩溃时任务重新排队，按逐次加倍的间隔重启进程，
+// 连续崩溃多次后放弃该进程
+// 套接字和进程对象都属于宿主自己的线程，其他线程只通过recognizeCards()提交任务
+class RecognitionHost
+{
+public:
+    struct Stats {
+        quint64 completed = 0;
+        quint64 failed = 0;     // 超时、帧被覆盖或识别进程反复崩溃
+        quint64 restarts = 0;
+        int connectedWorkers = 0;
+    };
+
+    explicit RecognitionHost(int workerCount = 2);
+    ~RecognitionHost();
+
+    bool start();
+    void stop();
+    // 至少有一个识别进程已连接
+    bool isAvailable() const { return connectedWorkers.load() > 0; }
+
+    // 线程安全，阻塞直到识别进程返回结果；返回false时调用方应在本进程内识别
+    bool recognizeCards(const QImage& frame, const QStringList& cardTypes, QVector<CardInfo>& cards, int timeoutMs = 3000);
+    Stats stats() const;
+
+private:
+    struct Job {
+        quint32 id = 0;
+        QByteArray request;
+        int attempts = 0;
+        bool done = false;      // 以下字段由resultMutex保护
+        bool abandoned = false; // 调用方已超时返回
+        bool ok = false;
+        QByteArray payload;
+    };
+    struct Worker {
+        int index = 0;
+        QProcess* process = nullptr;
+        QLocalSocket* socket = nullptr;
+        std::shared_ptr<Job> current;
+        int consecutiveCrashes = 0; // 上次返回结果之后的崩溃次数
+    };
+
+    bool submit(const QImage& frame, const QString& task, const QStringList& args, QByteArray& payload, int timeoutMs);
+
+    // 以下函数只在宿主线程中执行
+    void launchWorker(int index);
+    void onConnection(QLocalSocket* socket);
+    void onMessage(QLocalSocket* socket, const QByteArray& body);
+    void onWorkerExited(int index);
+    void dispatch();
+    void finishJob(const std::shared_ptr<Job>& job, bool ok, const QByteArray& payload);
+
+    int workerCount;
+    QThread hostThread;
+    QObject* context = nullptr;     // 宿主线程中的对象都以它为父对象
+    SharedFrameRing ring;
+    QLocalServer* server = nullptr;
+    QVector<Worker> workers;
+    QQueue<std::shared_ptr<Job>> queue;
+    std::atomic<bool> stopping{false};
+    std::atomic<int> connectedWorkers{0};
+    std::atomic<quint32> nextJobId{1};
+
+    mutable QMutex resultMutex;
+    QWaitCondition resultReady;
+    Stats counters;                 // 由resultMutex保护
+};
+
+// 识别进程入口，main()检测到RecognitionProtocol::WORKER_ARGUMENT参数时调用
+int runRecognitionWorker(int argc, char* argv[]);
+
+#endif // RECOGNITIONHOST_H
@@ -0,0 +1,102 @@
+#include "sceneclassifier.h"
+#include <QDebug>
+#include <QRegularExpression>
+#include <algorithm>
+
+SceneClassifier::SceneClassifier(HashFunction hashFunction, const QStringList& order)
+    : calculateHash(hashFunction), sceneOrder(order)
+{
+}
+
+bool SceneClassifier::addAnchor(const QString& key, const QString& hash)
+{
+    static const QRegularExpression regex("^\\((\\d+),(\\d+)\\)(.*)$");
+    QRegularExpressionMatch match = regex.match(key);
+    if (!match.hasMatch()) {
+        qDebug() << "无法解析位置模板键:" << key;
+        return false;
+    }
+
+    Anchor anchor;
+    anchor.key = key;
+    anchor.description = match.captured(3);
+    anchor.roi = QRect(match.captured(1).toInt(), match.captured(2).toInt(), 20, 20);
+    anchor.hash = hash;
+
+    anchor.order = sceneOrder.indexOf(anchor.description);
+    if (anchor.order < 0) {
+        flagAnchors.append(anchor);
+        return true;
+    }
+
+    // 插入时保持决策表顺序
+    auto pos = std::upper_bound(sceneAnchors.begin(), sceneAnchors.end(), anchor,
+                                [](const Anchor& a, const Anchor& b) { return a.order < b.order; });
+    sceneAnchors.insert(pos, anchor);
+    return true;
+}
+
+void SceneClassifier::clear()
+{
+    sceneAnchors.clear();
+    flagAnchors.clear();
+}
+
+bool SceneClassifier::matches(const QImage& screenshot, const Anchor& anchor) const
+{
+    return screenshot.rect().contains(anchor.roi) && calculateHash(screenshot, anchor.roi) == anchor.hash;
+}
+
+SceneInfo SceneClassifier::classify(const QImage& screenshot) const
+{
+    SceneInfo info;
+    if (screenshot.isNull()) {
+        return info;
+    }
+
+    for (const Anchor& anchor : sceneAnchors) {
+        if (matches(screenshot, anchor)) {
+            info.scene = anchor.key;
+            break;
+        }
+    }
+
+    for (const Anchor& anchor : flagAnchors) {
+        if (matches(screenshot, anchor)) {
+            info.flags.append(anchor.description);
+        }
+    }
+    return info;
+}
+
+bool SceneClassifier::isAnchorVisible(const QImage& screenshot, const QString& description) const
+{
+    if (screenshot.isNull()) {
+        return false;
+    }
+
+    for (const QVector<Anchor>* anchors : {&sceneAnchors, &flagAnchors}) {
+        for (const Anchor& anchor : *anchors) {
+            if (anchor.description == description) {
+                return matches(screenshot, anchor);
+            }
+        }
+    }
+    return false;
+}
+
+bool SceneClassifier::anyAnchorVisible(const QImage& screenshot, const QStringList& ignored) const
+{
+    if (screenshot.isNull()) {
+        return false;
+    }
+
+    for (const QVector<Anchor>* anchors : {&sceneAnchors, &flagAnchors}) {
+        for (const Anchor& anchor : *anchors) {
+            if (!ignored.contains(anchor.description) && matches(screenshot, anchor)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
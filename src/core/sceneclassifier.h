@@ -0,0 +1,60 @@
+#ifndef SCENECLASSIFIER_H
+#define SCENECLASSIFIER_H
+
+#include <QImage>
+#include <QRect>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+// 单帧场景识别结果
+struct SceneInfo {
+    QString scene;       // 匹配到的页面锚点键，如"(94,326)卡片强化"，未识别为空
+    QStringList flags;   // 同一帧中可见的子状态锚点描述，如"排行"、"制作亮"
+
+    bool isKnown() const { return !scene.isEmpty(); }
+    bool hasFlag(const QString& description) const { return flags.contains(description); }
+};
+
+// 场景分类器：位置模板文件名"(x,y)描述"只在加载时解析一次，
+// 识别时按决策表顺序比较锚点哈希，页面锚点命中第一个即停止
+class SceneClassifier
+{
+public:
+    using HashFunction = std::function<QString(const QImage&, const QRect&)>;
+
+    // order：页面锚点描述，按区分度从高到低排列；其余模板作为子状态锚点
+    SceneClassifier(HashFunction hashFunction, const QStringList& order);
+
+    // 注册位置模板，key格式为"(x,y)描述"
+    bool addAnchor(const QString& key, const QString& hash);
+    void clear();
+
+    // 一帧截图只做少量哈希比较，返回页面和子状态
+    SceneInfo classify(const QImage& screenshot) const;
+    // 只检查单个锚点，description为"排行"这类描述
+    bool isAnchorVisible(const QImage& screenshot, const QString& description) const;
+    // 是否能看到任一锚点（排除ignored中的描述）
+    bool anyAnchorVisible(const QImage& screenshot, const QStringList& ignored = QStringList()) const;
+
+    int size() const { return sceneAnchors.size() + flagAnchors.size(); }
+
+private:
+    struct Anchor {
+        QString key;
+        QString description;
+        QRect roi;
+        QString hash;
+        int order = 0;
+    };
+
+    bool matches(const QImage& screenshot, const Anchor& anchor) const;
+
+    HashFunction calculateHash;
+    QStringList sceneOrder;
+    QVector<Anchor> sceneAnchors;  // 已按sceneOrder排序
+    QVector<Anchor> flagAnchors;
+};
+
+#endif // SCENECLASSIFIER_H
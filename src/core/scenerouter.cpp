@@ -0,0 +1,163 @@
+#include "scenerouter.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QSet>
+#include <limits>
+
+namespace {
+
+const double LATENCY_SMOOTHING = 0.3;  // 新观测值的权重
+
+} // namespace
+
+SceneRouter::SceneRouter(SceneReader reader, ClickFunction click, Sleeper sleeper, const Config& config)
+    : readScene(std::move(reader)), clickAt(std::move(click)), sleep(std::move(sleeper)), settings(config)
+{
+}
+
+void SceneRouter::addTransition(const QString& from, const QString& to, const QPoint& click, int typicalLatencyMs)
+{
+    Transition transition;
+    transition.from = from;
+    transition.to = to;
+    transition.click = click;
+    transition.latencyMs = typicalLatencyMs;
+    outgoing[from].append(transitions.size());
+    transitions.append(transition);
+}
+
+double SceneRouter::expectedCostMs(int transitionIndex) const
+{
+    // 未到达规划落点的步骤（超时或被带到其他页面）需要重试，期望耗时按到达该落点的比例放大（先验为一次成功）
+    const Transition& transition = transitions[transitionIndex];
+    const int attempts = transition.successes + transition.redirects + transition.failures;
+    const double successRate = double(transition.landings.value(destination(transitionIndex)) + 1) / (attempts + 1);
+    return (transition.latencyMs + settings.clickCostMs) / successRate;
+}
+
+QString SceneRouter::destination(int transitionIndex) const
+{
+    const Transition& transition = transitions[transitionIndex];
+    QString best = transition.to;
+    int bestCount = transition.landings.value(transition.to);
+    for (auto it = transition.landings.constBegin(); it != transition.landings.constEnd(); ++it) {
+        if (it.value() > bestCount) {
+            best = it.key();
+            bestCount = it.value();
+        }
+    }
+    return best;
+}
+
+QVector<int> SceneRouter::plan(const QString& from, const QString& to) const
+{
+    if (from == to || !outgoing.contains(from)) {
+        return QVector<int>();
+    }
+
+    // 页面只有几个，直接用朴素的Dijkstra
+    QHash<QString, double> cost;
+    QHash<QString, int> via;  // 到达该页面的最后一条边
+    QSet<QString> done;
+    cost[from] = 0;
+
+    while (true) {
+        QString current;
+        double best = std::numeric_limits<double>::max();
+        for (auto it = cost.constBegin(); it != cost.constEnd(); ++it) {
+            if (!done.contains(it.key()) && it.value() < best) {
+                best = it.value();
+                current = it.key();
+            }
+        }
+        if (current.isEmpty() || current == to) {
+            break;
+        }
+        done.insert(current);
+
+        for (int index : outgoing.value(current)) {
+            const QString next = destination(index);
+            const double nextCost = best + expectedCostMs(index);
+            if (!cost.contains(next) || nextCost < cost[next]) {
+                cost[next] = nextCost;
+                via[next] = index;
+            }
+        }
+    }
+
+    if (!via.contains(to)) {
+        return QVector<int>();
+    }
+    QVector<int> route;
+    for (QString scene = to; scene != from; scene = transitions[via[scene]].from) {
+        route.prepend(via[scene]);
+    }
+    return route;
+}
+
+SceneRouter::HopResult SceneRouter::traverse(int transitionIndex)
+{
+    Transition& transition = transitions[transitionIndex];
+    const int timeoutMs = qMax(settings.minHopTimeoutMs, int(transition.latencyMs * settings.timeoutFactor));
+    counters.hops++;
+
+    HopResult result;
+    QElapsedTimer timer;
+    timer.start();
+    clickAt(transition.click);
+
+    // 点击后原页面还会保留一段时间，等到任一其他已知页面的锚点出现
+    while (timer.elapsed() < timeoutMs) {
+        if (!sleep(settings.pollIntervalMs)) {
+            break;
+        }
+        const QString scene = readScene();
+        if (!scene.isEmpty() && scene != transition.from) {
+            result.scene = scene;
+            break;
+        }
+    }
+    result.elapsedMs = int(timer.elapsed());
+
+    if (result.scene.isEmpty()) {
+        transition.failures++;
+        counters.failedHops++;
+        qDebug() << QString("页面切换超时：%1 -> %2，等待%3ms").arg(transition.from, transition.to).arg(result.elapsedMs);
+        return result;
+    }
+
+    const QString expected = destination(transitionIndex);
+    if (result.scene != expected) {
+        // 游戏记住了上次停留的分页等情况，落点多次不同后规划才会改用新落点
+        transition.redirects++;
+        counters.redirects++;
+        qDebug() << QString("页面切换落点与预期不同：%1 -> %2，实际到达%3")
+                    .arg(transition.from, expected, result.scene);
+    } else {
+        transition.successes++;
+        counters.arrivedHops++;
+    }
+    transition.landings[result.scene]++;
+    transition.latencyMs = transition.latencyMs * (1.0 - LATENCY_SMOOTHING) + result.elapsedMs * LATENCY_SMOOTHING;
+    result.arrived = true;
+    return result;
+}
+
+QStringList SceneRouter::scenes() const
+{
+    QStringList names;
+    for (const Transition& transition : transitions) {
+        if (!names.contains(transition.from)) {
+            names.append(transition.from);
+        }
+        if (!names.contains(transition.to)) {
+            names.append(transition.to);
+        }
+        for (auto it = transition.landings.constBegin(); it != transition.landings.constEnd(); ++it) {
+            if (!names.contains(it.key())) {
+                names.append(it.key());
+            }
+        }
+    }
+    return names;
+}
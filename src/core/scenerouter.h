@@ -0,0 +1,84 @@
+#ifndef SCENEROUTER_H
+#define SCENEROUTER_H
+
+#include <QHash>
+#include <QPoint>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <functional>
+
+// 场景路由：页面为节点、点击为边的导航图，按期望耗时最短规划从当前页面到目标页面的路线
+// 每一步点击后轮询页面锚点确认到达，不再固定等待；实际耗时和落点在线学习，
+// 每条边按实际落点分别计数，规划时使用到达次数最多的页面，偶发的落点偏差不会改写导航图
+class SceneRouter
+{
+public:
+    // 识别当前页面，返回页面名称，未识别返回空字符串
+    using SceneReader = std::function<QString()>;
+    using ClickFunction = std::function<void(const QPoint& position)>;
+    // 等待被中断（会话已停止）时返回false，调用方立即结束
+    using Sleeper = std::function<bool(int ms)>;
+
+    struct Config {
+        int pollIntervalMs = 30;     // 点击后识别页面的间隔
+        int minHopTimeoutMs = 1500;  // 单步等待到达的最短超时
+        double timeoutFactor = 4.0;  // 单步超时 = 期望耗时 * timeoutFactor
+        int clickCostMs = 150;       // 每次点击的固定代价，使路线优先选择点击次数少的
+    };
+
+    struct Transition {
+        QString from;
+        QString to;             // 添加时声明的目的页面
+        QPoint click;
+        double latencyMs = 0;   // 点击到目的页面锚点出现的平滑耗时
+        int successes = 0;      // 到达规划时的目的页面
+        int redirects = 0;      // 到达了其他已知页面
+        int failures = 0;       // 超时未到达任何已知页面
+        QHash<QString, int> landings;   // 实际落点 -> 到达次数
+    };
+
+    struct HopResult {
+        bool arrived = false;
+        QString scene;      // 步骤结束时识别到的页面
+        int elapsedMs = 0;
+    };
+
+    struct Stats {
+        int hops = 0;
+        int arrivedHops = 0;    // 到达预期页面
+        int redirects = 0;      // 落点与预期不同，不计入arrivedHops
+        int failedHops = 0;
+    };
+
+    SceneRouter(SceneReader reader, ClickFunction click, Sleeper sleeper, const Config& config = Config());
+
+    // typicalLatencyMs为初始估计，之后按实测值平滑更新
+    void addTransition(const QString& from, const QString& to, const QPoint& click, int typicalLatencyMs);
+
+    // 期望耗时最短的路线，返回边下标；from == to或不可达时返回空
+    QVector<int> plan(const QString& from, const QString& to) const;
+    double expectedCostMs(int transitionIndex) const;
+    // 规划使用的目的页面：到达次数最多的落点，与声明的目的页面次数相同时取后者
+    QString destination(int transitionIndex) const;
+
+    // 执行一步：点击并等待其他已知页面出现，识别到页面即arrived为true，落点记入该边的到达计数
+    HopResult traverse(int transitionIndex);
+
+    const Transition& transition(int index) const { return transitions[index]; }
+    QStringList scenes() const;
+    Stats stats() const { return counters; }
+    // 只清零统计，已学习的耗时和落点保留
+    void resetStats() { counters = Stats(); }
+
+private:
+    SceneReader readScene;
+    ClickFunction clickAt;
+    Sleeper sleep;
+    Config settings;
+    QVector<Transition> transitions;
+    QHash<QString, QVector<int>> outgoing;  // 页面 -> 出边下标
+    Stats counters;
+};
+
+#endif // SCENEROUTER_H
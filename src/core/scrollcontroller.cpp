@@ -0,0 +1,137 @@
+#include "scrollcontroller.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QtMath>
+
+namespace {
+
+const double GAIN_SMOOTHING = 0.5;  // 新观测值的权重
+const double MIN_GAIN = 0.25;       // 超出范围的观测（如拖动时画面卡住）不参与学习
+const double MAX_GAIN = 4.0;
+const double PITCH_SMOOTHING = 0.5;
+
+} // namespace
+
+ScrollController::ScrollController(const QString& name, PositionReader reader, DragFunction drag, Sleeper sleeper,
+                                   const Config& config)
+    : listName(name), readPosition(std::move(reader)), dragBy(std::move(drag)), sleep(std::move(sleeper)),
+      settings(config)
+{
+}
+
+int ScrollController::scrollTo(int target, int currentPosition)
+{
+    int position = currentPosition >= 0 ? currentPosition : readPosition();
+    target = qMax(0, target);
+    counters.moves++;
+
+    for (int attempt = 0; attempt < settings.maxDrags; ++attempt) {
+        const int error = target - position;
+        if (qAbs(error) <= settings.tolerance) {
+            return position;
+        }
+        if (error > 0 && trackEnd >= 0 && position >= trackEnd) {
+            // 已知已在轨道底端，不再拖动等待
+            return position;
+        }
+
+        // 比例控制：按已学到的增益把剩余误差换算成拖动距离
+        int distance = qRound(error / dragGain);
+        if (distance == 0) {
+            distance = error > 0 ? 1 : -1;
+        }
+        dragBy(settings.dragX, settings.dragOffsetY + position, qAbs(distance), distance > 0);
+        counters.drags++;
+        if (attempt > 0) {
+            counters.corrections++;
+        }
+
+        const int reached = waitForMove(position);
+        const int moved = reached - position;
+        if (moved == 0) {
+            // 已到列表顶端/底端，或拖动没有生效（游戏卡顿时一次拖动可能没有响应）
+            // 向下不动时只有底端标志可见，或同一位置第二次拖动仍不动，才记为底端
+            if (distance > 0) {
+                if ((atBottom && atBottom()) || unconfirmedEnd == position) {
+                    trackEnd = position;
+                    unconfirmedEnd = -1;
+                } else {
+                    unconfirmedEnd = position;
+                    qDebug() << QString("%1滚动条未移动：位置%2，再拖动一次确认是否到底").arg(listName).arg(position);
+                    continue;
+                }
+            }
+            qDebug() << QString("%1滚动条未移动：位置%2，目标%3").arg(listName).arg(position).arg(target);
+            return position;
+        }
+        unconfirmedEnd = -1;
+        if (trackEnd >= 0 && reached > trackEnd) {
+            trackEnd = -1;
+        }
+
+        const double observed = double(moved) / distance;
+        if (observed >= MIN_GAIN && observed <= MAX_GAIN) {
+            dragGain = dragGain * (1.0 - GAIN_SMOOTHING) + observed * GAIN_SMOOTHING;
+        }
+        position = reached;
+    }
+
+    if (qAbs(target - position) > settings.tolerance) {
+        counters.misses++;
+        qDebug() << QString("%1滚动未到达目标：位置%2，目标%3，增益%4")
+                    .arg(listName).arg(position).arg(target).arg(dragGain, 0, 'f', 3);
+    }
+    return position;
+}
+
+int ScrollController::scrollBy(int delta, int currentPosition)
+{
+    const int position = currentPosition >= 0 ? currentPosition : readPosition();
+    return scrollTo(position + delta, position);
+}
+
+int ScrollController::scrollRows(int rows, int currentPosition)
+{
+    return scrollBy(qRound(rows * pitch), currentPosition);
+}
+
+void ScrollController::observeRowPitch(int thumbDelta, double rows)
+{
+    if (thumbDelta <= 0 || rows < 0.5) {
+        return;
+    }
+    const double observed = thumbDelta / rows;
+    pitch = pitch > 0 ? pitch * (1.0 - PITCH_SMOOTHING) + observed * PITCH_SMOOTHING : observed;
+}
+
+void ScrollController::resetTrack()
+{
+    pitch = 0;
+    trackEnd = -1;
+    unconfirmedEnd = -1;
+}
+
+int ScrollController::waitForMove(int from)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int position = from;
+    while (position == from && timer.elapsed() < settings.moveTimeoutMs) {
+        if (!sleep(settings.pollIntervalMs)) {
+            return position;
+        }
+        position = readPosition();
+    }
+    // 移动后再读一次，两次一致才算停稳
+    while (timer.elapsed() < settings.settleTimeoutMs) {
+        if (!sleep(settings.pollIntervalMs)) {
+            break;
+        }
+        const int next = readPosition();
+        if (next == position) {
+            break;
+        }
+        position = next;
+    }
+    return position;
+}
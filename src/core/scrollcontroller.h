@@ -0,0 +1,80 @@
+#ifndef SCROLLCONTROLLER_H
+#define SCROLLCONTROLLER_H
+
+#include <QString>
+#include <functional>
+
+// 闭环滚动控制器：给定滚动条目标位置，拖动后读取滚动条实际位置，按比例修正剩余误差
+// 拖动距离与滚动条实际移动距离之比（增益）因列表长度、游戏卡顿而不同，每个列表各用一个控制器在线学习
+// 通常一次拖动即可到达，增益偏差较大时第二次拖动修正，不再需要回到顶部重新定位
+class ScrollController
+{
+public:
+    // 从滚动条所在列读取当前位置（滚动条顶端相对轨道顶端的像素数）
+    using PositionReader = std::function<int()>;
+    // 从(x, y)开始拖动distance像素
+    using DragFunction = std::function<void(int x, int y, int distance, bool downward)>;
+    // 等待被中断（会话已停止）时返回false，调用方立即结束
+    using Sleeper = std::function<bool(int ms)>;
+    // 读取当前画面是否显示轨道底端标志（滚动条底部图案）
+    using EndDetector = std::function<bool()>;
+
+    struct Config {
+        int dragX = 910;            // 拖动起点：(dragX, dragOffsetY + 当前位置)，即抓住滚动条
+        int dragOffsetY = 120;
+        int tolerance = 0;          // 允许的位置误差（像素）
+        int maxDrags = 3;           // 单次定位最多拖动次数
+        int moveTimeoutMs = 300;    // 拖动后滚动条一直不动即视为本次拖动没有移动
+        int settleTimeoutMs = 2000; // 滚动条开始移动后等待停稳的超时
+        int pollIntervalMs = 20;
+    };
+
+    struct Stats {
+        int moves = 0;          // scrollTo调用次数
+        int drags = 0;          // 实际拖动次数
+        int corrections = 0;    // 第二次及以后的修正拖动
+        int misses = 0;         // 用完拖动次数仍未到达目标
+    };
+
+    ScrollController(const QString& name, PositionReader reader, DragFunction drag, Sleeper sleeper,
+                     const Config& config = Config());
+
+    // 设置后，向下拖动不动时先检查底端标志，标志可见即确认到达底端；未设置时需同一位置再拖一次仍不动才确认
+    void setEndDetector(EndDetector detector) { atBottom = std::move(detector); }
+
+    // 滚动到目标位置并返回实际到达的位置；currentPosition为识别时同一帧读出的位置，传-1时重新读取
+    int scrollTo(int target, int currentPosition = -1);
+    int scrollBy(int delta, int currentPosition = -1);
+    // 按行滚动，每行对应rowPitch()像素
+    int scrollRows(int rows, int currentPosition = -1);
+
+    // 观测到滚动条移动thumbDelta像素时列表内容移动了rows行，平滑更新行距
+    void observeRowPitch(int thumbDelta, double rows);
+    void setRowPitch(double pixelsPerRow) { pitch = pixelsPerRow; }
+    double rowPitch() const { return pitch; }
+    // 列表长度变化后之前学到的行距和轨道底端都不再有效
+    void resetTrack();
+    // position是否为已确认的轨道底端
+    bool isAtTrackEnd(int position) const { return trackEnd >= 0 && position >= trackEnd; }
+    // 滚动条实际移动距离 / 拖动距离
+    double gain() const { return dragGain; }
+    Stats stats() const { return counters; }
+
+private:
+    // 等待滚动条离开from并停稳，超时返回最后读到的位置
+    int waitForMove(int from);
+
+    QString listName;
+    PositionReader readPosition;
+    DragFunction dragBy;
+    Sleeper sleep;
+    EndDetector atBottom;
+    Config settings;
+    double dragGain = 1.0;
+    double pitch = 0;
+    int trackEnd = -1;          // 已确认的轨道底端位置，-1为未知
+    int unconfirmedEnd = -1;    // 向下拖动不动但尚未确认为底端的位置（可能只是游戏卡顿没有响应）
+    Stats counters;
+};
+
+#endif // SCROLLCONTROLLER_H
@@ -0,0 +1,400 @@
+#include "sessionrecorder.h"
+#include <QBuffer>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QPair>
+#include <QRunnable>
+
+namespace {
+
+const int MAX_PENDING_FRAMES = 4;
+
+class CompressJob : public QRunnable
+{
+public:
+    explicit CompressJob(std::function<void()> task) : task(std::move(task)) {}
+    void run() override { task(); }
+
+private:
+    std::function<void()> task;
+};
+
+} // namespace
+
+SessionRecorder::SessionRecorder(int maxEvents, int maxFrames, int frameIntervalMs)
+    : maxEventCount(maxEvents), maxFrameCount(maxFrames), frameInterval(frameIntervalMs)
+{
+    // 单线程压缩，保证帧按录制顺序入库
+    compressor.setMaxThreadCount(1);
+    clock.start();
+}
+
+SessionRecorder::~SessionRecorder()
+{
+    recording.store(false);
+    compressor.waitForDone();
+}
+
+void SessionRecorder::recordFrame(const QImage& frame)
+{
+    if (!recording.load() || frame.isNull()) {
+        return;
+    }
+
+    quint64 frameId = 0;
+    {
+        QMutexLocker locker(&mutex);
+        qint64 now = clock.elapsed();
+        if (lastFrameTime >= 0 && now - lastFrameTime < frameInterval) {
+            return;
+        }
+        if (pendingFrames.load() >= MAX_PENDING_FRAMES) {
+            counters.droppedFrames++;
+            return;
+        }
+        lastFrameTime = now;
+        frameId = nextFrameId++;
+
+        SessionEvent event;
+        event.type = SessionEvent::Frame;
+        event.timestamp = now;
+        event.frameId = frameId;
+        appendEvent(event);
+    }
+
+    // QImage隐式共享，这里只增加引用计数，哈希和压缩都在后台线程
+    pendingFrames.fetch_add(1);
+    compressor.start(new CompressJob([this, frameId, frame]() {
+        storeFrame(frameId, frame);
+        pendingFrames.fetch_sub(1);
+    }));
+}
+
+void SessionRecorder::recordClick(int x, int y)
+{
+    if (!recording.load()) {
+        return;
+    }
+    SessionEvent event;
+    event.type = SessionEvent::Click;
+    event.position = QPoint(x, y);
+
+    QMutexLocker locker(&mutex);
+    event.timestamp = clock.elapsed();
+    appendEvent(event);
+}
+
+void SessionRecorder::recordDrag(int x, int y, int distance, bool downward)
+{
+    if (!recording.load()) {
+        return;
+    }
+    SessionEvent event;
+    event.type = SessionEvent::Drag;
+    event.position = QPoint(x, y);
+    event.value = downward ? distance : -distance;
+
+    QMutexLocker locker(&mutex);
+    event.timestamp = clock.elapsed();
+    appendEvent(event);
+}
+
+void SessionRecorder::recordRecognition(const QString& name, const QString& result, qint64 durationMs)
+{
+    if (!recording.load()) {
+        return;
+    }
+    SessionEvent event;
+    event.type = SessionEvent::Recognition;
+    event.name = name;
+    event.detail = result;
+    event.value = static_cast<int>(durationMs);
+
+    QMutexLocker locker(&mutex);
+    event.timestamp = clock.elapsed();
+    appendEvent(event);
+}
+
+void SessionRecorder::appendEvent(const SessionEvent& event)
+{
+    events.enqueue(event);
+    while (events.size() > maxEventCount) {
+        evictOldest();
+    }
+}
+
+void SessionRecorder::evictOldest()
+{
+    SessionEvent event = events.dequeue();
+    if (event.type != SessionEvent::Frame) {
+        return;
+    }
+    firstRetainedFrameId = event.frameId + 1;
+
+    // 帧尚未压缩完成时，storeFrame发现事件已被淘汰会直接丢弃
+    auto keyIt = frameKeys.find(event.frameId);
+    if (keyIt == frameKeys.end()) {
+        return;
+    }
+    auto frameIt = storedFrames.find(keyIt.value());
+    if (frameIt != storedFrames.end() && --frameIt->refs <= 0) {
+        counters.compressedBytes -= frameIt->png.size();
+        storedFrames.erase(frameIt);
+    }
+    frameKeys.erase(keyIt);
+}
+
+void SessionRecorder::storeFrame(quint64 frameId, const QImage& frame)
+{
+    const quint64 key = frameContentKey(frame);
+
+    {
+        QMutexLocker locker(&mutex);
+        if (frameId < firstRetainedFrameId) {
+            return;
+        }
+        auto it = storedFrames.find(key);
+        if (it != storedFrames.end()) {
+            it->refs++;
+            frameKeys.insert(frameId, key);
+            return;
+        }
+    }
+
+    // 压缩在锁外进行，不阻塞录制线程
+    QByteArray png;
+    QBuffer buffer(&png);
+    buffer.open(QIODevice::WriteOnly);
+    frame.save(&buffer, "PNG");
+
+    QMutexLocker locker(&mutex);
+    if (frameId < firstRetainedFrameId) {
+        return;
+    }
+    StoredFrame& stored = storedFrames[key];
+    stored.png = png;
+    stored.refs = 1;
+    frameKeys.insert(frameId, key);
+    counters.compressedBytes += png.size();
+
+    // 去重后的帧数超出上限时淘汰最早的事件
+    while (storedFrames.size() > maxFrameCount && !events.isEmpty()) {
+        evictOldest();
+    }
+}
+
+quint64 SessionRecorder::frameContentKey(const QImage& frame)
+{
+    const uchar* bits = frame.constBits();
+    const size_t size = static_cast<size_t>(frame.sizeInBytes());
+    quint64 high = qHashBits(bits, size, 0x9e3779b9u);
+    quint64 low = qHashBits(bits, size, 0x7f4a7c15u);
+    return (high << 32) ^ low ^ (quint64(frame.width()) << 48) ^ quint64(frame.height());
+}
+
+bool SessionRecorder::dump(const QString& path)
+{
+    compressor.waitForDone();
+    return writeSession(path);
+}
+
+void SessionRecorder::dumpAsync(const QString& path, std::function<void(bool ok)> done)
+{
+    // 压缩线程是单线程的，写出任务执行时之前入队的帧都已入库
+    compressor.start(new CompressJob([this, path, done]() {
+        const bool ok = writeSession(path);
+        if (done) {
+            done(ok);
+        }
+    }));
+}
+
+bool SessionRecorder::writeSession(const QString& path)
+{
+    QVector<QPair<quint64, QByteArray>> frames;
+    QVector<SessionEvent> written;
+    {
+        QMutexLocker locker(&mutex);
+        frames.reserve(storedFrames.size());
+        for (auto it = storedFrames.constBegin(); it != storedFrames.constEnd(); ++it) {
+            frames.append(qMakePair(it.key(), it->png));
+        }
+
+        // 压缩被丢弃的帧事件不写出
+        written.reserve(events.size());
+        for (const SessionEvent& event : events) {
+            if (event.type != SessionEvent::Frame) {
+                written.append(event);
+            } else if (frameKeys.contains(event.frameId)) {
+                written.append(event);
+                written.last().frameKey = frameKeys.value(event.frameId);
+            }
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qDebug() << "会话文件写入失败:" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    stream << FILE_MAGIC << FILE_VERSION;
+
+    stream << quint32(frames.size());
+    for (const auto& frame : frames) {
+        stream << frame.first << frame.second;
+    }
+
+    stream << quint32(written.size());
+    for (const SessionEvent& event : written) {
+        stream << quint8(event.type) << event.timestamp << event.position << qint32(event.value)
+               << event.name << event.detail << event.frameKey;
+    }
+
+    qDebug() << QString("会话已导出：%1，事件%2条，帧%3张，%4KB")
+                .arg(path).arg(written.size()).arg(frames.size()).arg(file.size() / 1024);
+    return stream.status() == QDataStream::Ok;
+}
+
+void SessionRecorder::pruneSessionFiles(const QString& directory, int keepFiles)
+{
+    QDir dir(directory);
+    // 按修改时间从新到旧排列
+    const QFileInfoList files = dir.entryInfoList(QStringList() << "*.fvmsession", QDir::Files, QDir::Time);
+    for (int i = keepFiles; i < files.size(); ++i) {
+        QFile::remove(files[i].absoluteFilePath());
+    }
+}
+
+void SessionRecorder::clear()
+{
+    compressor.waitForDone();
+    QMutexLocker locker(&mutex);
+    events.clear();
+    firstRetainedFrameId = nextFrameId;
+    frameKeys.clear();
+    storedFrames.clear();
+    counters = Stats();
+    lastFrameTime = -1;
+}
+
+SessionRecorder::Stats SessionRecorder::stats() const
+{
+    QMutexLocker locker(&mutex);
+    Stats result = counters;
+    result.events = events.size();
+    result.frames = storedFrames.size();
+    return result;
+}
+
+bool SessionPlayer::open(const QString& path)
+{
+    eventList.clear();
+    frameEventIndexes.clear();
+    frameData.clear();
+    rewind();
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "会话文件打开失败:" << path;
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0, version = 0;
+    stream >> magic >> version;
+    if (magic != SessionRecorder::FILE_MAGIC || version != SessionRecorder::FILE_VERSION) {
+        qDebug() << "会话文件格式不支持:" << path;
+        return false;
+    }
+
+    quint32 frameCount = 0;
+    stream >> frameCount;
+    for (quint32 i = 0; i < frameCount && stream.status() == QDataStream::Ok; ++i) {
+        quint64 key = 0;
+        QByteArray png;
+        stream >> key >> png;
+        frameData.insert(key, png);
+    }
+
+    quint32 eventCount = 0;
+    stream >> eventCount;
+    eventList.reserve(eventCount);
+    for (quint32 i = 0; i < eventCount && stream.status() == QDataStream::Ok; ++i) {
+        SessionEvent event;
+        quint8 type = 0;
+        qint32 value = 0;
+        stream >> type >> event.timestamp >> event.position >> value >> event.name >> event.detail >> event.frameKey;
+        event.type = static_cast<SessionEvent::Type>(type);
+        event.value = value;
+        if (event.type == SessionEvent::Frame) {
+            frameEventIndexes.append(eventList.size());
+        }
+        eventList.append(event);
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        qDebug() << "会话文件内容不完整:" << path;
+        return false;
+    }
+    qDebug() << QString("会话加载完成：%1，事件%2条，帧%3张").arg(path).arg(eventList.size()).arg(frameData.size());
+    return true;
+}
+
+void SessionPlayer::rewind()
+{
+    current = -1;
+    currentFrame = QImage();
+}
+
+bool SessionPlayer::atEnd() const
+{
+    return current >= frameEventIndexes.size() - 1;
+}
+
+QImage SessionPlayer::frame(quint64 frameKey) const
+{
+    QImage image;
+    if (!image.loadFromData(frameData.value(frameKey), "PNG")) {
+        return QImage();
+    }
+    // 与实时截图保持相同的像素格式
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+QImage SessionPlayer::grab()
+{
+    if (frameEventIndexes.isEmpty()) {
+        return QImage();
+    }
+    if (current + 1 < frameEventIndexes.size()) {
+        current++;
+        currentFrame = frame(eventList[frameEventIndexes[current]].frameKey);
+    }
+    return currentFrame;
+}
+
+qint64 SessionPlayer::timestamp() const
+{
+    return current >= 0 ? eventList[frameEventIndexes[current]].timestamp : 0;
+}
+
+QVector<qint64> SessionPlayer::profile(const std::function<void(const QImage&)>& job)
+{
+    QVector<qint64> durations;
+    durations.reserve(frameEventIndexes.size());
+    for (int index : frameEventIndexes) {
+        // 解码不计入耗时
+        QImage image = frame(eventList[index].frameKey);
+        QElapsedTimer timer;
+        timer.start();
+        job(image);
+        durations.append(timer.elapsed());
+    }
+    return durations;
+}
@@ -0,0 +1,133 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include "framesource.h"
+#include <QElapsedTimer>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QPoint>
+#include <QQueue>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+#include <atomic>
+#include <functional>
+
+// 会话事件：截图帧、点击、拖动和识别结果
+struct SessionEvent
+{
+    enum Type : quint8 {
+        Frame = 0,
+        Click = 1,
+        Drag = 2,
+        Recognition = 3
+    };
+
+    Type type = Frame;
+    qint64 timestamp = 0;   // 相对录制开始的毫秒数
+    QPoint position;        // 点击/拖动起点坐标
+    int value = 0;          // 拖动距离（向下为正）或识别耗时（毫秒）
+    QString name;           // 识别项目名称
+    QString detail;         // 识别结果
+    quint64 frameKey = 0;   // 帧内容哈希，相同画面只保存一次
+    quint64 frameId = 0;    // 录制时的帧序号，不写入文件
+};
+
+// 会话录制器：在有界环形缓冲区中记录最近的截图、输入和识别结果，出现异常时导出为会话文件
+// 帧的去重和PNG压缩在后台线程完成，录制线程只做一次入队
+class SessionRecorder
+{
+public:
+    struct Stats {
+        int events = 0;
+        int frames = 0;             // 去重后保存的帧数
+        int droppedFrames = 0;      // 后台压缩积压时丢弃的帧数
+        qint64 compressedBytes = 0;
+    };
+
+    // maxEvents/maxFrames限制环形缓冲区大小，frameIntervalMs内的多次截图只记录第一帧
+    explicit SessionRecorder(int maxEvents = 4096, int maxFrames = 200, int frameIntervalMs = 200);
+    ~SessionRecorder();
+
+    void setEnabled(bool enabled) { recording.store(enabled); }
+    bool isEnabled() const { return recording.load(); }
+
+    void recordFrame(const QImage& frame);
+    void recordClick(int x, int y);
+    void recordDrag(int x, int y, int distance, bool downward);
+    void recordRecognition(const QString& name, const QString& result, qint64 durationMs);
+
+    // 等待后台压缩完成后写出当前缓冲区内容
+    bool dump(const QString& path);
+    // 排在已入队的压缩任务之后由后台线程写出，不阻塞调用线程；done在后台线程调用
+    void dumpAsync(const QString& path, std::function<void(bool ok)> done = nullptr);
+    void clear();
+    Stats stats() const;
+
+    // 删除目录中较早的会话文件，只保留最近的keepFiles个
+    static void pruneSessionFiles(const QString& directory, int keepFiles);
+
+    static const quint32 FILE_MAGIC = 0x46565353; // "FVSS"
+    static const quint32 FILE_VERSION = 1;
+
+private:
+    struct StoredFrame {
+        QByteArray png;
+        int refs = 0;
+    };
+
+    // 持锁复制缓冲区内容（PNG数据隐式共享）后在锁外写文件
+    bool writeSession(const QString& path);
+    void appendEvent(const SessionEvent& event);
+    void evictOldest();
+    void storeFrame(quint64 frameId, const QImage& frame);
+    static quint64 frameContentKey(const QImage& frame);
+
+    int maxEventCount;
+    int maxFrameCount;
+    int frameInterval;
+    std::atomic<bool> recording{true};
+    std::atomic<int> pendingFrames{0};
+
+    mutable QMutex mutex;
+    QElapsedTimer clock;
+    qint64 lastFrameTime = -1;
+    quint64 nextFrameId = 1;
+    quint64 firstRetainedFrameId = 1;           // 更早的帧事件已被淘汰
+    QQueue<SessionEvent> events;
+    QHash<quint64, quint64> frameKeys;          // 帧序号 -> 帧内容哈希（压缩完成后写入）
+    QHash<quint64, StoredFrame> storedFrames;   // 帧内容哈希 -> PNG数据
+    Stats counters;
+
+    QThreadPool compressor;
+};
+
+// 会话回放：读取会话文件，按录制顺序把帧交给识别代码，用于离线复现和性能分析
+class SessionPlayer : public FrameSource
+{
+public:
+    bool open(const QString& path);
+    void rewind();
+    bool atEnd() const override;
+
+    const QVector<SessionEvent>& sessionEvents() const { return eventList; }
+    int frameEventCount() const { return frameEventIndexes.size(); }
+    QImage frame(quint64 frameKey) const;
+
+    // 每次返回下一帧录制画面，到末尾后保持最后一帧
+    QImage grab() override;
+    qint64 timestamp() const override;
+
+    // 对每个录制帧执行job，返回每帧耗时（毫秒）
+    QVector<qint64> profile(const std::function<void(const QImage&)>& job);
+
+private:
+    QVector<SessionEvent> eventList;
+    QVector<int> frameEventIndexes;
+    QHash<quint64, QByteArray> frameData;
+    int current = -1;
+    QImage currentFrame;
+};
+
+#endif // SESSIONRECORDER_H
@@ -0,0 +1,113 @@
+#include "settledetector.h"
+#include <QElapsedTimer>
+#include <QThread>
+#include <QDebug>
+#include <cstdlib>
+
+SettleDetector::SettleDetector(FrameGrabber grabber, Sleeper sleeper)
+    : grabFrame(grabber), sleepFor(sleeper)
+{
+    if (!sleepFor) {
+        sleepFor = [](int ms) { QThread::msleep(ms); };
+    }
+}
+
+double SettleDetector::regionDifference(const QImage& previous, const QImage& current, const QRect& roi)
+{
+    if (previous.isNull() || current.isNull() || previous.size() != current.size()) {
+        return 255.0;
+    }
+
+    QRect area = roi.isNull() ? previous.rect() : roi.intersected(previous.rect());
+    if (area.isEmpty()) {
+        return 255.0;
+    }
+
+    // 截图均为32位格式，其他格式先转换
+    const QImage a = previous.depth() == 32 ? previous : previous.convertToFormat(QImage::Format_RGB32);
+    const QImage b = current.depth() == 32 ? current : current.convertToFormat(QImage::Format_RGB32);
+
+    qint64 sum = 0;
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        const QRgb* lineA = reinterpret_cast<const QRgb*>(a.constScanLine(y));
+        const QRgb* lineB = reinterpret_cast<const QRgb*>(b.constScanLine(y));
+        for (int x = area.left(); x <= area.right(); ++x) {
+            // 整数近似灰度：(r*11 + g*16 + b*5) / 32
+            int grayA = (qRed(lineA[x]) * 11 + qGreen(lineA[x]) * 16 + qBlue(lineA[x]) * 5) >> 5;
+            int grayB = (qRed(lineB[x]) * 11 + qGreen(lineB[x]) * 16 + qBlue(lineB[x]) * 5) >> 5;
+            sum += std::abs(grayA - grayB);
+        }
+    }
+
+    return static_cast<double>(sum) / (static_cast<qint64>(area.width()) * area.height());
+}
+
+SettleResult SettleDetector::waitForSettle(const QRect& roi, const SettleOptions& options) const
+{
+    SettleResult result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QImage previous = grabFrame();
+    result.frames = 1;
+    if (previous.isNull()) {
+        qDebug() << "稳定检测：获取初始帧失败";
+        return result;
+    }
+
+    // 阶段1：等待画面开始变化（点击后游戏响应存在延迟，避免在动画开始前误判为稳定）
+    if (options.waitForChangeMs > 0) {
+        const QImage baseline = previous;
+        while (timer.elapsed() < options.waitForChangeMs && timer.elapsed() < options.timeoutMs) {
+            if (stopPredicate && stopPredicate()) {
+                result.settleMs = static_cast<int>(timer.elapsed());
+                return result;
+            }
+            sleepFor(options.pollIntervalMs);
+            QImage current = grabFrame();
+            if (current.isNull()) {
+                continue;
+            }
+            result.frames++;
+            previous = current;
+            if (regionDifference(baseline, current, roi) > options.threshold) {
+                result.changed = true;
+                break;
+            }
+        }
+    }
+
+    // 阶段2：连续stableFrames帧差异低于阈值即视为稳定
+    int stableCount = 0;
+    while (timer.elapsed() < options.timeoutMs) {
+        if (stopPredicate && stopPredicate()) {
+            break;
+        }
+        sleepFor(options.pollIntervalMs);
+        QImage current = grabFrame();
+        if (current.isNull()) {
+            // 没有新帧，不计入连续稳定帧数
+            continue;
+        }
+        result.frames++;
+
+        result.lastDiff = regionDifference(previous, current, roi);
+        previous = current;
+
+        if (result.lastDiff <= options.threshold) {
+            if (++stableCount >= options.stableFrames) {
+                result.stable = true;
+                break;
+            }
+        } else {
+            result.changed = true;
+            stableCount = 0;
+        }
+    }
+
+    result.settleMs = static_cast<int>(timer.elapsed());
+    if (!result.stable) {
+        qDebug() << QString("稳定检测超时：%1ms，最后差异 %2").arg(result.settleMs).arg(result.lastDiff, 0, 'f', 2);
+    }
+    return result;
+}
@@ -0,0 +1,60 @@
+#ifndef SETTLEDETECTOR_H
+#define SETTLEDETECTOR_H
+
+#include <QImage>
+#include <QRect>
+#include <functional>
+
+// 画面稳定检测结果
+struct SettleResult {
+    bool stable;                // 是否在超时前稳定
+    bool changed;               // 等待期间是否观察到画面变化
+    int settleMs;               // 实际等待耗时（毫秒）
+    int frames;                 // 共比较的帧数（不含没有新帧的轮询）
+    double lastDiff;            // 最后一次相邻帧差异（灰度平均绝对差）
+
+    SettleResult() : stable(false), changed(false), settleMs(0), frames(0), lastDiff(0.0) {}
+};
+
+// 画面稳定检测参数
+struct SettleOptions {
+    int stableFrames;           // 连续多少帧差异低于阈值视为稳定
+    double threshold;           // 相邻帧灰度平均绝对差阈值（0-255）
+    int timeoutMs;              // 最长等待时间
+    int pollIntervalMs;         // 采样间隔
+    int waitForChangeMs;        // 先等待画面开始变化的最长时间，0表示不等待
+
+    SettleOptions(int timeout = 1000, int frames = 3, double diffThreshold = 1.5,
+                  int interval = 15, int changeWait = 0)
+        : stableFrames(frames), threshold(diffThreshold), timeoutMs(timeout),
+          pollIntervalMs(interval), waitForChangeMs(changeWait) {}
+};
+
+// 动画稳定检测器：在连续帧中观察指定区域，直到画面不再变化
+// 用于替代点击后固定时长的等待，快机器动画结束即可继续，慢机器按实际需要等待
+class SettleDetector
+{
+public:
+    // 每次返回与上一帧不同的新帧，暂时没有新帧时返回空图像（跳过，不计入稳定帧数）
+    using FrameGrabber = std::function<QImage()>;
+    using Sleeper = std::function<void(int)>;
+    using StopPredicate = std::function<bool()>;
+
+    explicit SettleDetector(FrameGrabber grabber, Sleeper sleeper = Sleeper());
+
+    // 等待区域稳定，roi为空时比较整帧
+    SettleResult waitForSettle(const QRect& roi, const SettleOptions& options = SettleOptions()) const;
+
+    // 设置中断条件，返回true时立即结束等待
+    void setStopPredicate(StopPredicate predicate) { stopPredicate = predicate; }
+
+    // 计算两帧在指定区域内的灰度平均绝对差
+    static double regionDifference(const QImage& previous, const QImage& current, const QRect& roi);
+
+private:
+    FrameGrabber grabFrame;
+    Sleeper sleepFor;
+    StopPredicate stopPredicate;
+};
+
+#endif // SETTLEDETECTOR_H
@@ -0,0 +1,176 @@
+#include "sharedframering.h"
+#include <QDebug>
+#include <atomic>
+#include <cstring>
+#include <new>
+
+namespace {
+
+const quint32 RING_MAGIC = 0x46565246; // "FVRF"
+const quint32 RING_VERSION = 1;
+
+} // namespace
+
+// 共享内存中的原子变量要求无锁实现，否则两个进程各自的锁互不可见
+static_assert(std::atomic<quint64>::is_always_lock_free, "共享内存中的原子变量必须无锁");
+
+struct SharedFrameRing::Header
+{
+    quint32 magic;
+    quint32 version;
+    qint32 slotCount;
+    qint32 slotStride;
+    qint32 maxWidth;
+    qint32 maxHeight;
+    std::atomic<quint64> lastSequence;
+};
+
+struct SharedFrameRing::SlotHeader
+{
+    std::atomic<quint64> sequence;  // 0表示正在写入或为空
+    qint64 timestamp;
+    qint32 width;
+    qint32 height;
+    qint32 bytesPerLine;
+    qint32 reserved;
+
+    uchar* pixels() { return reinterpret_cast<uchar*>(this + 1); }
+};
+
+SharedFrameRing::SharedFrameRing(const QString& key, int slotCount, const QSize& maxFrameSize)
+    : memory(key), slots(slotCount), maxSize(maxFrameSize)
+{
+    // 槽位按64字节对齐，避免相邻槽位的序号落在同一缓存行
+    const int pixelBytes = maxSize.width() * 4 * maxSize.height();
+    slotStride = (int(sizeof(SlotHeader)) + pixelBytes + 63) & ~63;
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+    detach();
+}
+
+bool SharedFrameRing::create()
+{
+    const int headerBytes = (int(sizeof(Header)) + 63) & ~63;
+    const int totalBytes = headerBytes + slots * slotStride;
+
+    if (!memory.create(totalBytes)) {
+        if (memory.error() != QSharedMemory::AlreadyExists) {
+            qDebug() << "帧环共享内存创建失败:" << memory.errorString();
+            return false;
+        }
+        // Linux上进程崩溃后共享内存段不会自动删除，连接后再断开即可释放
+        memory.attach();
+        memory.detach();
+        if (!memory.create(totalBytes)) {
+            qDebug() << "帧环共享内存创建失败:" << memory.errorString();
+            return false;
+        }
+    }
+
+    uchar* base = static_cast<uchar*>(memory.data());
+    memset(base, 0, size_t(totalBytes));
+    header = new (base) Header;
+    header->magic = RING_MAGIC;
+    header->version = RING_VERSION;
+    header->slotCount = slots;
+    header->slotStride = slotStride;
+    header->maxWidth = maxSize.width();
+    header->maxHeight = maxSize.height();
+    header->lastSequence.store(0);
+    for (int i = 0; i < slots; ++i) {
+        new (base + headerBytes + i * slotStride) SlotHeader{};
+    }
+    return true;
+}
+
+bool SharedFrameRing::attach()
+{
+    if (!memory.attach(QSharedMemory::ReadOnly)) {
+        qDebug() << "帧环共享内存连接失败:" << memory.errorString();
+        return false;
+    }
+    Header* mapped = static_cast<Header*>(const_cast<void*>(memory.constData()));
+    if (mapped->magic != RING_MAGIC || mapped->version != RING_VERSION) {
+        qDebug() << "帧环格式不匹配:" << memory.key();
+        memory.detach();
+        return false;
+    }
+    // 以创建方写入的布局为准
+    slots = mapped->slotCount;
+    slotStride = mapped->slotStride;
+    maxSize = QSize(mapped->maxWidth, mapped->maxHeight);
+    header = mapped;
+    return true;
+}
+
+void SharedFrameRing::detach()
+{
+    header = nullptr;
+    if (memory.isAttached()) {
+        memory.detach();
+    }
+}
+
+SharedFrameRing::SlotHeader* SharedFrameRing::slot(int index) const
+{
+    const int headerBytes = (int(sizeof(Header)) + 63) & ~63;
+    uchar* base = reinterpret_cast<uchar*>(header);
+    return reinterpret_cast<SlotHeader*>(base + headerBytes + index * slotStride);
+}
+
+quint64 SharedFrameRing::publish(const QImage& frame)
+{
+    if (!header || frame.isNull() || frame.width() > maxSize.width() || frame.height() > maxSize.height()) {
+        return 0;
+    }
+    QImage source = frame.format() == QImage::Format_ARGB32_Premultiplied
+                    ? frame : frame.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+
+    QMutexLocker locker(&writeMutex);
+    const quint64 sequence = header->lastSequence.load(std::memory_order_relaxed) + 1;
+    SlotHeader* target = slot(int(sequence % quint64(slots)));
+
+    target->sequence.store(0, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_release);
+    target->timestamp = 0;
+    target->width = source.width();
+    target->height = source.height();
+    target->bytesPerLine = source.width() * 4;
+    for (int y = 0; y < source.height(); ++y) {
+        memcpy(target->pixels() + size_t(y) * target->bytesPerLine, source.constScanLine(y), size_t(target->bytesPerLine));
+    }
+    target->sequence.store(sequence, std::memory_order_release);
+    header->lastSequence.store(sequence, std::memory_order_release);
+    return sequence;
+}
+
+QImage SharedFrameRing::read(quint64 sequence) const
+{
+    if (!header || sequence == 0) {
+        return QImage();
+    }
+    SlotHeader* source = slot(int(sequence % quint64(slots)));
+    if (source->sequence.load(std::memory_order_acquire) != sequence) {
+        return QImage();
+    }
+
+    const int width = source->width;
+    const int height = source->height;
+    const int bytesPerLine = source->bytesPerLine;
+    if (width <= 0 || height <= 0 || width > maxSize.width() || height > maxSize.height()) {
+        return QImage();
+    }
+    QImage frame(width, height, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < height; ++y) {
+        memcpy(frame.scanLine(y), source->pixels() + size_t(y) * bytesPerLine, size_t(width) * 4);
+    }
+
+    // 复制期间槽位被改写则丢弃
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (source->sequence.load(std::memory_order_relaxed) != sequence) {
+        return QImage();
+    }
+    return frame;
+}
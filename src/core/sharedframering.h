@@ -0,0 +1,46 @@
+#ifndef SHAREDFRAMERING_H
+#define SHAREDFRAMERING_H
+
+#include <QImage>
+#include <QMutex>
+#include <QSharedMemory>
+#include <QString>
+
+// 跨进程帧环：截图进程把帧写入共享内存中的固定槽位，识别进程按帧序号读取
+// QSharedMemory在Windows上是文件映射，在Linux上是系统共享内存段
+// 每个槽位用序号做顺序锁：写入前清零、写完后写入帧序号，读取前后序号一致才算读到完整的帧
+class SharedFrameRing
+{
+public:
+    // 单个槽位最多容纳maxWidth x maxHeight的ARGB32帧
+    explicit SharedFrameRing(const QString& key, int slotCount = 4, const QSize& maxFrameSize = QSize(950, 596));
+    ~SharedFrameRing();
+
+    // 截图进程：创建共享内存；残留的同名共享内存（上次崩溃留下）会先清理
+    bool create();
+    // 识别进程：以只读方式连接
+    bool attach();
+    void detach();
+    bool isValid() const { return header != nullptr; }
+    QString key() const { return memory.key(); }
+
+    // 写入一帧，返回帧序号（从1开始），失败返回0；多个线程写入时互斥
+    quint64 publish(const QImage& frame);
+    // 读取指定序号的帧，槽位已被更新的帧覆盖时返回空图像
+    QImage read(quint64 sequence) const;
+
+private:
+    struct Header;
+    struct SlotHeader;
+
+    SlotHeader* slot(int index) const;
+
+    QSharedMemory memory;
+    int slots;
+    QSize maxSize;
+    int slotStride = 0;
+    Header* header = nullptr;
+    QMutex writeMutex;
+};
+
+#endif // SHAREDFRAMERING_H
@@ -49,6 +49,7 @@
 #include <QtMath>
 #include <QScrollBar>
 #include <QRegularExpression>
+#include <QScopeGuard>
 #include <map>
 
 // RGB颜色分量提取宏定义(rgb为0x00RRGGBB类型)
@@ -64,6 +65,7 @@ int DPI = 96;  // 默认 DPI 值为 96，即 100% 缩  放
 const QPoint StarryCard::CARD_ENHANCE_POS(94, 326);      // 卡片强化按钮位置
 const QPoint StarryCard::CARD_PRODUCE_POS(94, 260);      // 卡片制作按钮位置
 const QPoint StarryCard::SYNTHESIS_HOUSE_POS(675, 556);  // 合成屋按钮位置
+const QPoint StarryCard::SYNTHESIS_HOUSE_CLOSE_POS(914, 40); // 合成屋右上角关闭按钮位置
 const QPoint StarryCard::ENHANCE_SCROLL_TOP(910, 120);    // 强化滚动条顶部位置
 
 // 定义全局强化配置数据实例
@@ -71,6 +73,7 @@ GlobalEnhancementConfig g_enhancementConfig;
 GlobalSpiceConfig g_spiceConfig;
 CardProduceConfig g_cardProduceConfig;
 ProductionStatistics g_productionStats;
+EnhancementStatistics g_enhancementStats;
 
 StarryCard::StarryCard(QWidget *parent)
     : QMainWindow(parent)
@@ -148,25 +151,106 @@ StarryCard::StarryCard(QWidget *parent)
     
     // 加载制卡统计数据
     loadProductionStatistics();
+    loadEnhancementStatistics();
     
     // 初始化位置模板
     loadPositionTemplates();
 
     // 初始化合成屋内卡片位置模板
     loadSynHousePosTemplates();
+
+    // 初始化弹窗模板
+    loadPopupTemplates();
     
     // 初始化 RecipeRecognizer
     recipeRecognizer = new RecipeRecognizer();
+    recipeRecognizer->setSleeper([this](int ms) { sleepByQElapsedTimer(ms); });
     
     // 回调函数已移除，RecipeRecognizer现在直接实现这些功能
     
     // 初始化配方识别模板
     recipeRecognizer->loadRecipeTemplates();
+
+    // 初始化物品数量识别
+    digitRecognizer = new DigitRecognizer();
+    digitRecognizer->loadGlyphTemplates();
+
+    // 初始化会话录制，保留最近的截图、操作和识别结果
+    sessionRecorder = new SessionRecorder();
+
+    // 初始化单帧并行识别线程池
+    frameAnalyzer = new FrameAnalyzer(3);
+
+    // 初始化帧源，默认实时截取游戏窗口；所有实时截图都经过节流器控制频率和CPU占用
+    captureGovernor = new CaptureGovernor();
+    liveFrameSource = new GdiFrameSource([this]() { return hwndGame; });
+    liveFrameSource->setGovernor(captureGovernor);
+
+    // 初始化输入端：游戏窗口的点击和拖动经过令牌桶限流，画面没有变化时合并重复点击
+    gameInput = new Win32InputSink([this]() { return hwndGame; }, []() { return DPI; });
+    inputSink = new RateLimitedInputSink(gameInput);
+    inputSink->setChangeCounter([this]() { return captureGovernor->changeCount(); });
+    replayInput = new RecordingInputSink();
+
+    // 背包和配方列表各用一个闭环滚动控制器，拖动增益分别在线学习
+    auto dragScrollBar = [this](int x, int y, int distance, bool downward) { fastMouseDrag(x, y, distance, downward); };
+    backpackScroll = new ScrollController("背包", [this]() { return getPositionOfScrollBar(); }, dragScrollBar,
+                                          [this](int ms) { return sleepByQElapsedTimer(ms); });
+    ScrollController::Config recipeScrollConfig;
+    recipeScrollConfig.dragX = RecipeRecognizer::RECIPE_SCROLL_X;
+    recipeScrollConfig.dragOffsetY = RecipeRecognizer::RECIPE_SCROLL_START_Y;
+    recipeScroll = new ScrollController("配方", [this]() { return getPositionOfScrollBar(); }, dragScrollBar,
+                                        [this](int ms) { return sleepByQElapsedTimer(ms); }, recipeScrollConfig);
+    backpackScroll->setEndDetector([this]() {
+        return checkSynHousePosState(ENHANCE_SCROLL_BAR_BOTTOM, "enhanceScrollBottom");
+    });
+    recipeScroll->setEndDetector([this]() {
+        RegionFrame region = captureGameRegions({RECIPE_SCROLL_BAR_BOTTOM});
+        if (region.isNull()) {
+            return false;
+        }
+        const QString hash = calculateImageHash(region.image(0));
+        return hash == synHousePosTemplateHashes.value("recipeScrollBottom")
+            || hash == synHousePosTemplateHashes.value("recipeScrollBottomLight");
+    });
+
+    // 点击确认只截取预期变化的区域，区域变化或达到期望状态即返回
+    // 点击确认只在工作线程中使用，点击前后的帧序号在调用之间延续
+    auto clickVerifySequence = std::make_shared<quint64>(0);
+    clickVerifier = new ClickVerifier([this, clickVerifySequence](const QRect& region) {
+                                          RegionFrame frame = captureNewGameRegions({region}, *clickVerifySequence);
+                                          return frame.isNull() ? QImage() : frame.image(0).copy();
+                                      },
+                                      [this](const QPoint& position) { leftClickDPI(hwndGame, position.x(), position.y()); },
+                                      [this](int ms) { return sleepByQElapsedTimer(ms); });
+
+    // 合成屋页面导航图：从当前页面按期望耗时最短的路线点击，每一步以页面锚点确认到达
+    // 每次识别页面前先处理弹窗，切换途中弹出的已知弹窗随即关闭
+    pageRouter = new SceneRouter([this]() {
+                                     QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+                                     if (checkPopups(screenshot) == PopupCheckResult::Dismissed) {
+                                         screenshot = captureWindowByHandle(hwndGame, "主页面");
+                                     }
+                                     return currentPageName(screenshot);
+                                 },
+                                 [this](const QPoint& position) { leftClickDPI(hwndGame, position.x(), position.y()); },
+                                 [this](int ms) { return sleepByQElapsedTimer(ms); });
+    // 合成屋打开时停在上次离开的分页，从屋外出发的两条边点击同一位置，落点各自学习
+    pageRouter->addTransition("合成屋外", "卡片制作", SYNTHESIS_HOUSE_POS, 800);
+    pageRouter->addTransition("合成屋外", "卡片强化", SYNTHESIS_HOUSE_POS, 800);
+    pageRouter->addTransition("卡片制作", "卡片强化", CARD_ENHANCE_POS, 300);
+    pageRouter->addTransition("卡片强化", "卡片制作", CARD_PRODUCE_POS, 300);
+    pageRouter->addTransition("卡片制作", "合成屋外", SYNTHESIS_HOUSE_CLOSE_POS, 500);
+    pageRouter->addTransition("卡片强化", "合成屋外", SYNTHESIS_HOUSE_CLOSE_POS, 500);
+    frameSource = liveFrameSource;
+    // 强化期间由独立线程持续截图，识别时直接取最新帧
+    asyncCapture = new AsyncCaptureSource(liveFrameSource, 10);
     
     // 更新配方选择下拉框
     updateRecipeCombo();
     
-    // 初始化线程
+    // 初始化线程，会话令牌通过排队连接传给工作线程
+    qRegisterMetaType<std::shared_ptr<StopToken>>();
     enhancementThread = new QThread(this);
     enhancementWorker = new EnhancementWorker(this);
     enhancementWorker->moveToThread(enhancementThread);
@@ -175,6 +259,7 @@ StarryCard::StarryCard(QWidget *parent)
     connect(this, &StarryCard::startEnhancementSignal, enhancementWorker, &EnhancementWorker::startEnhancement, Qt::QueuedConnection);
     connect(enhancementWorker, &EnhancementWorker::logMessage, this, &StarryCard::addLog, Qt::QueuedConnection);
     connect(enhancementWorker, &EnhancementWorker::showWarningMessage, this, &StarryCard::showWarningMessage, Qt::QueuedConnection);
+    connect(enhancementWorker, &EnhancementWorker::sessionAnomaly, this, &StarryCard::dumpSessionRecording, Qt::QueuedConnection);
     connect(enhancementWorker, &EnhancementWorker::enhancementFinished, this, &StarryCard::onEnhancementFinished, Qt::QueuedConnection);
     
     // 启动线程
@@ -730,20 +815,88 @@ StarryCard::~StarryCard()
         enhancementThread->wait();
     }
     
-    // 清理全局像素数据
-    if (globalPixelData) {
-        delete[] globalPixelData;
-        globalPixelData = nullptr;
-        globalBitmapWidth = 0;
-        globalBitmapHeight = 0;
-    }
-
     // 清理RecipeRecognizer
     if (recipeRecognizer) {
         delete recipeRecognizer;
         recipeRecognizer = nullptr;
     }
 
+    // 清理PopupRegistry
+    if (popupRegistry) {
+        delete popupRegistry;
+        popupRegistry = nullptr;
+    }
+
+    // 清理FrameAnalyzer
+    if (frameAnalyzer) {
+        delete frameAnalyzer;
+        frameAnalyzer = nullptr;
+    }
+
+    // 清理调试帧归档
+    if (debugArchive) {
+        QMutexLocker locker(&debugArchiveMutex);
+        delete debugArchive;
+        debugArchive = nullptr;
+    }
+
+    // 停止识别进程
+    if (recognitionHost) {
+        delete recognitionHost;
+        recognitionHost = nullptr;
+    }
+
+    // 清理会话录制
+    if (sessionRecorder) {
+        delete sessionRecorder;
+        sessionRecorder = nullptr;
+    }
+
+    // 清理帧源
+    frameSource = nullptr;
+    if (asyncCapture) {
+        delete asyncCapture;
+        asyncCapture = nullptr;
+    }
+    if (liveFrameSource) {
+        delete liveFrameSource;
+        liveFrameSource = nullptr;
+    }
+    delete backpackScroll;
+    backpackScroll = nullptr;
+    delete recipeScroll;
+    recipeScroll = nullptr;
+    delete pageRouter;
+    pageRouter = nullptr;
+    delete clickVerifier;
+    clickVerifier = nullptr;
+    if (inputSink) {
+        delete inputSink;
+        inputSink = nullptr;
+    }
+    delete replayInput;
+    replayInput = nullptr;
+    if (gameInput) {
+        delete gameInput;
+        gameInput = nullptr;
+    }
+    if (captureGovernor) {
+        delete captureGovernor;
+        captureGovernor = nullptr;
+    }
+
+    // 清理SceneClassifier
+    if (sceneClassifier) {
+        delete sceneClassifier;
+        sceneClassifier = nullptr;
+    }
+
+    // 清理DigitRecognizer
+    if (digitRecognizer) {
+        delete digitRecognizer;
+        digitRecognizer = nullptr;
+    }
+
     // 清理CardRecognizer
     if (cardRecognizer) {
         delete cardRecognizer;
@@ -921,7 +1074,13 @@ void StarryCard::stopMouseTracking() {
 
 void StarryCard::startEnhancement()
 {
-    if (!isEnhancing && enhancementBtn) {
+    if (!isEnhancing() && enhancementBtn) {
+        // 上一个会话的工作线程可能还在退出，等它结束后才能重置它仍在使用的共享状态
+        if (!sessionStop->waitForFinished(1000)) {
+            addLog("上一次强化仍在退出，请稍后再开始", LogType::Warning);
+            return;
+        }
+
         // 检查线程状态，如果线程不可用则重新创建
         if (!enhancementThread || !enhancementThread->isRunning()) {
             addLog("重新创建强化线程", LogType::Info);
@@ -949,6 +1108,7 @@ void StarryCard::startEnhancement()
             connect(this, &StarryCard::startEnhancementSignal, enhancementWorker, &EnhancementWorker::startEnhancement, Qt::QueuedConnection);
             connect(enhancementWorker, &EnhancementWorker::logMessage, this, &StarryCard::addLog, Qt::QueuedConnection);
             connect(enhancementWorker, &EnhancementWorker::showWarningMessage, this, &StarryCard::showWarningMessage, Qt::QueuedConnection);
+            connect(enhancementWorker, &EnhancementWorker::sessionAnomaly, this, &StarryCard::dumpSessionRecording, Qt::QueuedConnection);
             connect(enhancementWorker, &EnhancementWorker::enhancementFinished, this, &StarryCard::onEnhancementFinished, Qt::QueuedConnection);
             
             // 启动线程
@@ -964,6 +1124,31 @@ void StarryCard::startEnhancement()
         // 在主线程中预先加载所需的卡片类型
         requiredCardTypes = getRequiredCardTypesFromConfig();
         
+        // 新的强化会话，配方位置和物品栏需要重新索引
+        invalidateRecipeIndex();
+        cloverStripIndex.invalidate();
+        cloverStripIndex.currentPage = -1;
+        spiceStripIndex.invalidate();
+        spiceStripIndex.currentPage = -1;
+        
+        // 第一次强化时才启动独立识别进程，卡片识别通过共享内存帧环交给它们，失败时回退到本进程识别
+        if (!recognitionHost) {
+            recognitionHost = new RecognitionHost(2);
+            if (!recognitionHost->start()) {
+                addLog("识别进程启动失败，卡片识别在主进程中进行", LogType::Warning);
+            }
+        }
+        
+        // 使用实时截图时启动异步截图线程，回放时保持回放帧源
+        if (frameSource == liveFrameSource) {
+            captureGovernor->reset();
+            inputSink->reset();
+            clickVerifier->resetStats();
+            pageRouter->resetStats();
+            asyncCapture->startCapture();
+            frameSource = asyncCapture;
+        }
+        
         // 在主线程中预先加载全局强化配置
         if (loadGlobalEnhancementConfig() && loadGlobalSpiceConfig()) {
             addLog("全局强化配置加载成功", LogType::Success);
@@ -971,8 +1156,12 @@ void StarryCard::startEnhancement()
             addLog("全局强化配置加载失败，使用默认配置", LogType::Warning);
         }
         
+        // 新会话使用新的停止令牌，随启动信号交给工作线程
+        sessionStop = std::make_shared<StopToken>();
+        sessionOpen = true;
+        
         enhancementBtn->setText("停止强化");
-        emit startEnhancementSignal();
+        emit startEnhancementSignal(sessionStop);
     } else {
         stopEnhancement();
     }
@@ -983,17 +1172,62 @@ void StarryCard::showWarningMessage(const QString& title, const QString& message
     QMessageBox::warning(this, title, message);
 }
 
+void StarryCard::archiveDebugFrame(const QImage& image, const QString& label)
+{
+    if (image.isNull()) {
+        return;
+    }
+    // 工作线程和界面线程都会归档调试帧
+    QMutexLocker locker(&debugArchiveMutex);
+    if (!debugArchive) {
+        QString archiveDir = QCoreApplication::applicationDirPath() + "/debug_archive";
+        QDir().mkpath(archiveDir);
+        debugArchive = new FrameArchiveWriter(archiveDir + "/frames.fvar");
+        if (!debugArchive->open()) {
+            qDebug() << "调试帧归档打开失败";
+        }
+    }
+    if (debugArchive->isOpen()) {
+        debugArchive->append(image, label);
+    }
+}
+
+void StarryCard::dumpSessionRecording(const QString& reason)
+{
+    QString sessionDir = QCoreApplication::applicationDirPath() + "/sessions";
+    QDir().mkpath(sessionDir);
+    QString path = QString("%1/%2_%3.fvmsession").arg(sessionDir)
+                   .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")).arg(reason);
+    sessionRecorder->dumpAsync(path, [this, sessionDir, path](bool ok) {
+        if (ok) {
+            SessionRecorder::pruneSessionFiles(sessionDir, MAX_SESSION_FILES);
+        }
+        // 在后台线程完成，日志回到界面线程输出
+        QMetaObject::invokeMethod(this, [this, path, ok]() {
+            if (ok) {
+                addLog(QString("会话录制已保存: %1").arg(path), LogType::Info);
+            } else {
+                addLog("会话录制保存失败", LogType::Warning);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
 void StarryCard::onEnhancementFinished()
 {
-    if (enhancementBtn) {
-        isEnhancing = false;
+    // 手动停止时已在stopEnhancement中收尾，工作线程随后发出的结束信号不再重复处理
+    if (enhancementBtn && sessionOpen) {
+        sessionOpen = false;
+        requestStop();
         enhancementBtn->setText("开始强化");
+        stopAsyncCapture();
         
         // 清空缓存的卡片类型
         requiredCardTypes.clear();
         
         // 保存制卡统计数据
         saveProductionStatistics();
+        saveEnhancementStatistics();
         
         addLog("强化流程结束", LogType::Info);
     }
@@ -1002,13 +1236,16 @@ void StarryCard::onEnhancementFinished()
 void StarryCard::stopEnhancement()
 {
     if (enhancementBtn) {
-        isEnhancing = false;
-        
-        // 强制终止线程 - 立即停止，不等待任何操作完成
-        if (enhancementThread && enhancementThread->isRunning()) {
-            addLog("强制终止强化线程...", LogType::Warning);
+        sessionOpen = false;
+        // 所有等待都在停止令牌上进行，请求停止后工作线程通常在当前一次截图或识别结束后立即退出
+        requestStop();
+        if (!sessionStop->waitForFinished(1000) && enhancementThread && enhancementThread->isRunning()) {
+            // 卡在无法中断的操作中时才强制终止线程
+            addLog("强化线程未能及时退出，强制终止...", LogType::Warning);
             enhancementThread->terminate();
             enhancementThread->wait(1000); // 等待最多1秒
+            // 被终止的线程不会再标记结束，由这里代为标记，否则下次开始强化会一直等待
+            sessionStop->markFinished();
             addLog("强化线程已终止", LogType::Warning);
             
             // 线程被terminate后需要重新启动才能再次使用
@@ -1017,12 +1254,14 @@ void StarryCard::stopEnhancement()
         }
         
         enhancementBtn->setText("开始强化");
+        stopAsyncCapture();
         
         // 清空缓存的卡片类型
         requiredCardTypes.clear();
         
         // 保存制卡统计数据
         saveProductionStatistics();
+        saveEnhancementStatistics();
         
         addLog("停止强化流程", LogType::Warning);
     }
@@ -1271,94 +1510,185 @@ int StarryCard::getDPIFromDC()
 
 QImage StarryCard::captureWindowByHandle(HWND hwnd, const QString& windowName)
 {
+    // 回放模式下游戏窗口的所有截图都来自录制的帧序列
+    FrameSource* source = frameSource.load();
+    if (source && source != liveFrameSource && hwnd == hwndGame) {
+        QImage frame = source->grab();
+        sessionRecorder->recordFrame(frame);
+        return frame;
+    }
+
     if (!hwnd || !IsWindow(hwnd)) {
         addLog(QString("无效的窗口句柄: %1").arg(windowName), LogType::Error);
         return QImage();
     }
 
+    // 主页面截图区域
+    if (windowName == "主页面" && hwnd == hwndGame) {
+        QImage frame = liveFrameSource->grab();
+        sessionRecorder->recordFrame(frame);
+        return frame;
+    }
+
     // 获取窗口位置和大小
+    QRect area(0, 0, 950, 596);
     RECT rect;
-    if(windowName == "主页面") // 主页面截图区域
-    {
-        rect.left = 0;
-        rect.top = 0;
-        rect.right = 950;
-        rect.bottom = 596;
+    if (windowName != "主页面") {
+        if (!GetWindowRect(hwnd, &rect)) {
+            qDebug() << QString("获取窗口位置失败: %1").arg(windowName);
+            return QImage();
+        }
+        area = QRect(0, 0, rect.right - rect.left, rect.bottom - rect.top);
     }
-    else if (!GetWindowRect(hwnd, &rect)) {
-        qDebug() << QString("获取窗口位置失败: %1").arg(windowName);
-        return QImage();
+
+    return GdiFrameSource::captureWindow(hwnd, area, windowName);
+}
+
+RegionFrame StarryCard::captureGameRegions(const QVector<QRect>& regions)
+{
+    // 实时截图时只BitBlt区域外接矩形，异步/回放时从最新帧中切片
+    return frameSource.load()->grabRegions(regions);
+}
+
+int StarryCard::newFrameTimeoutMs() const
+{
+    return asyncCapture->intervalMs() + captureGovernor->intervalMs() + NEW_FRAME_MARGIN_MS;
+}
+
+QImage StarryCard::captureNewGameFrame(quint64& lastSequence)
+{
+    // 同步截图每次都是新画面
+    if (frameSource != asyncCapture) {
+        return captureWindowByHandle(hwndGame, "主页面");
     }
-    
-    // 获取窗口DC
-    HDC hdcWindow = GetDC(hwnd);
-    if (!hdcWindow) {
-        qDebug() << QString("获取窗口DC失败: %1").arg(windowName);
+    if (!asyncCapture->waitForFrameAfter(lastSequence, newFrameTimeoutMs())) {
         return QImage();
     }
+    QImage frame = captureWindowByHandle(hwndGame, "主页面");
+    // 取返回后已发布的最新序号，下一次一定拿到这之后的帧
+    lastSequence = asyncCapture->latestSequence();
+    return frame;
+}
 
-    // 创建兼容DC和位图
-    HDC hdcMemDC = CreateCompatibleDC(hdcWindow);
-    if (!hdcMemDC) {
-        qDebug() << QString("创建兼容DC失败: %1").arg(windowName);
-        ReleaseDC(hwnd, hdcWindow);
-        return QImage();
+RegionFrame StarryCard::captureNewGameRegions(const QVector<QRect>& regions, quint64& lastSequence)
+{
+    if (frameSource != asyncCapture) {
+        return captureGameRegions(regions);
+    }
+    if (!asyncCapture->waitForFrameAfter(lastSequence, newFrameTimeoutMs())) {
+        return RegionFrame();
     }
+    RegionFrame frame = captureGameRegions(regions);
+    lastSequence = asyncCapture->latestSequence();
+    return frame;
+}
 
-    int width = rect.right - rect.left;
-    int height = rect.bottom - rect.top;
-    
-    HBITMAP hBitmap = CreateCompatibleBitmap(hdcWindow, width, height);
-    if (!hBitmap) {
-        qDebug() << QString("创建兼容位图失败: %1").arg(windowName);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hwnd, hdcWindow);
-        return QImage();
+QVector<CardInfo> StarryCard::recognizeBackpackCards(const QImage& frame, const QStringList& cardTypes)
+{
+    return backpackCardRecognition(cardTypes)(frame);
+}
+
+std::function<QVector<CardInfo>(const QImage&)> StarryCard::backpackCardRecognition(const QStringList& cardTypes)
+{
+    RecognitionHost* host = recognitionHost;
+    CardRecognizer* recognizer = cardRecognizer;
+    // 识别进程最多等一帧的时间，超过时新画面已经到了，不如在本进程内直接识别
+    const int budgetMs = newFrameTimeoutMs();
+    return [host, recognizer, cardTypes, budgetMs](const QImage& frame) {
+        QVector<CardInfo> cards;
+        if (host && host->isAvailable() && host->recognizeCards(frame, cardTypes, cards, budgetMs)) {
+            return cards;
+        }
+        return recognizer->recognizeCards(frame, cardTypes);
+    };
+}
+
+void StarryCard::stopAsyncCapture()
+{
+    if (frameSource == asyncCapture) {
+        frameSource = liveFrameSource;
     }
+    asyncCapture->stopCapture();
 
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMemDC, hBitmap);
+    CaptureGovernor::Usage usage = captureGovernor->usage();
+    CaptureBudget budget = captureGovernor->budget();
+    addLog(QString("截图预算：%1次/秒（上限%2），CPU %3ms/秒（上限%4），共截图%5次，节流等待%6ms")
+           .arg(usage.capturesPerSecond, 0, 'f', 1).arg(budget.maxCapturesPerSecond, 0, 'f', 0)
+           .arg(usage.cpuMsPerSecond, 0, 'f', 1).arg(budget.maxCpuMsPerSecond, 0, 'f', 0)
+           .arg(usage.captures).arg(usage.throttledMs), LogType::Info);
 
-    // 复制窗口内容到位图
-    if (!BitBlt(hdcMemDC, 0, 0, width, height, hdcWindow, 0, 0, SRCCOPY)) {
-        qDebug() << QString("复制窗口内容失败: %1").arg(windowName);
-        SelectObject(hdcMemDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hwnd, hdcWindow);
-        return QImage();
+    RateLimitedInputSink::Stats inputStats = inputSink->stats();
+    addLog(QString("输入统计：发送%1次，合并冗余点击%2次，限流等待%3ms")
+           .arg(inputStats.sent).arg(inputStats.coalesced).arg(inputStats.throttledMs), LogType::Info);
+    if (isReplaying()) {
+        addLog(QString("回放期间记录输入%1次，未发送到游戏窗口").arg(replayInput->events().size()), LogType::Info);
     }
 
-    // 转换为QImage
-    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
-    
-    // 设置BITMAPINFO结构
-    BITMAPINFO bmi;
-    ZeroMemory(&bmi, sizeof(BITMAPINFO));
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = -height; // 负值表示自上而下的位图
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-
-    // 获取位图数据
-    if (!GetDIBits(hdcMemDC, hBitmap, 0, height, image.bits(), &bmi, DIB_RGB_COLORS)) {
-        qDebug() << QString("获取位图数据失败: %1").arg(windowName);
-        SelectObject(hdcMemDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hwnd, hdcWindow);
-        return QImage();
+    ClickVerifier::Stats clickStats = clickVerifier->stats();
+    if (clickStats.clicks > 0) {
+        addLog(QString("点击确认：%1次，平均反应%2ms（最长%3ms），未生效%4次，未达到期望状态%5次")
+               .arg(clickStats.clicks).arg(clickStats.averageLatencyMs(), 0, 'f', 1).arg(clickStats.maxLatencyMs)
+               .arg(clickStats.unresponsive).arg(clickStats.mismatched), LogType::Info);
+    }
+
+    SceneRouter::Stats routeStats = pageRouter->stats();
+    if (routeStats.hops > 0) {
+        addLog(QString("页面切换：共%1步，到达预期页面%2步，落点不同%3步，超时%4步")
+               .arg(routeStats.hops).arg(routeStats.arrivedHops).arg(routeStats.redirects)
+               .arg(routeStats.failedHops), LogType::Info);
+    }
+
+    // 稳态轮询时新分配次数应保持不变，只有复用次数增长
+    FrameBufferPool::Stats poolStats = FrameBufferPool::shared().stats();
+    qDebug() << QString("截图缓冲池统计：新分配%1次，复用%2次，空闲%3块，使用中%4块")
+                .arg(poolStats.allocations).arg(poolStats.reuses).arg(poolStats.idle).arg(poolStats.inUse);
+}
+
+void StarryCard::setFrameSource(FrameSource* source)
+{
+    // 传入nullptr时恢复实时截图，帧源的所有权由调用方保留
+    frameSource = source ? source : liveFrameSource;
+    // 回放时不再录制回放出来的画面
+    sessionRecorder->setEnabled(frameSource == liveFrameSource);
+}
+
+bool StarryCard::startReplay(const QString& path)
+{
+    // 回放帧源替换后旧帧源随即释放，会话进行中工作线程可能正在读取，只在没有会话时切换
+    if (isEnhancing()) {
+        addLog("强化进行中，不能切换到回放", LogType::Warning);
+        return false;
+    }
+    std::unique_ptr<FrameSource> source = openRecordedFrames(path);
+    if (!source) {
+        addLog(QString("回放文件打开失败: %1").arg(path), LogType::Error);
+        return false;
     }
+    setFrameSource(source.get());
+    replaySource = std::move(source);
+    replayInput->clear();
+    addLog(QString("回放模式：识别画面来自%1，点击和拖动不会发送到游戏窗口").arg(path), LogType::Info);
+    return true;
+}
+
+bool StarryCard::isReplaying() const
+{
+    // 异步截图只在实时截图时启用，其余帧源都是回放
+    FrameSource* source = frameSource.load();
+    return source && source != liveFrameSource && source != asyncCapture;
+}
 
-    // 清理资源
-    SelectObject(hdcMemDC, hOldBitmap);
-    DeleteObject(hBitmap);
-    DeleteDC(hdcMemDC);
-    ReleaseDC(hwnd, hdcWindow);
+bool StarryCard::hasGameWindow() const
+{
+    return isReplaying() || (hwndGame && IsWindow(hwndGame));
+}
 
-    // qDebug() << QString("成功截取%1窗口图像：%2x%3").arg(windowName).arg(width).arg(height);
-    return image;
+InputSink* StarryCard::gameInputSink()
+{
+    if (isReplaying()) {
+        return replayInput;
+    }
+    return inputSink;
 }
 
 QImage StarryCard::captureImageRegion(const QImage& sourceImage, const QRect& rect, const QString& filename)
@@ -1592,7 +1922,7 @@ void StarryCard::onCaptureAndRecognize()
                 qDebug() << QString("=== 开始测试配方: %1 ===").arg(targetRecipe);
                 
                 // 执行带翻页功能的配方识别
-                if (!hwndGame || !IsWindow(hwndGame)) {
+                if (!hasGameWindow()) {
                     qDebug() << "游戏窗口句柄无效，无法进行配方识别";
                     return;
                 }
@@ -3517,13 +3847,39 @@ QPair<bool, bool> StarryCard::recognizeClover(const QString& cloverType, bool cl
         return qMakePair(false, false);
     }
     
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法进行四叶草识别", LogType::Error);
         return qMakePair(false, false);
     }
     
     qDebug() << QString("开始识别四叶草: %1").arg(cloverType);
-    
+
+    // 优先使用物品栏索引直接翻到所在页；索引中没有或与画面不符时重建一次，仍未找到再逐页查找
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        StripSlotEntry entry;
+        if (!locateStripItem(cloverStripIndex, cloverSlotClassifier(), cloverType, clover_bound, clover_unbound, entry)) {
+            if (cloverStripIndex.isBuilt() && attempt == 0) {
+                // 建立索引后物品可能有增减，或个别格子识别失败，不能据此判定已用完
+                cloverStripIndex.invalidate();
+                continue;
+            }
+            break;
+        }
+
+        QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+        QPoint center = cloverStripIndex.slotCenter(entry.slot);
+        if (recognizeSingleClover(cloverStripIndex.slotImage(screenshot, entry.slot), cloverType,
+                                  center.x(), center.y(), clover_bound, clover_unbound)) {
+            return qMakePair(true, entry.bound);
+        }
+        qDebug() << "四叶草物品栏索引与画面不符，重新建立索引";
+        cloverStripIndex.invalidate();
+    }
+
+    // 索引不可用时逐页查找，之后物品栏当前页未知
+    cloverStripIndex.invalidate();
+    cloverStripIndex.currentPage = -1;
+
     // 添加重试机制：如果30次翻页都没找到，重试最多3次
     const int maxRetries = 3;
     for (int retryCount = 0; retryCount < maxRetries; ++retryCount) {
@@ -3542,8 +3898,8 @@ QPair<bool, bool> StarryCard::recognizeClover(const QString& cloverType, bool cl
             break;
         }
 
-        leftClickDPI(hwndGame, 532, 539);
-        sleepByQElapsedTimer(150);
+        leftClickIdempotent(532, 539);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 150));
         
         if (attempt == maxPageUpAttempts - 1) {
             qDebug() << "翻页到顶部失败";
@@ -3566,7 +3922,7 @@ QPair<bool, bool> StarryCard::recognizeClover(const QString& cloverType, bool cl
         
         // 点击下翻按钮
         leftClickDPI(hwndGame, 535, 563);
-        sleepByQElapsedTimer(200);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 200));
         
         // 使用动态识别识别当前页面
         result = dynamicRecognizeClover(cloverType, clover_bound, clover_unbound);
@@ -3630,6 +3986,12 @@ void StarryCard::loadPositionTemplates()
 {
     positionTemplateHashes.clear();
     
+    // 页面锚点按区分度排列，强化流程中最常停留在强化页面，优先比较；其余模板（排行）作为子状态
+    delete sceneClassifier;
+    sceneClassifier = new SceneClassifier([this](const QImage& image, const QRect& roi) {
+        return calculateImageHash(image, roi);
+    }, {"卡片强化", "卡片制作", "合成屋外"});
+    
     // 使用Qt资源系统加载位置模板
     // 基于resources_position.qrc中的文件列表
     QStringList positionFiles = {
@@ -3674,6 +4036,7 @@ void StarryCard::loadPositionTemplates()
             // 计算哈希值
             QString hash = calculateImageHash(img); // 不传入区域，计算整个20*20像素的图片的哈希值
             positionTemplateHashes[key] = hash;
+            sceneClassifier->addAnchor(key, hash);
             qDebug() << "键:" << key << "哈希值:" << hash;
         }
         else
@@ -3715,88 +4078,51 @@ void StarryCard::loadSynHousePosTemplates()
         QString hash = calculateImageHash(img);
         synHousePosTemplateHashes[key] = hash;
     }
+
+    // 配方槽为空时的图案，制卡后仍是空槽说明背包已满没有制出卡片
+    // 制卡前配方槽也可能为空，它不是弹窗，只在制卡后作为背包已满的判据
+    QImage recipeSlotEmpty(":/images/position/(270,356)配方槽.png");
+    if (!recipeSlotEmpty.isNull()) {
+        synHousePosTemplateHashes["recipeSlotEmpty"] = calculateImageHash(recipeSlotEmpty);
+    }
     qDebug() << "合成屋模板加载完成，总数:" << synHousePosTemplateHashes.size();
 }
 
 QString StarryCard::recognizeCurrentPosition(QImage screenshot)
 {
-    // 循环遍历所有的位置模板
-    for (auto it = positionTemplateHashes.begin(); it != positionTemplateHashes.end(); ++it) {
-        QString key = it.key();
-        QString templateHash = it.value();
-        
-        // 解析键中的坐标信息 - 格式: "(x,y)描述"
-        static const QRegularExpression regex("\\((\\d+),(\\d+)\\)(.*)");
-        QRegularExpressionMatch match = regex.match(key);
-        
-        if (match.hasMatch()) {
-            int x = match.captured(1).toInt();
-            int y = match.captured(2).toInt();
-            QString description = match.captured(3);
+    SceneInfo info = classifyScene(screenshot);
+    if (info.isKnown()) {
+        qDebug() << "找到匹配的位置模板:" << info.scene;
+        return info.scene; // 返回位置信息
+    }
 
-            if(description == "排行")
-            {
-                continue; // 跳过排行位置
-            }
-            
-            // 从截图中截取对应的区域 (20x20像素)
-            QRect region(x, y, 20, 20);
-            
-            // 检查区域是否在截图范围内
-            if (!screenshot.rect().contains(region)) {
-                qDebug() << "区域超出游戏窗口范围，跳过:" << key;
-                continue;
-            }
-            
-            // 截取指定区域
-            QImage regionImage = screenshot.copy(region);
-            if (regionImage.isNull()) {
-                qDebug() << "截取区域失败:" << key;
-                continue;
-            }
-            
-            // 计算该区域的哈希值
-            QString currentHash = calculateImageHash(regionImage);
-            
-            // 与模板哈希值进行比较
-            if (currentHash == templateHash) {
-                qDebug() << "找到匹配的位置模板:" << key;
-                qDebug() << "返回描述:" << description;
-                return key; // 返回位置信息
-            }
-            else
-            {
 #ifdef DEBUG_BUILD
-                QString appDir = QCoreApplication::applicationDirPath();
-                QString screenshotsDir = appDir + "/screenshots";
-                QDir dir(screenshotsDir);
-                if(!dir.exists())
-                {
-                    dir.mkpath(screenshotsDir);
-                }
-                QString debugDir = screenshotsDir + "/debug_position";
-                QDir().mkpath(debugDir);
-                if(regionImage.save(QString("%1/%2.png").arg(debugDir).arg(key)))
-                {
-                    qDebug() << "截图已保存:" << QString("%1/%2.png").arg(debugDir).arg(key);
-                }
-                else
-                {
-                    qDebug() << "截图保存失败:" << QString("%1/%2.png").arg(debugDir).arg(key);
-                }
+    archiveDebugFrame(screenshot, "position/unknown");
 #endif
-                qDebug() << "未找到匹配的位置模板:" << key;
-            }
-        } else {
-            qDebug() << "无法解析位置模板键:" << key;
-        }
-    }
-    
+
     // 没有找到匹配的位置
     qDebug() << "未找到匹配的位置模板";
     return QString();
 }
 
+SceneInfo StarryCard::classifyScene(const QImage& screenshot)
+{
+    if (!sceneClassifier) {
+        return SceneInfo();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    SceneInfo info = sceneClassifier->classify(screenshot);
+    sessionRecorder->recordRecognition("场景", info.isKnown() ? info.scene : "未知", timer.elapsed());
+    return info;
+}
+
+bool StarryCard::matchPosTemplate(const QImage& frame, const QRect& pos, const QString& templateName)
+{
+    const QImage& region = FrameAnalyzer::threadScratch().crop(frame, pos);
+    return !region.isNull() && calculateImageHash(region) == synHousePosTemplateHashes.value(templateName);
+}
+
 BOOL StarryCard::checkSynHousePosState(QImage screenshot, const QRect& pos, const QString& templateName)
 {
     QImage synHouseImage = screenshot.copy(pos);
@@ -3804,7 +4130,20 @@ BOOL StarryCard::checkSynHousePosState(QImage screenshot, const QRect& pos, cons
     // QString screenshotsDir = appDir + "/screenshots";
     // synHouseImage.save(QString("%1/%2.png").arg(screenshotsDir).arg(templateName));
     QString hash = calculateImageHash(synHouseImage);
-    return hash == synHousePosTemplateHashes[templateName];
+    bool matched = (hash == synHousePosTemplateHashes.value(templateName));
+    sessionRecorder->recordRecognition(templateName, matched ? "1" : "0", 0);
+    return matched;
+}
+
+BOOL StarryCard::checkSynHousePosState(const QRect& pos, const QString& templateName)
+{
+    RegionFrame region = captureGameRegions({pos});
+    if (region.isNull()) {
+        return FALSE;
+    }
+    bool matched = (calculateImageHash(region.image(0)) == synHousePosTemplateHashes.value(templateName));
+    sessionRecorder->recordRecognition(templateName, matched ? "1" : "0", 0);
+    return matched;
 }
 
 BOOL StarryCard::checkSpicePosState(QImage screenshot, const QRect& pos, const QString& templateName)
@@ -3816,7 +4155,7 @@ BOOL StarryCard::checkSpicePosState(QImage screenshot, const QRect& pos, const Q
 // 检查强化前的卡片选择状态
 bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMainCard, const QVector<CardInfo>& expectedSubcards)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法检查卡片状态", LogType::Error);
         return false;
     }
@@ -3830,121 +4169,60 @@ bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMai
     
     qDebug() << "开始检查强化前的卡片选择状态";
     
-    // 检查主卡
-    QImage mainCardType = screenshot.copy(271, 342, 32, 16);
-    QImage mainCardLevel = screenshot.copy(272, 328, 6, 8);
-    QImage mainCardBind = screenshot.copy(268, 365, 6, 7);
+    // 主卡和三个副卡各自的类型、星级、绑定区域，副卡1在主卡上方，副卡2/3在主卡左右
+    const QVector<QPoint> slotOffsets = {QPoint(0, 0), QPoint(0, -71), QPoint(-56, 0), QPoint(56, 0)};
+    const QRect typeRect(271, 342, 32, 16);
+    const QRect levelRect(272, 328, 6, 8);
+    const QRect bindRect(268, 365, 6, 7);
     
-    // 检查副卡1
-    QImage subCard1Type = screenshot.copy(271, 271, 32, 16);
-    QImage subCard1Level = screenshot.copy(272, 257, 6, 8);
-    QImage subCard1Bind = screenshot.copy(268, 294, 6, 7);
-    
-    // 检查副卡2
-    QImage subCard2Type = screenshot.copy(215, 342, 32, 16);
-    QImage subCard2Level = screenshot.copy(216, 328, 6, 8);
-    QImage subCard2Bind = screenshot.copy(212, 365, 6, 7);
-    
-    // 检查副卡3
-    QImage subCard3Type = screenshot.copy(327, 342, 32, 16);
-    QImage subCard3Level = screenshot.copy(328, 328, 6, 8);
-    QImage subCard3Bind = screenshot.copy(324, 365, 6, 7);
-    
-    // 输出ROI区域图像用于调试（仅DEBUG和RELWITHDEBINFO模式）
+    // 输出ROI区域图像用于调试（仅DEBUG和RELWITHDEBINFO模式），写入帧归档，相同画面只保存一次
 #if defined(DEBUG_BUILD) || defined(QT_DEBUG)
-    QString appDir = QCoreApplication::applicationDirPath();
-    QString debugDir = appDir + "/debug_card_selection";
-    QDir().mkpath(debugDir);
-    
-    // 保存主卡ROI区域（覆盖文件）
-    if (!mainCardType.isNull()) {
-        QString mainCardTypePath = debugDir + "/main_card_type.png";
-        mainCardType.save(mainCardTypePath);
-        qDebug() << "主卡类型ROI已保存:" << mainCardTypePath;
-    }
-    if (!mainCardLevel.isNull()) {
-        QString mainCardLevelPath = debugDir + "/main_card_level.png";
-        mainCardLevel.save(mainCardLevelPath);
-        qDebug() << "主卡等级ROI已保存:" << mainCardLevelPath;
-    }
-    if (!mainCardBind.isNull()) {
-        QString mainCardBindPath = debugDir + "/main_card_bind.png";
-        mainCardBind.save(mainCardBindPath);
-        qDebug() << "主卡绑定ROI已保存:" << mainCardBindPath;
-    }
-    
-    // 保存副卡1 ROI区域（覆盖文件）
-    if (!subCard1Type.isNull()) {
-        QString subCard1TypePath = debugDir + "/sub_card1_type.png";
-        subCard1Type.save(subCard1TypePath);
-        qDebug() << "副卡1类型ROI已保存:" << subCard1TypePath;
-    }
-    if (!subCard1Level.isNull()) {
-        QString subCard1LevelPath = debugDir + "/sub_card1_level.png";
-        subCard1Level.save(subCard1LevelPath);
-        qDebug() << "副卡1等级ROI已保存:" << subCard1LevelPath;
-    }
-    if (!subCard1Bind.isNull()) {
-        QString subCard1BindPath = debugDir + "/sub_card1_bind.png";
-        subCard1Bind.save(subCard1BindPath);
-        qDebug() << "副卡1绑定ROI已保存:" << subCard1BindPath;
-    }
-    
-    // 保存副卡2 ROI区域（覆盖文件）
-    if (!subCard2Type.isNull()) {
-        QString subCard2TypePath = debugDir + "/sub_card2_type.png";
-        subCard2Type.save(subCard2TypePath);
-        qDebug() << "副卡2类型ROI已保存:" << subCard2TypePath;
-    }
-    if (!subCard2Level.isNull()) {
-        QString subCard2LevelPath = debugDir + "/sub_card2_level.png";
-        subCard2Level.save(subCard2LevelPath);
-        qDebug() << "副卡2等级ROI已保存:" << subCard2LevelPath;
-    }
-    if (!subCard2Bind.isNull()) {
-        QString subCard2BindPath = debugDir + "/sub_card2_bind.png";
-        subCard2Bind.save(subCard2BindPath);
-        qDebug() << "副卡2绑定ROI已保存:" << subCard2BindPath;
-    }
-    
-    // 保存副卡3 ROI区域（覆盖文件）
-    if (!subCard3Type.isNull()) {
-        QString subCard3TypePath = debugDir + "/sub_card3_type.png";
-        subCard3Type.save(subCard3TypePath);
-        qDebug() << "副卡3类型ROI已保存:" << subCard3TypePath;
-    }
-    if (!subCard3Level.isNull()) {
-        QString subCard3LevelPath = debugDir + "/sub_card3_level.png";
-        subCard3Level.save(subCard3LevelPath);
-        qDebug() << "副卡3等级ROI已保存:" << subCard3LevelPath;
-    }
-    if (!subCard3Bind.isNull()) {
-        QString subCard3BindPath = debugDir + "/sub_card3_bind.png";
-        subCard3Bind.save(subCard3BindPath);
-        qDebug() << "副卡3绑定ROI已保存:" << subCard3BindPath;
+    const QStringList slotNames = {"main_card", "sub_card1", "sub_card2", "sub_card3"};
+    for (int i = 0; i < slotOffsets.size(); ++i) {
+        archiveDebugFrame(screenshot.copy(typeRect.translated(slotOffsets[i])), "card_selection/" + slotNames[i] + "_type");
+        archiveDebugFrame(screenshot.copy(levelRect.translated(slotOffsets[i])), "card_selection/" + slotNames[i] + "_level");
+        archiveDebugFrame(screenshot.copy(bindRect.translated(slotOffsets[i])), "card_selection/" + slotNames[i] + "_bind");
     }
 #endif
     
-    // 计算哈希值
-    QString mainCardTypeHash = calculateImageHash(mainCardType);
-    QString mainCardLevelHash = calculateImageHash(mainCardLevel);
-    QString mainCardBindHash = calculateImageHash(mainCardBind);
+    // 计算哈希值：四个卡槽各一个任务在同一帧上并行计算，区域超出画面时哈希为空
+    QVector<FrameJob> slotJobs;
+    for (const QPoint& offset : slotOffsets) {
+        slotJobs.append([this, offset, typeRect, levelRect, bindRect](const QImage& frame) -> QVariant {
+            FrameScratch& scratch = FrameAnalyzer::threadScratch();
+            QStringList hashes;
+            for (const QRect& rect : {typeRect, levelRect, bindRect}) {
+                const QImage& region = scratch.crop(frame, rect.translated(offset));
+                hashes.append(region.isNull() ? QString() : calculateImageHash(region));
+            }
+            return hashes;
+        });
+    }
+    const QVector<QVariant> slotHashes = frameAnalyzer->run(screenshot, slotJobs);
+    
+    const QStringList mainCardHashes = slotHashes[0].toStringList();
+    QString mainCardTypeHash = mainCardHashes[0];
+    QString mainCardLevelHash = mainCardHashes[1];
+    QString mainCardBindHash = mainCardHashes[2];
     
-    QString subCard1TypeHash = calculateImageHash(subCard1Type);
-    QString subCard1LevelHash = calculateImageHash(subCard1Level);
-    QString subCard1BindHash = calculateImageHash(subCard1Bind);
+    const QStringList subCard1Hashes = slotHashes[1].toStringList();
+    QString subCard1TypeHash = subCard1Hashes[0];
+    QString subCard1LevelHash = subCard1Hashes[1];
+    QString subCard1BindHash = subCard1Hashes[2];
     
-    QString subCard2TypeHash = calculateImageHash(subCard2Type);
-    QString subCard2LevelHash = calculateImageHash(subCard2Level);
-    QString subCard2BindHash = calculateImageHash(subCard2Bind);
+    const QStringList subCard2Hashes = slotHashes[2].toStringList();
+    QString subCard2TypeHash = subCard2Hashes[0];
+    QString subCard2LevelHash = subCard2Hashes[1];
+    QString subCard2BindHash = subCard2Hashes[2];
     
-    QString subCard3TypeHash = calculateImageHash(subCard3Type);
-    QString subCard3LevelHash = calculateImageHash(subCard3Level);
-    QString subCard3BindHash = calculateImageHash(subCard3Bind);
+    const QStringList subCard3Hashes = slotHashes[3].toStringList();
+    QString subCard3TypeHash = subCard3Hashes[0];
+    QString subCard3LevelHash = subCard3Hashes[1];
+    QString subCard3BindHash = subCard3Hashes[2];
     
     // 检查主卡是否正确选择
     bool mainCardCorrect = false;
-    if (!mainCardType.isNull() && !mainCardLevel.isNull() && !mainCardBind.isNull()) {
+    if (!mainCardTypeHash.isEmpty() && !mainCardLevelHash.isEmpty() && !mainCardBindHash.isEmpty()) {
         // 输出哈希比较信息到qDebug
         qDebug() << "=== 主卡哈希比较 ===";
         qDebug() << "期望主卡:" << expectedMainCard.name << "(" << expectedMainCard.level << "星," 
@@ -3992,7 +4270,7 @@ bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMai
     bool subCard1Correct = false;
     if (expectedSubcards.size() >= 1) {
         const CardInfo& expectedSubCard1 = expectedSubcards[0];
-        if (!subCard1Type.isNull() && !subCard1Level.isNull() && !subCard1Bind.isNull()) {
+        if (!subCard1TypeHash.isEmpty() && !subCard1LevelHash.isEmpty() && !subCard1BindHash.isEmpty()) {
             // 输出哈希比较信息到qDebug
             qDebug() << "=== 副卡1哈希比较 ===";
             qDebug() << "期望副卡1:" << expectedSubCard1.name << "(" << expectedSubCard1.level << "星," 
@@ -4063,7 +4341,7 @@ bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMai
     bool subCard2Correct = false;
     if (expectedSubcards.size() >= 2) {
         const CardInfo& expectedSubCard2 = expectedSubcards[1];
-        if (!subCard2Type.isNull() && !subCard2Level.isNull() && !subCard2Bind.isNull()) {
+        if (!subCard2TypeHash.isEmpty() && !subCard2LevelHash.isEmpty() && !subCard2BindHash.isEmpty()) {
             // 输出哈希比较信息到qDebug
             qDebug() << "=== 副卡2哈希比较 ===";
             qDebug() << "期望副卡2:" << expectedSubCard2.name << "(" << expectedSubCard2.level << "星," 
@@ -4134,7 +4412,7 @@ bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMai
     bool subCard3Correct = false;
     if (expectedSubcards.size() >= 3) {
         const CardInfo& expectedSubCard3 = expectedSubcards[2];
-        if (!subCard3Type.isNull() && !subCard3Level.isNull() && !subCard3Bind.isNull()) {
+        if (!subCard3TypeHash.isEmpty() && !subCard3LevelHash.isEmpty() && !subCard3BindHash.isEmpty()) {
             // 输出哈希比较信息到qDebug
             qDebug() << "=== 副卡3哈希比较 ===";
             qDebug() << "期望副卡3:" << expectedSubCard3.name << "(" << expectedSubCard3.level << "星," 
@@ -4216,7 +4494,7 @@ bool StarryCard::checkCardSelectionBeforeEnhancement(const CardInfo& expectedMai
 // 检查合成屋中的配方是否正确
 bool StarryCard::checkRecipeSelectionBeforeProduction(const QString& expectedRecipe)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法检查配方状态", LogType::Error);
         return false;
     }
@@ -4226,19 +4504,13 @@ bool StarryCard::checkRecipeSelectionBeforeProduction(const QString& expectedRec
         return false;
     }
     
-    // 截取游戏窗口
-    QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
-    if (screenshot.isNull()) {
-        addLog("截图失败，无法检查配方状态", LogType::Error);
-        return false;
-    }
-    
-    // 截取合成屋配方位置的ROI区域
-    QImage recipeSlotImage = screenshot.copy(RECIPE_SLOT_POS);
-    if (recipeSlotImage.isNull()) {
+    // 只截取合成屋配方位置的ROI区域
+    RegionFrame slotFrame = captureGameRegions({RECIPE_SLOT_POS});
+    if (slotFrame.isNull()) {
         addLog("配方槽图像截取失败", LogType::Error);
         return false;
     }
+    QImage recipeSlotImage = slotFrame.image(0);
     
     // 输出配方ROI区域图像用于调试（仅DEBUG和RELWITHDEBINFO模式）
 #if defined(DEBUG_BUILD) || defined(QT_DEBUG)
@@ -4285,10 +4557,65 @@ bool StarryCard::checkRecipeSelectionBeforeProduction(const QString& expectedRec
     return isMatch;
 }
 
+QString StarryCard::mainCardStarHash(const QImage& screenshot)
+{
+    if (screenshot.isNull()) {
+        return QString();
+    }
+    return calculateImageHash(screenshot.copy(MAIN_CARD_STAR_ROI));
+}
+
+int StarryCard::recognizeMainCardLevel(const QImage& screenshot, const QString& emptyStarHash)
+{
+    if (screenshot.isNull()) {
+        return -1;
+    }
+
+    QString levelHash = mainCardStarHash(screenshot);
+    for (int level = 1; level <= 16; ++level) {
+        if (levelHash == cardRecognizer->getCardLevelHash(level)) {
+            return level;
+        }
+    }
+
+    // 0星卡片没有星级图标，该区域是卡面本身，只能与强化前同一张卡的区域比较
+    // 动画残留、遮挡等情况下不匹配任何模板，不能当作0星，否则会被记为强化失败
+    if (!emptyStarHash.isEmpty() && levelHash == emptyStarHash) {
+        return 0;
+    }
+    return -1;
+}
+
+EnhanceOutcome StarryCard::recognizeEnhancementOutcome(int fromLevel, const QString& emptyStarHash)
+{
+    // 等待主卡位置的强化动画结束
+    waitForScreenSettle(QRect(265, 325, 45, 50), SettleOptions(1500, 3));
+
+    QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+    if (screenshot.isNull() || checkSynHousePosState(screenshot, MAIN_CARD_POS, "mainCardEmpty")) {
+        qDebug() << "强化结果识别失败：主卡位置无卡片";
+        return EnhanceOutcome::Unknown;
+    }
+    int resultLevel = recognizeMainCardLevel(screenshot, emptyStarHash);
+    if (resultLevel < 0) {
+        qDebug() << "强化结果识别失败：主卡星级不匹配任何模板";
+        return EnhanceOutcome::Unknown;
+    }
+
+    qDebug() << QString("强化结果：%1星 -> %2星").arg(fromLevel).arg(resultLevel);
+    if (resultLevel == fromLevel + 1) {
+        return EnhanceOutcome::Success;
+    }
+    if (resultLevel <= fromLevel) {
+        return EnhanceOutcome::Failure;
+    }
+    return EnhanceOutcome::Unknown;
+}
+
 // 取消所有卡片选择
 void StarryCard::cancelAllCardSelections()
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         qDebug() << "游戏窗口无效，无法取消卡片选择";
         return;
     }
@@ -4316,20 +4643,13 @@ void StarryCard::cancelAllCardSelections()
 
 bool StarryCard::isPageAtTop()
 {
-    if (!pageTemplatesLoaded || !hwndGame || !IsWindow(hwndGame)) {
-        return false;
-    }
-    
-    // 截取游戏窗口
-    QImage screenshot = captureWindowByHandle(hwndGame,"主页面");
-    if (screenshot.isNull()) {
-        qDebug() << "截图失败，无法检测翻页状态";
+    if (!pageTemplatesLoaded || !hasGameWindow()) {
         return false;
     }
     
-    // 从坐标(532,539)开始，截取5x5的图像
+    // 从坐标(532,539)开始，只截取5x5的图像
     QRect captureRect(532, 539, 5, 5);
-    QImage pageCheckImage = screenshot.copy(captureRect);
+    QImage pageCheckImage = captureGameRegions({captureRect}).image(0);
     
     if (pageCheckImage.isNull()) {
         qDebug() << "翻页检测区域截取失败";
@@ -4365,20 +4685,13 @@ bool StarryCard::isPageAtTop()
 
 bool StarryCard::isPageAtBottom()
 {
-    if (!pageTemplatesLoaded || !hwndGame || !IsWindow(hwndGame)) {
-        return false;
-    }
-    
-    // 截取游戏窗口
-    QImage screenshot = captureWindowByHandle(hwndGame,"主页面");
-    if (screenshot.isNull()) {
-        qDebug() << "截图失败，无法检测翻页状态";
+    if (!pageTemplatesLoaded || !hasGameWindow()) {
         return false;
     }
     
-    // 从坐标(532,560)开始，截取5x5的图像
+    // 从坐标(532,560)开始，只截取5x5的图像
     QRect captureRect(532, 560, 5, 5);
-    QImage pageCheckImage = screenshot.copy(captureRect);
+    QImage pageCheckImage = captureGameRegions({captureRect}).image(0);
     
     if (pageCheckImage.isNull()) {
         qDebug() << "翻页检测区域截取失败";
@@ -4489,7 +4802,7 @@ QPair<bool, bool> StarryCard::dynamicRecognizeClover(const QString& cloverType,
     }
     
     // 检查窗口有效性
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         qDebug() << "游戏窗口无效，无法进行四叶草识别";
         return qMakePair(false, false);
     }
@@ -4648,13 +4961,43 @@ QPair<bool, bool> StarryCard::recognizeSpice(const QString& spiceType, bool spic
         return qMakePair(false, false);
     }
     
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         qDebug() << "游戏窗口无效，无法进行香料识别";
         return qMakePair(false, false);
     }
     
     qDebug() << QString("开始识别香料: %1").arg(spiceType);
-    
+
+    // 优先使用物品栏索引直接翻到所在页；索引中没有或与画面不符时重建一次，仍未找到再逐页查找
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        StripSlotEntry entry;
+        if (!locateStripItem(spiceStripIndex, spiceSlotClassifier(), spiceType, spice_bound, spice_unbound, entry)) {
+            if (spiceStripIndex.isBuilt() && attempt == 0) {
+                // 建立索引后物品可能有增减，或个别格子识别失败，不能据此判定已用完
+                spiceStripIndex.invalidate();
+                continue;
+            }
+            break;
+        }
+
+        QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+        QPoint center = spiceStripIndex.slotCenter(entry.slot);
+        int result = recognizeSingleSpice(spiceStripIndex.slotImage(screenshot, entry.slot), spiceType,
+                                          center.x(), center.y(), spice_bound, spice_unbound);
+        if (result == 1) {
+            return qMakePair(true, entry.bound);
+        } else if (result == 2) {
+            // 数量不足，与逐页查找一致直接返回
+            return qMakePair(false, false);
+        }
+        qDebug() << "香料物品栏索引与画面不符，重新建立索引";
+        spiceStripIndex.invalidate();
+    }
+
+    // 索引不可用时逐页查找，之后物品栏当前页未知
+    spiceStripIndex.invalidate();
+    spiceStripIndex.currentPage = -1;
+
     // 添加重试机制：如果30次翻页都没找到，重试最多3次
     const int maxRetries = 3;
     for (int retryCount = 0; retryCount < maxRetries; ++retryCount) {
@@ -4669,8 +5012,8 @@ QPair<bool, bool> StarryCard::recognizeSpice(const QString& spiceType, bool spic
             break;
         }
 
-        leftClickDPI(hwndGame, 532, 539);
-        sleepByQElapsedTimer(100);
+        leftClickIdempotent(532, 539);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 150));
         
         if (attempt == 19) {
             qDebug() << "翻页到顶部失败，已达最大尝试次数";
@@ -4697,7 +5040,7 @@ QPair<bool, bool> StarryCard::recognizeSpice(const QString& spiceType, bool spic
         
         // 点击下翻按钮
         leftClickDPI(hwndGame, 535, 563);
-        sleepByQElapsedTimer(200);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 200));
         
         // 使用动态识别识别当前页面
         result = dynamicRecognizeSpice(spiceType, spice_bound, spice_unbound);
@@ -4745,65 +5088,30 @@ int StarryCard::recognizeSingleSpice(const QImage& spiceImage, const QString& sp
         return 0;  // 绑定状态不匹配，继续翻页
     }
     
-    // 步骤2: 点击前，保存香料放置区域的当前状态（用于判断是否成功选中）
-    QImage screenshotBefore = captureWindowByHandle(hwndGame, "点击香料前");
-    QImage spiceAreaBefore = screenshotBefore.copy(SPICE_AREA_HOUSE);
-    
-    // 步骤3: 点击该香料中心位置
-            leftClickDPI(hwndGame, positionX, positionY);
-            qDebug() << QString("点击香料中心位置: (%1, %2)").arg(positionX).arg(positionY);
-    
-    // 步骤4: 动态检测香料放置区域变化（最多等待2秒）
-    const int maxWaitTime = 2000;
-    const int checkInterval = 50;
-    int elapsedTime = 0;
+    // 步骤2: 点击该香料中心位置，只观察香料放置区域，区域变化即返回（数量不足5个时放置区域不变）
+    qDebug() << QString("点击香料中心位置: (%1, %2)").arg(positionX).arg(positionY);
+    ClickVerifier::Options options;
+    options.reactionTimeoutMs = 1000;
+    ClickReaction reaction = clickVerifier->click(QPoint(positionX, positionY), SPICE_AREA_HOUSE, options);
+    bool spiceAreaChanged = reaction.changed;
+    if (spiceAreaChanged) {
+        qDebug() << QString("检测到香料放置区域变化，耗时%1ms").arg(reaction.latencyMs);
+    }
     
-    QString hashBefore = calculateImageHash(spiceAreaBefore, QRect(0, 0, SPICE_AREA_HOUSE.width(), SPICE_AREA_HOUSE.height()));
-    bool spiceAreaChanged = false;
-    QString hashAfter;
+    // 步骤3: 验证是否成功选中香料
+    // 情况1：检查被点击位置的香料图标是否消失（0<数量<5）
+    // 香料图标在香料区域(49*49)内的位置是(6,6,32,16)
+    // 香料图标的绝对位置 = 香料区域中心 - 香料区域半宽 + 图标偏移
+    QRect clickedSpiceRect(positionX - 49/2 + spiceTemplateRoi.x(), 
+                           positionY - 49/2 + spiceTemplateRoi.y(), 
+                           spiceTemplateRoi.width(), 
+                           spiceTemplateRoi.height());
+    RegionFrame clickedSpiceFrame = captureGameRegions({clickedSpiceRect});
+    bool spiceDisappeared = !clickedSpiceFrame.isNull()
+        && spiceTemplateHashes[spiceType] != calculateImageHash(clickedSpiceFrame.image(0));
     
-    QElapsedTimer waitTimer;
-    waitTimer.start();
-    
-    while (elapsedTime < maxWaitTime) {
-        sleepByQElapsedTimer(checkInterval);
-        elapsedTime = waitTimer.elapsed();
-        
-        // 截图并检查放置区域
-        QImage screenshotCheck = captureWindowByHandle(hwndGame, "动态检测香料");
-        if (screenshotCheck.isNull()) {
-            continue;
-        }
-        
-        QImage spiceAreaCheck = screenshotCheck.copy(SPICE_AREA_HOUSE);
-        hashAfter = calculateImageHash(spiceAreaCheck, QRect(0, 0, SPICE_AREA_HOUSE.width(), SPICE_AREA_HOUSE.height()));
-        
-        if (hashBefore != hashAfter) {
-            spiceAreaChanged = true;
-            qDebug() << QString("检测到香料放置区域变化，耗时%1ms").arg(elapsedTime);
-            break;
-        }
-    }
-    
-    if (!spiceAreaChanged) {
-        qDebug() << QString("等待%1ms后，香料放置区域未变化").arg(elapsedTime);
-    }
-    
-    // 步骤5: 验证是否成功选中香料
-    QImage screenshotAfter = captureWindowByHandle(hwndGame, "点击香料后");
-    
-    // 情况1：检查被点击位置的香料图标是否消失（0<数量<5）
-    // 香料图标在香料区域(49*49)内的位置是(6,6,32,16)
-    // 香料图标的绝对位置 = 香料区域中心 - 香料区域半宽 + 图标偏移
-    QRect clickedSpiceRect(positionX - 49/2 + spiceTemplateRoi.x(), 
-                           positionY - 49/2 + spiceTemplateRoi.y(), 
-                           spiceTemplateRoi.width(), 
-                           spiceTemplateRoi.height());
-    QImage clickedSpiceAfter = screenshotAfter.copy(clickedSpiceRect);
-    bool spiceDisappeared = (spiceTemplateHashes[spiceType] != calculateImageHash(clickedSpiceAfter, QRect(0, 0, spiceTemplateRoi.width(), spiceTemplateRoi.height())));
-    
-    // 情况2：使用动态检测的结果
-    // spiceAreaChanged 已经在动态检测中计算好了
+    // 情况2：使用动态检测的结果
+    // spiceAreaChanged 已经在动态检测中计算好了
     
     // 判断结果
     if (spiceDisappeared) {
@@ -4897,7 +5205,7 @@ QPair<bool, bool> StarryCard::dynamicRecognizeSpice(const QString& spiceType, bo
     }
     
     // 检查窗口有效性
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         qDebug() << "游戏窗口无效，无法进行香料识别";
         return qMakePair(false, false);
     }
@@ -4993,6 +5301,147 @@ QPair<bool, bool> StarryCard::dynamicRecognizeSpice(const QString& spiceType, bo
     return qMakePair(false, false);
 }
 
+// ================== 物品栏索引 ==================
+
+bool StarryCard::rewindItemStrip()
+{
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        if (isPageAtTop()) {
+            return true;
+        }
+        leftClickIdempotent(532, 539);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 150));
+    }
+    qDebug() << "翻页到顶部失败";
+    return false;
+}
+
+bool StarryCard::buildStripIndex(StripInventory& index, const StripInventory::SlotClassifier& classify)
+{
+    index.clear();
+    if (!pageTemplatesLoaded || !hasGameWindow()) {
+        return false;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!rewindItemStrip()) {
+        index.currentPage = -1;
+        return false;
+    }
+    index.currentPage = 0;
+
+    // 自上而下只翻一遍，每页一次截图识别全部10个格子
+    const int maxPages = 30;
+    int pageCount = 0;
+    while (pageCount < maxPages) {
+        QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+        if (screenshot.isNull()) {
+            index.currentPage = -1;
+            return false;
+        }
+        index.addPage(screenshot, pageCount, classify);
+        pageCount++;
+
+        if (isPageAtBottom()) {
+            break;
+        }
+        leftClickDPI(hwndGame, 535, 563);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 200));
+        index.currentPage = pageCount;
+    }
+
+    index.finishBuild(pageCount);
+    qDebug() << QString("%1物品栏索引耗时%2ms").arg(index.name()).arg(timer.elapsed());
+    return true;
+}
+
+bool StarryCard::jumpToStripPage(StripInventory& index, int page)
+{
+    // 当前页未知或目标为首页时，翻到顶部作为基准
+    if (index.currentPage < 0 || page == 0) {
+        if (!rewindItemStrip()) {
+            index.currentPage = -1;
+            return false;
+        }
+        index.currentPage = 0;
+    }
+
+    while (index.currentPage < page) {
+        leftClickDPI(hwndGame, 535, 563);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 200));
+        index.currentPage++;
+    }
+    while (index.currentPage > page) {
+        leftClickDPI(hwndGame, 532, 539);
+        waitForScreenSettle(ITEM_STRIP_AREA, SettleOptions(600, 2, 1.5, 15, 150));
+        index.currentPage--;
+    }
+    return true;
+}
+
+bool StarryCard::locateStripItem(StripInventory& index, const StripInventory::SlotClassifier& classify, const QString& item,
+                                 bool acceptBound, bool acceptUnbound, StripSlotEntry& entry)
+{
+    if (!index.isBuilt() && !buildStripIndex(index, classify)) {
+        return false;
+    }
+
+    const StripSlotEntry* found = index.find(item, acceptBound, acceptUnbound);
+    if (!found) {
+        qDebug() << QString("%1物品栏索引中没有符合要求的 %2").arg(index.name()).arg(item);
+        return false;
+    }
+    entry = *found;
+
+    if (!jumpToStripPage(index, entry.page)) {
+        index.invalidate();
+        return false;
+    }
+    qDebug() << QString("按索引定位 %1：第%2页第%3格").arg(item).arg(entry.page + 1).arg(entry.slot + 1);
+    return true;
+}
+
+StripInventory::SlotClassifier StarryCard::cloverSlotClassifier()
+{
+    // 反查表只建立一次，每个格子只计算一次哈希
+    QHash<QString, QString> nameByHash;
+    for (auto it = cloverTemplateHashes.constBegin(); it != cloverTemplateHashes.constEnd(); ++it) {
+        nameByHash.insert(it.value(), it.key());
+    }
+
+    return [this, nameByHash](const QImage& slotImage, StripSlotEntry& entry) {
+        QString name = nameByHash.value(calculateImageHash(slotImage, QRect(4, 4, 38, 24)));
+        if (name.isEmpty()) {
+            return false;
+        }
+        entry.item = name;
+        entry.bound = isCloverBound(slotImage);
+        entry.quantity = digitRecognizer ? digitRecognizer->recognizeSlotQuantity(slotImage) : -1;
+        return true;
+    };
+}
+
+StripInventory::SlotClassifier StarryCard::spiceSlotClassifier()
+{
+    QHash<QString, QString> nameByHash;
+    for (auto it = spiceTemplateHashes.constBegin(); it != spiceTemplateHashes.constEnd(); ++it) {
+        nameByHash.insert(it.value(), it.key());
+    }
+
+    return [this, nameByHash](const QImage& slotImage, StripSlotEntry& entry) {
+        QString name = nameByHash.value(calculateImageHash(slotImage, spiceTemplateRoi));
+        if (name.isEmpty()) {
+            return false;
+        }
+        entry.item = name;
+        entry.bound = isSpiceBound(slotImage);
+        entry.quantity = digitRecognizer ? digitRecognizer->recognizeSlotQuantity(slotImage) : -1;
+        return true;
+    };
+}
+
 // ================== 配方识别功能实现 ==================
 
 // calculateRecipeHistogram 函数已迁移到 RecipeRecognizer 类
@@ -5005,40 +5454,26 @@ bool StarryCard::clickRecipeAndVerify(const QPoint& clickPos, const QString& tar
             qDebug() << QString("配方选择错误，重新识别（第%1次重试）").arg(retry);
         }
         
-        // 点击配方
-        leftClickDPI(hwndGame, clickPos.x(), clickPos.y());
+        // 点击配方，只观察配方槽，槽内图像与目标配方一致即返回
         qDebug() << QString("点击配方位置: (%1, %2)").arg(clickPos.x()).arg(clickPos.y());
-        
-        // 动态检查配方是否正确
-        bool recipeCheckPassed = false;
-        int maxAttempts = 200;      // 最多尝试200次（2秒）
-        int checkInterval = 10;     // 每10ms检查一次
-        int totalWaitTime = 0;
-        
-        for (int attempt = 1; attempt <= maxAttempts; attempt++) {
-            sleepByQElapsedTimer(checkInterval);
-            totalWaitTime += checkInterval;
-            
-            // 调用检查函数
-            if (checkRecipeSelectionBeforeProduction(targetRecipe)) {
-                recipeCheckPassed = true;
-                qDebug() << QString("配方加载完成（第%1次检查，耗时%2ms）")
-                       .arg(attempt).arg(totalWaitTime);
-                return true;  // 成功
+        ClickReaction reaction = clickVerifier->click(clickPos, RECIPE_SLOT_POS, recipeSlotOptions(targetRecipe));
+        if (reaction.matched) {
+            qDebug() << QString("配方加载完成，耗时%1ms").arg(reaction.latencyMs);
+            return true;
+        }
+        
+        // 配方槽变成了其他配方时先取消选择；槽内没有变化说明点击未生效，直接重新点击
+        if (reaction.changed && retry < maxRetries - 1) {
+            qDebug() << "配方选择检查失败，取消配方选择";
+            // 点击取消配方，配方槽恢复为空槽图案即返回
+            ClickVerifier::Options cancelOptions;
+            const QString emptySlotHash = synHousePosTemplateHashes.value("recipeSlotEmpty");
+            cancelOptions.expected = [this, emptySlotHash](const QImage& slot) {
+                return !emptySlotHash.isEmpty() && calculateImageHash(slot) == emptySlotHash;
+            };
+            if (!clickVerifier->click(QPoint(288, 360), RECIPE_SLOT_EMPTY_POS, cancelOptions).matched) {
+                qDebug() << "取消配方后配方槽未恢复为空";
             }
-            
-            // 如果还在循环中，说明检查未通过，继续等待
-            if (attempt < maxAttempts) {
-                qDebug() << QString("第%1次配方检查未通过，继续等待...").arg(attempt);
-            }
-        }
-        
-        // 检查失败，取消配方选择
-        if (!recipeCheckPassed && retry < maxRetries - 1) {
-            qDebug() << QString("配方选择检查失败（已尝试%1次，总耗时%2ms），取消配方选择")
-                   .arg(maxAttempts).arg(totalWaitTime);
-            leftClickDPI(hwndGame, 288, 360);  // 点击取消配方
-            sleepByQElapsedTimer(200);         // 等待取消完成
         }
     }
     
@@ -5047,14 +5482,41 @@ bool StarryCard::clickRecipeAndVerify(const QPoint& clickPos, const QString& tar
     return false;
 }
 
+ClickVerifier::Options StarryCard::recipeSlotOptions(const QString& targetRecipe)
+{
+    ClickVerifier::Options options;
+    const QString expectedHash = recipeRecognizer ? recipeRecognizer->getRecipeHash(targetRecipe) : QString();
+    options.expected = [this, expectedHash](const QImage& slot) {
+        return !expectedHash.isEmpty() && calculateImageHash(slot) == expectedHash;
+    };
+    return options;
+}
+
 // 执行配方识别和点击的完整流程
 bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
 {
-    if (!recipeRecognizer || !hwndGame || !IsWindow(hwndGame)) {
+    if (!recipeRecognizer || !hasGameWindow()) {
         addLog("参数检查失败：配方识别器或游戏窗口无效", LogType::Error);
         return false;
     }
     
+    // 优先使用配方位置索引：首次调用时一次遍历建立索引，之后直接滚动点击
+    if (!recipeIndexBuilt) {
+        buildRecipeIndex();
+    }
+    if (recipeLocationIndex.contains(targetRecipe)) {
+        if (clickIndexedRecipe(targetRecipe)) {
+            return true;
+        }
+        // 配方用完后列表会重排，索引失效，下次调用时重新建立
+        qDebug() << QString("按索引选择配方 %1 失败，按配方顺序二分查找").arg(targetRecipe);
+        invalidateRecipeIndex();
+        if (navigateToRecipeByOrder(targetRecipe)) {
+            return true;
+        }
+        qDebug() << QString("二分查找配方 %1 失败，回退到逐页查找").arg(targetRecipe);
+    }
+    
     // 添加重试机制：如果10页都没找到，重试最多3次
     const int maxRetries = 3;
     for (int retryCount = 0; retryCount < maxRetries; ++retryCount) {
@@ -5064,7 +5526,7 @@ bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
     
     // 步骤1: 使用动态识别当前页面
     qDebug() << "开始动态配方识别（当前页面）...";
-    RecipeClickInfo currentResult = recipeRecognizer->dynamicRecognizeRecipe(hwndGame, "主页面", targetRecipe);
+    RecipeClickInfo currentResult = recipeRecognizer->dynamicRecognizeRecipe(*frameSource.load(), targetRecipe);
     if (currentResult.found) {
         // 在当前页面找到配方，点击并验证
         qDebug() << QString("在当前页面找到配方: (%1, %2), 相似度: %3")
@@ -5092,10 +5554,14 @@ bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
     }
     
     qDebug() << QString("配方滚动条信息: 长度=%1, 当前位置=%2").arg(scrollBarLength).arg(scrollBarPosition);
+    if (scrollBarLength != recipeScrollBarLength) {
+        // 配方数量变化，索引时学到的行距和底端位置已失效
+        recipeScroll->resetTrack();
+    }
     
     // 步骤3: 在顶部页面识别
     qDebug() << "开始动态配方识别（顶部页面）...";
-    RecipeClickInfo topResult = recipeRecognizer->dynamicRecognizeRecipe(hwndGame, "主页面", targetRecipe);
+    RecipeClickInfo topResult = recipeRecognizer->dynamicRecognizeRecipe(*frameSource.load(), targetRecipe);
     if (topResult.found) {
         // 在顶部页面找到配方，点击并验证
         qDebug() << QString("在顶部页面找到配方: (%1, %2), 相似度: %3")
@@ -5111,19 +5577,10 @@ bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
         bool foundInScroll = false;
     
     for (int pageCount = 1; pageCount <= maxScrollPages; ++pageCount) {
-        // 使用配方专属滚动方法，严格翻3行配方
-        fastMouseDragForRecipe(scrollBarPosition, scrollBarLength, true);
-        qDebug() << QString("配方翻页: 第 %1 页 (滚动条移动约%2像素，1/2长度)")
-               .arg(pageCount).arg(getRecipeScrollDistance(scrollBarLength));
-        
-        // 等待滚动条位置变化（使用卡片的滚动条检测方法）
-        while (getPositionOfScrollBar(screenshot) == scrollBarPosition) {
-            sleepByQElapsedTimer(100);
-            screenshot = captureWindowByHandle(hwndGame, "主页面");
-        }
-        
-        // 更新滚动条位置
-        int newScrollBarPosition = getPositionOfScrollBar(screenshot);
+        // 闭环滚动一页，拖动后按实际位置修正
+        int newScrollBarPosition = scrollRecipePage(scrollBarLength, scrollBarPosition);
+        qDebug() << QString("配方翻页: 第 %1 页").arg(pageCount);
+        screenshot = captureWindowByHandle(hwndGame, "主页面");
         qDebug() << QString("滚动条位置变化: %1 -> %2").arg(scrollBarPosition).arg(newScrollBarPosition);
         
         // 检查是否真正滚动了
@@ -5136,7 +5593,7 @@ bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
         
         // 使用动态识别
         qDebug() << QString("开始动态配方识别（第 %1 页）...").arg(pageCount);
-        RecipeClickInfo pageResult = recipeRecognizer->dynamicRecognizeRecipe(hwndGame, "主页面", targetRecipe);
+        RecipeClickInfo pageResult = recipeRecognizer->dynamicRecognizeRecipe(*frameSource.load(), targetRecipe);
         if (pageResult.found) {
             // 找到配方，点击并验证
             qDebug() << QString("在第 %1 页找到配方: (%2, %3), 相似度: %4")
@@ -5168,10 +5625,173 @@ bool StarryCard::performRecipeRecognitionAndClick(const QString& targetRecipe)
     return false;
 }
 
+bool StarryCard::buildRecipeIndex()
+{
+    recipeLocationIndex.clear();
+    recipeIndexBuilt = false;
+    
+    if (!recipeRecognizer || !resetRecipeScrollBar()) {
+        qDebug() << "配方索引建立失败：无法重置配方滚动条";
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    waitForScreenSettle(RECIPE_RECOGNITION_AREA, SettleOptions(500, 2));
+    QImage screenshot = captureWindowByHandle(hwndGame, "主页面");
+    int scrollBarLength = getLengthOfScrollBar(screenshot);
+    int scrollBarPosition = getPositionOfScrollBar(screenshot);
+    if (scrollBarLength != recipeScrollBarLength) {
+        recipeScroll->resetTrack();
+    }
+    
+    const int maxScrollPages = 10;
+    QHash<QString, int> previousPageRows;  // 上一页配方 -> 点击位置y
+    int previousPosition = -1;
+    for (int pageCount = 0; pageCount <= maxScrollPages; ++pageCount) {
+        // 一次遍历当前页所有格子，已记录的配方保留首次出现的位置
+        QHash<QString, int> pageRows;
+        for (const RecipeCellInfo& cell : recipeRecognizer->indexRecipesInCurrentPage(screenshot)) {
+            pageRows[cell.name] = cell.clickPosition.y();
+            if (!recipeLocationIndex.contains(cell.name)) {
+                RecipeLocation location;
+                location.scrollBarPosition = scrollBarPosition;
+                location.clickPosition = cell.clickPosition;
+                recipeLocationIndex[cell.name] = location;
+            }
+        }
+        
+        // 两页都出现的配方上移的像素数换算成行数，与滚动条移动距离之比即为行距
+        if (previousPosition >= 0) {
+            for (auto it = pageRows.constBegin(); it != pageRows.constEnd(); ++it) {
+                if (previousPageRows.contains(it.key())) {
+                    const double rows = double(previousPageRows[it.key()] - it.value()) / RecipeRecognizer::RECIPE_GRID_HEIGHT;
+                    recipeScroll->observeRowPitch(scrollBarPosition - previousPosition, rows);
+                    break;
+                }
+            }
+        }
+        previousPageRows = pageRows;
+        previousPosition = scrollBarPosition;
+        
+        bool isAtBottom = checkSynHousePosState(screenshot, RECIPE_SCROLL_BAR_BOTTOM, "recipeScrollBottom") ||
+                          checkSynHousePosState(screenshot, RECIPE_SCROLL_BAR_BOTTOM, "recipeScrollBottomLight");
+        if (isAtBottom || scrollBarLength <= 0) {
+            break;
+        }
+        
+        int newScrollBarPosition = scrollRecipePage(scrollBarLength, scrollBarPosition);
+        if (newScrollBarPosition == scrollBarPosition) {
+            break;
+        }
+        scrollBarPosition = newScrollBarPosition;
+        
+        waitForScreenSettle(RECIPE_RECOGNITION_AREA, SettleOptions(500, 2));
+        screenshot = captureWindowByHandle(hwndGame, "主页面");
+    }
+    
+    // 配方按游戏固定顺序排列：先按所在页，再按页内行列；列表重排后相对顺序不变
+    QStringList order = recipeLocationIndex.keys();
+    std::sort(order.begin(), order.end(), [this](const QString& a, const QString& b) {
+        const RecipeLocation& la = recipeLocationIndex[a];
+        const RecipeLocation& lb = recipeLocationIndex[b];
+        if (la.scrollBarPosition != lb.scrollBarPosition) {
+            return la.scrollBarPosition < lb.scrollBarPosition;
+        }
+        if (la.clickPosition.y() != lb.clickPosition.y()) {
+            return la.clickPosition.y() < lb.clickPosition.y();
+        }
+        return la.clickPosition.x() < lb.clickPosition.x();
+    });
+    recipeNavigator.setOrder(order);
+    recipeScrollBarLength = scrollBarLength;
+    
+    recipeIndexBuilt = true;
+    qDebug() << QString("配方索引建立完成：%1种配方，行距%2，耗时%3ms")
+                .arg(recipeLocationIndex.size()).arg(recipeScroll->rowPitch(), 0, 'f', 2).arg(timer.elapsed());
+    return true;
+}
+
+bool StarryCard::clickIndexedRecipe(const QString& targetRecipe)
+{
+    RecipeLocation location = recipeLocationIndex.value(targetRecipe);
+    
+    int scrollBarPosition = getPositionOfScrollBar();
+    
+    // 不在目标页时，从当前位置闭环拖动到索引记录的滚动条位置
+    if (scrollBarPosition != location.scrollBarPosition) {
+        scrollBarPosition = recipeScroll->scrollTo(location.scrollBarPosition, scrollBarPosition);
+        if (scrollBarPosition != location.scrollBarPosition) {
+            qDebug() << QString("配方滚动条未到达索引位置：期望%1，实际%2").arg(location.scrollBarPosition).arg(scrollBarPosition);
+            return false;
+        }
+        waitForScreenSettle(RECIPE_RECOGNITION_AREA, SettleOptions(500, 2));
+    }
+    
+    // 点击后观察配方槽，不做重试，失败由调用方回退到逐页查找
+    ClickReaction reaction = clickVerifier->click(location.clickPosition, RECIPE_SLOT_POS, recipeSlotOptions(targetRecipe));
+    if (reaction.matched) {
+        qDebug() << QString("按索引选择配方成功: %1 (%2, %3)，耗时%4ms").arg(targetRecipe)
+                    .arg(location.clickPosition.x()).arg(location.clickPosition.y()).arg(reaction.latencyMs);
+        return true;
+    }
+    return false;
+}
+
+void StarryCard::invalidateRecipeIndex()
+{
+    // 只清空位置，配方顺序在列表重排后仍然有效
+    recipeLocationIndex.clear();
+    recipeIndexBuilt = false;
+}
+
+bool StarryCard::navigateToRecipeByOrder(const QString& targetRecipe)
+{
+    if (!recipeNavigator.contains(targetRecipe) || recipeScrollBarLength <= 0) {
+        return false;
+    }
+    
+    QElapsedTimer timer;
+    timer.start();
+    
+    QList<RecipeCellInfo> visibleCells;
+    auto probe = [this, &visibleCells]() {
+        waitForScreenSettle(RECIPE_RECOGNITION_AREA, SettleOptions(500, 2));
+        visibleCells = recipeRecognizer->indexRecipesInCurrentPage(captureWindowByHandle(hwndGame, "主页面"));
+        std::sort(visibleCells.begin(), visibleCells.end(), [](const RecipeCellInfo& a, const RecipeCellInfo& b) {
+            return a.clickPosition.y() != b.clickPosition.y() ? a.clickPosition.y() < b.clickPosition.y()
+                                                              : a.clickPosition.x() < b.clickPosition.x();
+        });
+        QStringList names;
+        for (const RecipeCellInfo& cell : visibleCells) {
+            names.append(cell.name);
+        }
+        return names;
+    };
+    auto move = [this](int position) { return recipeScroll->scrollTo(position); };
+    
+    // 配方用完后列表变短、滚动条变长，可滚动范围只会缩小，超出部分由滚动条自然挡住
+    const int maxPosition = SCROLL_BAR_COLUMN.height() - recipeScrollBarLength;
+    OrderedListNavigator::Result result = recipeNavigator.find(targetRecipe, 0, maxPosition, probe, move);
+    qDebug() << QString("二分查找配方 %1：结果%2，拖动识别%3次，耗时%4ms")
+                .arg(targetRecipe).arg(result.outcome).arg(result.probes).arg(timer.elapsed());
+    if (result.outcome != OrderedListNavigator::Found) {
+        return false;
+    }
+    
+    for (const RecipeCellInfo& cell : visibleCells) {
+        if (cell.name == targetRecipe) {
+            return clickRecipeAndVerify(cell.clickPosition, targetRecipe);
+        }
+    }
+    return false;
+}
+
 // 执行配方页面导航点击
 void StarryCard::performRecipePageNavigation(int clickX, int clickY)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法执行页面导航", LogType::Error);
         return;
     }
@@ -5196,38 +5816,111 @@ void StarryCard::updateRecipeCombo()
     qDebug() << "updateRecipeCombo: 配方下拉框已移除（仅在Debug模式使用固定测试配方）";
 }
 
+// 回到顶部的上翻、滚动条置顶等按钮：已到顶部后再点没有效果，画面没有变化的重复点击可以合并
+BOOL StarryCard::leftClickIdempotent(int x, int y)
+{
+    sessionRecorder->recordClick(x, y);
+    captureGovernor->notifyInput();
+    return gameInputSink()->clickIdempotent(QPoint(x, y));
+}
+
 // 发送鼠标消息,计算DPI缩放
 BOOL StarryCard::leftClickDPI(HWND hwnd, int x, int y)
 {
+    sessionRecorder->recordClick(x, y);
+    captureGovernor->notifyInput();
+
+    // 游戏窗口的点击经过限流和合并，其他窗口直接发送
+    if (hwnd == hwndGame) {
+        return gameInputSink()->click(QPoint(x, y));
+    }
+
     double scaleFactor = static_cast<double>(DPI) / 96.0;
     
     // 计算DPI缩放后的坐标
     int scaledX = static_cast<int>(x * scaleFactor);
     int scaledY = static_cast<int>(y * scaleFactor);
-
-    // 发送鼠标消息
-    BOOL bResult = PostMessage(hwnd, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(scaledX, scaledY));
-    PostMessage(hwnd, WM_LBUTTONUP, 0, MAKELPARAM(scaledX, scaledY));
-    return bResult;
+    return Win32InputSink::postClick(hwnd, scaledX, scaledY);
 }
 
 // 发送鼠标消息,不计算缩放
 BOOL StarryCard::leftClick(HWND hwnd, int x, int y)
 {
     // 发送鼠标消息
-    BOOL bResult = PostMessage(hwnd, WM_LBUTTONDOWN, MK_LBUTTON, MAKELPARAM(x, y));
-    PostMessage(hwnd, WM_LBUTTONUP, 0, MAKELPARAM(x, y));
-    return bResult;
+    sessionRecorder->recordClick(x, y);
+    captureGovernor->notifyInput();
+    return Win32InputSink::postClick(hwnd, x, y);
 }
 
-void StarryCard::sleepByQElapsedTimer(int ms)
+bool StarryCard::sleepByQElapsedTimer(int ms)
 {
-    QElapsedTimer timer;
-    timer.start();
-    while (timer.elapsed() < ms)
-    {
-        QCoreApplication::processEvents(); // 不停地处理事件，让程序保持响应
+    if (QThread::currentThread() != thread()) {
+        // 工作线程在本线程绑定的会话令牌上等待，停止强化时立即返回
+        std::shared_ptr<StopToken> token = StopToken::current();
+        if (!token) {
+            QThread::msleep(static_cast<unsigned long>(qMax(ms, 0)));
+            return true;
+        }
+        return token->sleepFor(ms);
     }
+    if (ms <= 0) {
+        return true;
+    }
+    
+    // 主线程在局部事件循环中等待定时器，界面保持响应且不空转；停止强化时立即退出
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    QEventLoop* outerLoop = guiWaitLoop;
+    guiWaitLoop = &loop;
+    const bool completed = loop.exec() == 0;
+    guiWaitLoop = outerLoop;
+    return completed;
+}
+
+bool StarryCard::isEnhancing() const
+{
+    if (QThread::currentThread() != thread()) {
+        std::shared_ptr<StopToken> token = StopToken::current();
+        return token && !token->stopRequested();
+    }
+    return !sessionStop->stopRequested();
+}
+
+void StarryCard::requestStop()
+{
+    if (QThread::currentThread() != thread()) {
+        if (std::shared_ptr<StopToken> token = StopToken::current()) {
+            token->requestStop();
+        }
+        return;
+    }
+    sessionStop->requestStop();
+    // 停止请求来自主线程时，同时结束主线程正在进行的等待
+    if (guiWaitLoop) {
+        guiWaitLoop->exit(1);
+    }
+}
+
+SettleResult StarryCard::waitForScreenSettle(const QRect& roi, const SettleOptions& options)
+{
+    if (!hasGameWindow()) {
+        // 窗口无效时退化为固定延时
+        sleepByQElapsedTimer(options.timeoutMs);
+        SettleResult result;
+        result.settleMs = options.timeoutMs;
+        return result;
+    }
+
+    quint64 lastSequence = 0;
+    SettleDetector detector([this, &lastSequence]() { return captureNewGameFrame(lastSequence); },
+                            [this](int ms) { sleepByQElapsedTimer(ms); });
+    // 工作线程中的等待随会话停止立即结束
+    if (QThread::currentThread() != thread()) {
+        if (std::shared_ptr<StopToken> token = StopToken::current()) {
+            detector.setStopPredicate([token]() { return token->stopRequested(); });
+        }
+    }
+    return detector.waitForSettle(roi, options);
 }
 
 // 检测颜色是否符合指定游戏平台的特征颜色
@@ -5265,12 +5958,9 @@ BOOL StarryCard::isGamePlatformColor(COLORREF color, int platformType)
     return FALSE;
 }
 
-BOOL StarryCard::getWindowBitmap(HWND hwnd, int& width, int& height, COLORREF*& pixelData)
+BOOL StarryCard::getWindowBitmap(HWND hwnd, FrameHandle& frame)
 {
-    // 初始化输出参数
-    width = 0;
-    height = 0;
-    pixelData = nullptr;
+    frame.reset();
     
     // 验证窗口句柄
     if (!hwnd || !IsWindow(hwnd)) {
@@ -5278,14 +5968,6 @@ BOOL StarryCard::getWindowBitmap(HWND hwnd, int& width, int& height, COLORREF*&
         return FALSE;
     }
     
-    // 释放之前的全局像素数据
-    if (globalPixelData != nullptr) {
-        delete[] globalPixelData;
-        globalPixelData = nullptr;
-        globalBitmapWidth = 0;
-        globalBitmapHeight = 0;
-    }
-    
     // 获取窗口整体尺寸（包含标题栏等）
     RECT windowRect;
     if (!GetWindowRect(hwnd, &windowRect)) {
@@ -5293,100 +5975,21 @@ BOOL StarryCard::getWindowBitmap(HWND hwnd, int& width, int& height, COLORREF*&
         return FALSE;
     }
     
-    width = windowRect.right - windowRect.left;
-    height = windowRect.bottom - windowRect.top;
+    int width = windowRect.right - windowRect.left;
+    int height = windowRect.bottom - windowRect.top;
     
     if (width <= 0 || height <= 0) {
         addLog("窗口尺寸无效", LogType::Error);
         return FALSE;
     }
     
-    // 获取窗口设备上下文
-    HDC hdcWindow = GetDC(hwnd);
-    if (!hdcWindow) {
-        addLog("获取窗口设备上下文失败", LogType::Error);
+    // 像素缓冲区从截图缓冲池获取，重复识别时复用同一块内存
+    frame = GdiFrameSource::captureWindowPooled(hwnd, QRect(0, 0, width, height), "大厅位图");
+    if (frame.isNull()) {
+        addLog("获取窗口位图失败", LogType::Error);
         return FALSE;
     }
     
-    // 创建兼容设备上下文
-    HDC hdcMem = CreateCompatibleDC(hdcWindow);
-    if (!hdcMem) {
-        addLog("创建兼容设备上下文失败", LogType::Error);
-        ReleaseDC(hwnd, hdcWindow);
-        return FALSE;
-    }
-    
-    // 创建兼容位图
-    HBITMAP hBitmap = CreateCompatibleBitmap(hdcWindow, width, height);
-    if (!hBitmap) {
-        addLog("创建兼容位图失败", LogType::Error);
-        DeleteDC(hdcMem);
-        ReleaseDC(hwnd, hdcWindow);
-        return FALSE;
-    }
-    
-    // 选择位图到内存设备上下文
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMem, hBitmap);
-    
-    // 复制窗口内容到位图
-    if (!BitBlt(hdcMem, 0, 0, width, height, hdcWindow, 0, 0, SRCCOPY)) {
-        addLog("复制窗口内容到位图失败", LogType::Error);
-        SelectObject(hdcMem, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMem);
-        ReleaseDC(hwnd, hdcWindow);
-        return FALSE;
-    }
-    
-    // 分配全局像素数据内存
-    int pixelCount = width * height;
-    globalPixelData = new(std::nothrow) COLORREF[pixelCount];
-    if (!globalPixelData) {
-        qDebug() << "分配像素数据内存失败";
-        SelectObject(hdcMem, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMem);
-        ReleaseDC(hwnd, hdcWindow);
-        return FALSE;
-    }
-    
-    // 设置BITMAPINFO结构
-    BITMAPINFO bmi = { 0 };
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = -height;  // 负值表示自上而下的位图
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;     // 32位色深
-    bmi.bmiHeader.biCompression = BI_RGB;
-    
-    // 获取位图像素数据
-    int scanLines = GetDIBits(hdcMem, hBitmap, 0, height, globalPixelData, &bmi, DIB_RGB_COLORS);
-    if (scanLines == 0) {
-        qDebug() << "获取位图像素数据失败";
-        delete[] globalPixelData;
-        globalPixelData = nullptr;
-        width = 0;
-        height = 0;
-        SelectObject(hdcMem, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMem);
-        ReleaseDC(hwnd, hdcWindow);
-        return FALSE;
-    }
-    else
-        qDebug() << QString("获取位图像素数据成功,行数为%1").arg(scanLines);
-    
-    // 设置全局变量和输出参数
-    globalBitmapWidth = width;
-    globalBitmapHeight = height;
-    pixelData = globalPixelData;
-    
-    // 清理资源
-    SelectObject(hdcMem, hOldBitmap);
-    DeleteObject(hBitmap);
-    DeleteDC(hdcMem);
-    ReleaseDC(hwnd, hdcWindow);
-    
     qDebug() << QString("成功获取窗口位图：%1x%2").arg(width).arg(height);
     return TRUE;
 }
@@ -5467,17 +6070,15 @@ int StarryCard::findLatestServer(int platformType, int *px, int *py)
         return -1;
     }
     
-    int hallWidth = 0, hallHeight = 0; // 大厅窗口尺寸
-    if (!getWindowBitmap(hwndHall, hallWidth, hallHeight, globalPixelData)) {
+    FrameHandle hallFrame;
+    if (!getWindowBitmap(hwndHall, hallFrame)) {
         addLog("获取大厅窗口位图失败", LogType::Error);
         return -1; // 获取大厅窗口失败，返回-1表示错误
     }
 
-    // 构造二级指针
-    COLORREF *pHallShot[4320]; //大厅截图二级指针，高度不超过8K分辨率4320
-    for (int i = 0; i < hallHeight; i++) {
-        pHallShot[i] = globalPixelData + i * hallWidth;
-    }
+    // 按行访问大厅截图的只读视图
+    FrameView hallShot = hallFrame.view();
+    int hallWidth = hallShot.width, hallHeight = hallShot.height; // 大厅窗口尺寸
 
     // 根据平台类型设置识别区域尺寸
     int width, height;
@@ -5508,7 +6109,7 @@ int StarryCard::findLatestServer(int platformType, int *px, int *py)
             QRect scanRegion(x, y, width, height);
             
             // 进行颜色识别
-            int result = recognizeBitmapRegionColor(platformType, pHallShot, scanRegion);
+            int result = recognizeBitmapRegionColor(platformType, hallShot, scanRegion);
             if (result == platformType) {
                 *px = x;
                 *py = y;
@@ -5530,7 +6131,7 @@ int StarryCard::findLatestServer(int platformType, int *px, int *py)
     return 0; // 未找到
 }
 
-int StarryCard::recognizeBitmapRegionColor(int platformType, COLORREF *pHallShot[4320], const QRect& region)
+int StarryCard::recognizeBitmapRegionColor(int platformType, const FrameView& hallShot, const QRect& region)
 {
     int step = 2;
     
@@ -5540,7 +6141,7 @@ int StarryCard::recognizeBitmapRegionColor(int platformType, COLORREF *pHallShot
         for (int y = 0; y < region.height(); y += step)
         {
             // 检测颜色是否匹配当前平台类型
-            if (!isGamePlatformColor(pHallShot[region.y() + y][region.x() + x], platformType))
+            if (!isGamePlatformColor(hallShot.pixel(region.x() + x, region.y() + y), platformType))
             {
                 return 0; // 返回0表示未识别成功
             }
@@ -5656,7 +6257,11 @@ BOOL StarryCard::refreshGameWindow()
     }
     qDebug() << "刷新成功";
 
-    sleepByQElapsedTimer(1000);
+    // 等待大厅中的选服页面加载完成
+    SettleDetector hallSettle([this]() { return captureWindowByHandle(hwndHall, "大厅"); },
+                              [this](int ms) { sleepByQElapsedTimer(ms); });
+    SettleResult hallResult = hallSettle.waitForSettle(QRect(), SettleOptions(3000, 5, 1.0, 50, 500));
+    qDebug() << QString("选服页面稳定耗时：%1ms").arg(hallResult.settleMs);
 
     hwndServer = getActiveServerWindow(hwndHall);
     if (!hwndServer) {
@@ -5845,11 +6450,6 @@ BOOL StarryCard::closeHealthTip(uint8_t retryCount)
         return FALSE;
     }
 
-    // 健康提示模板
-    QString healthTipPath = ":/images/position/healthyTip.png";
-    QImage imgTemplate(healthTipPath);
-    QString hashHealthyTip = calculateImageHash(imgTemplate);
-
     // 等待健康提示出现，最多等待10秒
     retryCount = retryCount > 10 ? 10 : retryCount;
     
@@ -5862,19 +6462,22 @@ BOOL StarryCard::closeHealthTip(uint8_t retryCount)
             return FALSE;
         }
 
-        QString hashHealthyTipCurrent = calculateImageHash(imgGame, QRect(378, 330, 20, 20));
-        QString hashRankCurrent = calculateImageHash(imgGame, QRect(178, 96, 20, 20));
+        bool rankVisible = sceneClassifier && sceneClassifier->isAnchorVisible(imgGame, "排行");
 
-        if (hashHealthyTipCurrent == hashHealthyTip) // 健康提示出现
+        if (popupRegistry->isVisible(imgGame, "健康提示")) // 健康提示出现
         {
             // 点击关闭健康提示
-            leftClickDPI(hwndGame, 588, 204);
+            for (const QPoint& click : popupRegistry->find("健康提示")->dismissClicks) {
+                leftClickDPI(hwndGame, click.x(), click.y());
+            }
             qDebug() << "点击关闭健康提示成功";
             sleepByQElapsedTimer(100); // 等待100毫秒
-            if(hashRankCurrent != positionTemplateHashes["(178,96)排行"]) // 健康提示出现且排行榜未出现，视为有假期特惠挡住
+            if(!rankVisible) // 健康提示出现且排行榜未出现，视为有假期特惠挡住
             {
                 // 点击关闭假期特惠
-                leftClickDPI(hwndGame, 840, 44);
+                for (const QPoint& click : popupRegistry->find("假期特惠")->dismissClicks) {
+                    leftClickDPI(hwndGame, click.x(), click.y());
+                }
                 qDebug() << "点击关闭假期特惠成功";
             }
             return TRUE;
@@ -5885,6 +6488,96 @@ BOOL StarryCard::closeHealthTip(uint8_t retryCount)
     return FALSE;
 }
 
+// ================== 弹窗检测功能实现 ==================
+
+void StarryCard::loadPopupTemplates()
+{
+    delete popupRegistry;
+    popupRegistry = new PopupRegistry([this](const QImage& image, const QRect& roi) {
+        return calculateImageHash(image, roi);
+    });
+
+    // 健康提示：点击右上角关闭
+    popupRegistry->registerPopup("健康提示", ":/images/position/healthyTip.png",
+                                 QRect(378, 330, 20, 20), {QPoint(588, 204)});
+    // 假期特惠：活动图每期不同，没有固定签名，只在页面锚点持续不可见时尝试点击右上角关闭
+    popupRegistry->registerFallback("假期特惠", {QPoint(840, 44)});
+
+    qDebug() << "弹窗模板加载完成，总数:" << popupRegistry->size();
+}
+
+bool StarryCard::isKnownSceneVisible(const QImage& screenshot)
+{
+    // 排行榜在大厅和页面中都可能可见，不作为定位依据
+    return sceneClassifier && sceneClassifier->anyAnchorVisible(screenshot, {"排行"});
+}
+
+PopupCheckResult StarryCard::checkPopups(const QImage& screenshot)
+{
+    if (screenshot.isNull() || !popupRegistry) {
+        return PopupCheckResult::None;
+    }
+
+    // 遮挡计时只在同一个轮询循环内延续：距上次检查超过间隔说明是新的等待，之前的计时作废
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (now - lastPopupCheckAt > POPUP_CHECK_GAP_MS) {
+        unknownOverlaySince = 0;
+        overlayFallbackTried = false;
+    }
+    lastPopupCheckAt = now;
+
+    const PopupEntry* popup = popupRegistry->match(screenshot);
+    if (popup) {
+        unknownOverlaySince = 0;
+        if (popup->blocking) {
+            qDebug() << "检测到需要中断流程的弹窗:" << popup->name;
+            return PopupCheckResult::Blocking;
+        }
+        for (const QPoint& click : popup->dismissClicks) {
+            leftClickDPI(hwndGame, click.x(), click.y());
+            waitForScreenSettle(QRect(), SettleOptions(800, 2, 1.5, 15, 100));
+        }
+        qDebug() << "检测到弹窗并已关闭:" << popup->name;
+        return PopupCheckResult::Dismissed;
+    }
+
+    if (isKnownSceneVisible(screenshot)) {
+        unknownOverlaySince = 0;
+        overlayFallbackTried = false;
+        return PopupCheckResult::None;
+    }
+
+    // 页面定位锚点持续不可见超过1.5秒（排除页面切换动画）时，先尝试没有签名的关闭方式，
+    // 尝试后锚点仍持续不可见1.5秒才视为被未知弹窗遮挡
+    if (unknownOverlaySince == 0) {
+        unknownOverlaySince = now;
+    }
+    if (now - unknownOverlaySince >= 1500 && !overlayFallbackTried) {
+        overlayFallbackTried = true;
+        for (const PopupEntry& fallback : popupRegistry->fallbacks()) {
+            for (const QPoint& click : fallback.dismissClicks) {
+                leftClickDPI(hwndGame, click.x(), click.y());
+                waitForScreenSettle(QRect(), SettleOptions(800, 2, 1.5, 15, 100));
+            }
+            qDebug() << "页面锚点持续不可见，尝试关闭:" << fallback.name;
+        }
+        unknownOverlaySince = QDateTime::currentMSecsSinceEpoch();
+        lastPopupCheckAt = unknownOverlaySince;
+        return PopupCheckResult::Dismissed;
+    }
+    if (now - unknownOverlaySince >= 1500) {
+        qDebug() << "检测到未知弹窗遮挡，持续时间:" << (now - unknownOverlaySince) << "ms";
+#ifdef DEBUG_BUILD
+        QString debugDir = QCoreApplication::applicationDirPath() + "/screenshots/debug_popup";
+        QDir().mkpath(debugDir);
+        screenshot.save(QString("%1/unknown_%2.png").arg(debugDir)
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz")));
+#endif
+        return PopupCheckResult::UnknownOverlay;
+    }
+    return PopupCheckResult::None;
+}
+
 // BOOL StarryCard::goToPageCardEnhance(uint8_t retryCount)
 // {
 //     for(int i = 0; i < retryCount; i++)
@@ -5936,6 +6629,13 @@ BOOL StarryCard::closeHealthTip(uint8_t retryCount)
 //     return FALSE;
 // }
 
+QString StarryCard::currentPageName(const QImage& screenshot)
+{
+    // 页面锚点键为"(x,y)描述"，导航图只使用描述部分
+    const QString scene = classifyScene(screenshot).scene;
+    return scene.mid(scene.indexOf(')') + 1);
+}
+
 BOOL StarryCard::goToPage(PageType targetPage, uint8_t retryCount)
 {
     QString targetPageName;
@@ -5948,29 +6648,49 @@ BOOL StarryCard::goToPage(PageType targetPage, uint8_t retryCount)
         targetPageName = "卡片制作";
     }
 
+    QElapsedTimer timer;
+    timer.start();
+    int clicks = 0;
     for(int i = 0; i < retryCount; i++)
     {
         QImage screenshot = captureWindowByHandle(hwndGame,"主页面");
-        QString position = recognizeCurrentPosition(screenshot);
 
-        if(position.contains(targetPageName))
-        {
-            qDebug() << QString("成功前往%1页面").arg(targetPageName);
-            return TRUE;
+        // 先处理弹窗
+        PopupCheckResult popupResult = checkPopups(screenshot);
+        if (popupResult == PopupCheckResult::Dismissed) {
+            continue;
         }
-        else if(position == "(94,260)卡片制作")
-        {
-            leftClickDPI(hwndGame, CARD_ENHANCE_POS.x(), CARD_ENHANCE_POS.y()); //点击卡片强化按钮
+        if (popupResult == PopupCheckResult::UnknownOverlay) {
+            qDebug() << QString("前往%1页面时画面被未知弹窗遮挡").arg(targetPageName);
         }
-        else if(position == "(94,326)卡片强化")
+
+        QString position = currentPageName(screenshot);
+        if(position == targetPageName)
         {
-            leftClickDPI(hwndGame, CARD_PRODUCE_POS.x(), CARD_PRODUCE_POS.y()); //点击卡片制作按钮
+            qDebug() << QString("成功前往%1页面，点击%2次，耗时%3ms").arg(targetPageName).arg(clicks).arg(timer.elapsed());
+            return TRUE;
         }
-        else if(position == "(675,556)合成屋外")
-        {
-            leftClickDPI(hwndGame, SYNTHESIS_HOUSE_POS.x(), SYNTHESIS_HOUSE_POS.y()); //点击合成屋按钮
+
+        QVector<int> route = pageRouter->plan(position, targetPageName);
+        if (route.isEmpty()) {
+            // 页面未识别（切换动画、遮挡）或没有通往目标的路线，等画面稳定后重新识别
+            waitForScreenSettle(QRect(), SettleOptions(1500, 3, 1.5, 15, 300));
+            continue;
+        }
+
+        // 切换页面后物品栏所在页未知，下次查找时先翻到顶部
+        cloverStripIndex.currentPage = -1;
+        spiceStripIndex.currentPage = -1;
+
+        // 沿路线逐步点击，某一步未到达规划时的页面就不再点击后续步骤，从实际所在页面重新规划
+        for (int hop : route) {
+            const QString expected = pageRouter->destination(hop);
+            clicks++;
+            SceneRouter::HopResult result = pageRouter->traverse(hop);
+            if (!result.arrived || result.scene != expected || result.scene == targetPageName) {
+                break;
+            }
         }
-        sleepByQElapsedTimer(300);
     }
     qDebug() << QString("前往%1页面失败").arg(targetPageName);
     return FALSE;
@@ -6999,6 +7719,71 @@ void StarryCard::addProductionRecord(const QString& spiceName, const QString& re
     //     .arg(recipeName), LogType::Info);
 }
 
+void StarryCard::loadEnhancementStatistics()
+{
+    g_enhancementStats.clear();
+
+    QFile file("enhancement_statistics.json");
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "强化统计文件不存在，创建新的统计记录";
+        return;
+    }
+    
+    QByteArray data = file.readAll();
+    file.close();
+    
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+        addLog("强化统计文件解析失败: " + error.errorString(), LogType::Error);
+        return;
+    }
+    
+    QJsonObject outcomeStatsObj = doc.object()["outcomeStats"].toObject();
+    for (auto it = outcomeStatsObj.begin(); it != outcomeStatsObj.end(); ++it) {
+        QJsonObject countObj = it.value().toObject();
+        EnhancementStatistics::OutcomeCount count;
+        count.success = countObj["success"].toInt();
+        count.failure = countObj["failure"].toInt();
+        g_enhancementStats.outcomeStats[it.key()] = count;
+    }
+    
+    addLog(QString("强化统计数据加载完成 - 材料组合: %1, 强化次数: %2")
+        .arg(g_enhancementStats.outcomeStats.size())
+        .arg(g_enhancementStats.getTotalAttempts()), LogType::Success);
+}
+
+void StarryCard::saveEnhancementStatistics()
+{
+    QJsonObject outcomeStatsObj;
+    for (auto it = g_enhancementStats.outcomeStats.begin(); it != g_enhancementStats.outcomeStats.end(); ++it) {
+        QJsonObject countObj;
+        countObj["success"] = it.value().success;
+        countObj["failure"] = it.value().failure;
+        outcomeStatsObj[it.key()] = countObj;
+    }
+    
+    QJsonObject root;
+    root["outcomeStats"] = outcomeStatsObj;
+    
+    QFile file("enhancement_statistics.json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        addLog("无法保存强化统计文件", LogType::Error);
+        return;
+    }
+    
+    file.write(QJsonDocument(root).toJson());
+    file.close();
+}
+
+void StarryCard::addEnhancementRecord(const QString& cardType, int fromLevel, const QVector<int>& subcardLevels,
+                                      const QString& clover, bool success)
+{
+    QString key = EnhancementStatistics::makeKey(cardType, fromLevel, subcardLevels, clover);
+    g_enhancementStats.addOutcome(key, success);
+}
+
 // ========== EnhancementWorker 类实现 ==========
 
 EnhancementWorker::EnhancementWorker(StarryCard* parent)
@@ -7006,16 +7791,24 @@ EnhancementWorker::EnhancementWorker(StarryCard* parent)
 {
 }
 
-void EnhancementWorker::startEnhancement()
+void EnhancementWorker::startEnhancement(std::shared_ptr<StopToken> token)
 {
-    if (!m_parent->hwndGame || !IsWindow(m_parent->hwndGame)) {
+    // 会话令牌由主线程创建后随启动信号传入，工作线程不读取主线程会替换的sessionStop
+    // 绑定到本线程后，线程内调用的StarryCard等待函数也都在这个令牌上等待
+    stopToken = token;
+    StopToken::Binding binding(token);
+    auto finished = qScopeGuard([token]() { token->markFinished(); });
+
+    if (!m_parent->hasGameWindow()) {
+        stopToken->requestStop();
         emit showWarningMessage("错误", "请先绑定有效的游戏窗口！");
         return;
     }
 
-    if (!m_parent->isEnhancing) {
+    if (isRunning()) {
         // 卡片类型已经在主线程中预加载到requiredCardTypes
         if (m_parent->requiredCardTypes.isEmpty()) {
+            stopToken->requestStop();
             emit showWarningMessage("警告", "配置文件中未找到有效的卡片类型配置！\n请先在卡片设置中配置主卡和副卡类型。");
             emit logMessage("强化流程启动失败：未找到有效的卡片类型配置", LogType::Error);
             return;
@@ -7031,19 +7824,18 @@ void EnhancementWorker::startEnhancement()
         QStringList cardTypesCopy = m_parent->requiredCardTypes;
         qDebug() << "强化流程准备就绪，将识别以下卡片类型:" << cardTypesCopy.join(", ");
 
-        m_parent->isEnhancing = true;
         emit logMessage("开始强化流程", LogType::Success);
 
         // 关闭健康提示
         m_parent->closeHealthTip(1);
 
-        while(!m_parent->goToPage(StarryCard::PageType::CardEnhance) && m_parent->isEnhancing)
+        while(!m_parent->goToPage(StarryCard::PageType::CardEnhance) && isRunning())
         {
             emit logMessage("未找到卡片强化页面，尝试刷新游戏窗口...", LogType::Warning);
             // 刷新游戏窗口
             if(!m_parent->refreshGameWindow())
             {
-                m_parent->isEnhancing = false;
+                stopToken->requestStop();
                 emit showWarningMessage("错误", "刷新游戏窗口失败，强化已停止！");
                 emit logMessage("刷新游戏窗口失败，强化已停止！", LogType::Error);
                 emit enhancementFinished();
@@ -7051,9 +7843,11 @@ void EnhancementWorker::startEnhancement()
             }
             // 关闭健康提示
             m_parent->closeHealthTip();
-            threadSafeSleep(1000);
+            m_parent->waitForScreenSettle(QRect(), SettleOptions(2000, 3));
         }
-        threadSafeSleep(1500); // 首次进入，等待游戏窗口加载
+        // 首次进入，等待游戏窗口加载
+        SettleResult loadResult = m_parent->waitForScreenSettle(QRect(), SettleOptions(3000, 5));
+        qDebug() << QString("游戏窗口加载稳定耗时：%1ms").arg(loadResult.settleMs);
         
         performEnhancement();
     }
@@ -7061,8 +7855,8 @@ void EnhancementWorker::startEnhancement()
 
 void EnhancementWorker::performEnhancement()
 {
-    if (!m_parent->hwndGame || !IsWindow(m_parent->hwndGame)) {
-        m_parent->isEnhancing = false;
+    if (!m_parent->hasGameWindow()) {
+        stopToken->requestStop();
         emit showWarningMessage("错误", "目标窗口已失效，强化已停止！");
         emit logMessage("目标窗口已失效，强化已停止！", LogType::Error);
         emit enhancementFinished();
@@ -7071,6 +7865,10 @@ void EnhancementWorker::performEnhancement()
 
     // 创建本地副本避免跨线程访问QStringList
     QStringList cardTypesCopy = m_parent->requiredCardTypes;
+    speculationCardTypes = cardTypesCopy;
+    speculativePlan = EnhancementPlan();
+    speculationCommitted = 0;
+    speculationDiscarded = 0;
     
     // 连续未找到可强化卡片的计数器
     int noEnhanceableCardsCount = 0;
@@ -7092,19 +7890,67 @@ void EnhancementWorker::performEnhancement()
 
     // 记录滚动条信息
     qDebug() << "滚动条长度:" << scrollBarLength << ", 单行滚动长度:" << singleLineScrollLength;
+    m_parent->backpackScroll->resetTrack();
 
-    while (m_parent->isEnhancing)
+    while (isRunning())
     {
+        // 上一次强化动画期间预选的材料仍在原位时直接强化，省去定位和识别
+        if (speculativePlan.valid) {
+            EnhancementPlan plan = speculativePlan;
+            speculativePlan = EnhancementPlan();
+            if (confirmSpeculativePlan(plan)) {
+                speculationCommitted++;
+                qDebug() << "预选材料仍然有效，直接强化";
+                if (executeEnhancementPlan(plan)) {
+                    hasPerformedEnhancement = true;
+                    noEnhanceableCardsCount = 0;
+                }
+                continue;
+            }
+            speculationDiscarded++;
+        }
+
         // 单卡强化时，将滚动条拖动到第一张低于最高等级的卡片位置
         if(cardTypesCopy.length() == 1)
         {
             int maxLevel = min(m_parent->maxEnhancementLevel, 9); // 10星及以上的卡片会沉底，所以最大等级为9
             qDebug() << "最高强化等级:" << maxLevel;
+
+            // 先用流水线翻页直接定位到目标行，下面的逐行翻页只做校准
+            bool located = scanBackpackPipelined(cardTypesCopy, maxLevel, scrollBarPosition,
+                                                 singlePageScrollLength, singleLineScrollLength, cardVector);
             int i = 0;
-            while (i < 8)
+            QVector<CardInfo> previousCards;
+            int previousPosition = -1;
+            while (located && i < 8)
             {
                 QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
-                cardVector = m_parent->cardRecognizer->recognizeCards(screenshot, cardTypesCopy);
+
+                // 强化和制卡会改变背包内容，滚动条长度变化后之前学到的行距和底端位置不再有效
+                int currentLength = m_parent->getLengthOfScrollBar(screenshot);
+                if (currentLength > 0 && currentLength != scrollBarLength) {
+                    qDebug() << "背包滚动条长度变化:" << scrollBarLength << "->" << currentLength;
+                    scrollBarLength = currentLength;
+                    singleLineScrollLength = static_cast<int>(scrollBarLength / 8.0 - 1);
+                    singlePageScrollLength = static_cast<int>(scrollBarLength * 7 / 8 + 2);
+                    m_parent->backpackScroll->resetTrack();
+                    previousCards.clear();
+                }
+                scrollBarPosition = m_parent->getPositionOfScrollBar(screenshot);
+
+                QElapsedTimer recognizeTimer;
+                recognizeTimer.start();
+                cardVector = m_parent->recognizeBackpackCards(screenshot, cardTypesCopy);
+                m_parent->sessionRecorder->recordRecognition("卡片识别", QString("%1张").arg(cardVector.size()),
+                                                             recognizeTimer.elapsed());
+
+                // 上一次翻页前后的识别结果比对出内容移动的行数，学习背包的行距
+                if (!previousCards.isEmpty() && scrollBarPosition > previousPosition) {
+                    int rows = backpackRowShift(previousCards, cardVector);
+                    if (rows > 0) {
+                        m_parent->backpackScroll->observeRowPitch(scrollBarPosition - previousPosition, rows);
+                    }
+                }
 
                 // 检查第一行(row=0)是否有符合条件的卡片（level < maxLevel）
                 bool firstRowHasValidCard = false;
@@ -7129,7 +7975,7 @@ void EnhancementWorker::performEnhancement()
                 i++;
                 if(i == 20)
                 {
-                    m_parent->isEnhancing = false;
+                    stopToken->requestStop();
                     qDebug() << "已达最大翻页次数，未找到目标卡片，强化已停止！";
                     break;
                 }
@@ -7141,41 +7987,45 @@ void EnhancementWorker::performEnhancement()
                     scrollDistance = singlePageScrollLength;
                     qDebug() << "未识别到任何目标卡片，快速翻页(整页)";
                 } else {
-                    // 识别到卡片但第一行不符合条件，慢速翻1行
-                    scrollDistance = singleLineScrollLength;
+                    // 识别到卡片但第一行不符合条件，慢速翻1行，学到行距后按行距翻
+                    double pitch = m_parent->backpackScroll->rowPitch();
+                    scrollDistance = pitch > 0 ? qRound(pitch) : singleLineScrollLength;
                     qDebug() << "第一行没有符合条件的卡片(<=" << (maxLevel - 1) << "星)，慢速翻页(1行)";
                 }
                 
-                m_parent->fastMouseDrag(910, 120 + scrollBarPosition, scrollDistance, true);
                 qDebug() << "向下滚动:" << scrollDistance << "像素";
-                
-                while (m_parent->getPositionOfScrollBar(screenshot) == scrollBarPosition)
+                previousCards = cardVector;
+                previousPosition = scrollBarPosition;
+                scrollBarPosition = m_parent->backpackScroll->scrollBy(scrollDistance, scrollBarPosition);
+                qDebug() << "翻页完成，滚动条位置:" << scrollBarPosition;
+                // 位置不变可能只是拖动没有响应，底端标志可见或控制器已确认底端才停止翻页
+                if (scrollBarPosition == previousPosition
+                    && (m_parent->backpackScroll->isAtTrackEnd(scrollBarPosition)
+                        || m_parent->checkSynHousePosState(m_parent->ENHANCE_SCROLL_BAR_BOTTOM, "enhanceScrollBottom")))
                 {
-                    threadSafeSleep(100);
-                    screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+                    qDebug() << "滚动条已到底部，停止翻页";
+                    break;
                 }
-                scrollBarPosition = m_parent->getPositionOfScrollBar(screenshot);
-                qDebug() << "翻页完成，滚动条位置:" << scrollBarPosition;
             }
         }
         else
         {
             qDebug() << "多卡强化，未实现";
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             break;
         }
         
         
         if (cardVector.empty())
         {
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             qDebug() << "未找到目标卡片，强化已停止！";
             break;
         }
         
 
         // 调用强化处理方法
-        if (!performEnhancementOnce(cardVector) && m_parent->isEnhancing)
+        if (!performEnhancementOnce(cardVector) && isRunning())
         {
             // 返回值为FALSE，且未停止强化，说明未找到可以强化的卡片
             noEnhanceableCardsCount++;
@@ -7185,7 +8035,7 @@ void EnhancementWorker::performEnhancement()
             if (noEnhanceableCardsCount >= 3) {
                 emit logMessage("连续三次未找到可强化卡片，强化流程结束", LogType::Error);
                 emit showWarningMessage("强化完成", "连续三次未找到可强化的卡片，强化流程已结束！");
-                m_parent->isEnhancing = false;
+                stopToken->requestStop();
                 emit enhancementFinished();
                 return;
             }
@@ -7194,32 +8044,158 @@ void EnhancementWorker::performEnhancement()
             qDebug() << "启动制卡流程";
             if(!performCardProduce(cardVector))
             {
-                m_parent->isEnhancing = false;
+                stopToken->requestStop();
                 // emit showWarningMessage("错误", "制卡失败，强化已停止！");
                 qDebug() << "制卡失败，强化已停止！";
                 return;
             }
+            // 新制的卡片放入背包，背包内容和滚动条长度都已变化
+            m_parent->backpackScroll->resetTrack();
             m_parent->goToPage(StarryCard::PageType::CardEnhance);
             threadSafeSleep(100);
-            // m_parent->isEnhancing = false;
+            // stopToken->requestStop();
+        }
+        else
+        {
+            // 找到可强化卡片，进行强化操作
+            hasPerformedEnhancement = true;
+            noEnhanceableCardsCount = 0;
+            qDebug() << "找到可强化卡片，进行强化操作，重置连续未找到计数器";
+        }
+    }
+
+    qDebug() << QString("预选材料：直接使用%1次，放弃%2次").arg(speculationCommitted).arg(speculationDiscarded);
+    stopToken->requestStop();
+    emit enhancementFinished();
+}
+
+BOOL EnhancementWorker::scanBackpackPipelined(const QStringList& cardTypes, int maxLevel, int& scrollBarPosition,
+                                              int singlePageScrollLength, int singleLineScrollLength,
+                                              QVector<CardInfo>& cardVector)
+{
+    // 流水线翻页：截图后立即拖动到下一页，该帧的识别在线程池中与滚动动画并行进行
+    // 一次只有一帧在识别，结果按页顺序处理；找到可强化卡片后再回退到该卡片所在行
+    auto waitForScrollBarMove = [this](int fromPosition) {
+        int position = fromPosition;
+        for (int i = 0; i < 100 && position == fromPosition && isRunning(); ++i) {
+            threadSafeSleep(20);
+            position = m_parent->getPositionOfScrollBar();
+        }
+        return position;
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+    int position = m_parent->getPositionOfScrollBar(screenshot);
+    const int maxPages = 20;
+    const auto recognize = m_parent->backpackCardRecognition(cardTypes);
+
+    for (int page = 0; page < maxPages && isRunning(); ++page) {
+        // 任务只读帧、写本页结果，返回识别耗时；识别记录在本线程wait()之后写入
+        auto pageCards = std::make_shared<QVector<CardInfo>>();
+        PendingFrameResult pending = m_parent->frameAnalyzer->submit(screenshot,
+            [recognize, pageCards](const QImage& frame) {
+                QElapsedTimer recognizeTimer;
+                recognizeTimer.start();
+                *pageCards = recognize(frame);
+                return QVariant(recognizeTimer.elapsed());
+            });
+
+        // 第一页通常就是目标页，不做预先翻页；之后每页识别的同时先翻到下一页
+        bool atBottom = m_parent->checkSynHousePosState(screenshot, m_parent->ENHANCE_SCROLL_BAR_BOTTOM, "enhanceScrollBottom");
+        bool speculative = (page > 0 && !atBottom);
+        if (speculative) {
+            m_parent->fastMouseDrag(910, 120 + position, singlePageScrollLength, true);
+        }
+
+        const qint64 recognizeMs = pending.wait().toLongLong();
+        cardVector = *pageCards;
+        m_parent->sessionRecorder->recordRecognition("卡片识别", QString("%1张").arg(cardVector.size()), recognizeMs);
+
+        // 本页中第一张低于最高等级的卡片所在行
+        int targetRow = -1;
+        for (const CardInfo& card : cardVector) {
+            if (card.level < maxLevel && (targetRow < 0 || card.row < targetRow)) {
+                targetRow = card.row;
+            }
+        }
+
+        if (targetRow >= 0) {
+            // 从识别所用帧的滚动条位置出发，闭环定位到目标行
+            int currentPosition = speculative ? waitForScrollBarMove(position) : position;
+            double pitch = m_parent->backpackScroll->rowPitch();
+            int targetPosition = position + (pitch > 0 ? qRound(targetRow * pitch) : targetRow * singleLineScrollLength);
+            scrollBarPosition = m_parent->backpackScroll->scrollTo(targetPosition, currentPosition);
+            qDebug() << QString("流水线翻页定位完成：第%1页第%2行，滚动条位置%3，耗时%4ms")
+                        .arg(page + 1).arg(targetRow + 1).arg(scrollBarPosition).arg(timer.elapsed());
+            return TRUE;
+        }
+
+        if (atBottom) {
+            break;
+        }
+        if (!speculative) {
+            m_parent->fastMouseDrag(910, 120 + position, singlePageScrollLength, true);
+        }
+        int nextPosition = waitForScrollBarMove(position);
+        if (nextPosition == position) {
+            qDebug() << "滚动条未移动，停止流水线翻页";
+            break;
+        }
+        position = nextPosition;
+        screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+    }
+
+    scrollBarPosition = position;
+    qDebug() << QString("流水线翻页未找到低于%1星的卡片，耗时%2ms").arg(maxLevel).arg(timer.elapsed());
+    return FALSE;
+}
+
+int EnhancementWorker::backpackRowShift(const QVector<CardInfo>& before, const QVector<CardInfo>& after)
+{
+    // 每行按列排列成一个签名，空行不参与比对
+    auto rowSignatures = [](const QVector<CardInfo>& cards) {
+        QMap<int, QStringList> rows;
+        for (const CardInfo& card : cards) {
+            rows[card.row].append(QString("%1:%2:%3:%4").arg(card.col).arg(card.name).arg(card.level).arg(card.isBound));
         }
-        else
-        {
-            // 找到可强化卡片，进行强化操作
-            hasPerformedEnhancement = true;
-            noEnhanceableCardsCount = 0;
-            qDebug() << "找到可强化卡片，进行强化操作，重置连续未找到计数器";
+        QMap<int, QString> signatures;
+        for (auto it = rows.begin(); it != rows.end(); ++it) {
+            it.value().sort();
+            signatures[it.key()] = it.value().join('|');
         }
+        return signatures;
+    };
+    const QMap<int, QString> beforeRows = rowSignatures(before);
+    const QMap<int, QString> afterRows = rowSignatures(after);
+    if (beforeRows.isEmpty() || afterRows.isEmpty()) {
+        return -1;
     }
 
-    m_parent->isEnhancing = false;
-    emit enhancementFinished();
+    // 找使两次结果中重叠的行全部一致的最小上移行数，重叠行都为空时无法判断
+    const int lastRow = qMax(beforeRows.lastKey(), afterRows.lastKey());
+    for (int shift = 1; shift <= lastRow; ++shift) {
+        int compared = 0;
+        bool consistent = true;
+        for (int row = shift; row <= lastRow && consistent; ++row) {
+            const QString previous = beforeRows.value(row);
+            const QString current = afterRows.value(row - shift);
+            if (previous.isEmpty() && current.isEmpty()) {
+                continue;
+            }
+            consistent = (previous == current);
+            compared++;
+        }
+        if (consistent && compared > 0) {
+            return shift;
+        }
+    }
+    return -1;
 }
 
-BOOL EnhancementWorker::performEnhancementOnce(const QVector<CardInfo>& cardVector)
+EnhancementWorker::EnhancementPlan EnhancementWorker::planEnhancement(const QVector<CardInfo>& cardVector) const
 {
-    qDebug() << "开始分析卡片强化配置";
-    
     // 从最高等级开始，遍历每个强化等级
     for (int level = m_parent->maxEnhancementLevel; level >= m_parent->minEnhancementLevel; --level) {
         // 检查是否有对应的配置
@@ -7327,136 +8303,293 @@ BOOL EnhancementWorker::performEnhancementOnce(const QVector<CardInfo>& cardVect
         
         if (hasEnoughCards) {
             qDebug() << "等级" << (level - 1) << "-" << level << "：卡片齐备，开始强化";
-            
-            // 3. 点击选中的卡片
-            // 首先点击主卡
-            m_parent->leftClickDPI(m_parent->hwndGame, mainCard.centerPosition.x(), mainCard.centerPosition.y());
-            // qDebug() << "点击主卡：(" << mainCard.centerPosition.x() << "," << mainCard.centerPosition.y() << ")";
-            
-            // 然后点击副卡
-            for (const auto& subcard : selectedSubcards) {
-                m_parent->leftClickDPI(m_parent->hwndGame, subcard.centerPosition.x(), subcard.centerPosition.y());
-                // qDebug() << "点击副卡：(" << subcard.centerPosition.x() << "," << subcard.centerPosition.y() << ")";
-            }
-            
-            // 点击卡片后，动态检查卡片是否加载完成
-            qDebug() << "等待并检查卡片加载状态...";
-            
-            bool cardCheckPassed = false;
-            int maxAttempts = 200;      // 最多尝试200次（2秒）
-            int checkInterval = 10;     // 每10ms检查一次
-            int totalWaitTime = 0;
-            
-            for (int attempt = 1; attempt <= maxAttempts && m_parent->isEnhancing; attempt++) {
-                threadSafeSleep(checkInterval);
-                totalWaitTime += checkInterval;
-                
-                // 调用检查函数
-                if (m_parent->checkCardSelectionBeforeEnhancement(mainCard, selectedSubcards)) {
-                    cardCheckPassed = true;
-                    qDebug() << "卡片加载完成（第" << attempt << "次检查，耗时" << totalWaitTime << "ms）";
-                    break;
-                }
-                
-                // 如果还在循环中，说明检查未通过，继续等待
-                if (attempt < maxAttempts) {
-                    qDebug() << QString("第%1次检查未通过，继续等待...").arg(attempt);
-                }
-            }
-            
-            // 检查最终结果
-            if (!cardCheckPassed) {
-                qDebug() << "卡片选择检查失败（已尝试" << maxAttempts << "次，总耗时" << totalWaitTime << "ms）";
-                m_parent->cancelAllCardSelections();
-                qDebug() << "卡片选择已取消";
-                m_parent->isEnhancing = false;
-                emit showWarningMessage("卡片选择错误", "检测到卡片选择错误，已取消所有选择。");
-                return FALSE;
-            }
-            qDebug() << "卡片选择状态检查通过，继续强化流程";
-            
-            // 4. 检查是否需要四叶草
-            if (levelConfig.clover != "无" && levelConfig.clover != "") {
-                qDebug() << "检查四叶草：" << levelConfig.clover;
-                
-                QPair<bool, bool> cloverResult = m_parent->recognizeClover(levelConfig.clover, 
-                                                                levelConfig.cloverBound, 
-                                                                levelConfig.cloverUnbound);
-                if (cloverResult.first) {
-                    qDebug() << "成功添加四叶草：" << levelConfig.clover << "(" << (cloverResult.second ? "绑定" : "未绑定") << ")";
-                } else {
-                    emit logMessage(QString("四叶草识别失败: %1四叶草已用完，强化流程终止").arg(levelConfig.clover), LogType::Error);
-                    emit showWarningMessage("四叶草已用完", QString("未找到四叶草 %1，可能已用完！强化流程已停止。").arg(levelConfig.clover));
-                    m_parent->isEnhancing = false;
-                    return FALSE;
-                }
-            }
-            
-            qDebug() << "等级" << (level - 1) << "-" << level << "的强化材料准备完成";
+            EnhancementPlan plan;
+            plan.valid = true;
+            plan.level = level;
+            plan.mainCard = mainCard;
+            plan.subcards = selectedSubcards;
+            return plan;
+        }
+    }
 
-            // 等待强化按钮就绪
-            for (int i = 0; i < 100 && m_parent->isEnhancing; i++)
-            {
-                QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+    return EnhancementPlan();
+}
 
-                if (m_parent->checkSynHousePosState(screenshot, m_parent->ENHANCE_BUTTON_POS, "enhanceButtonReady"))
-                {
-                    qDebug() << "强化按钮已就绪，点击强化按钮";
-                    m_parent->leftClickDPI(m_parent->hwndGame, 285, 435); // 点击强化按钮
-                    break;
-                }
-                else if(i == 99)
-                {
-                    m_parent->isEnhancing = false;
-                    emit showWarningMessage("错误", "强化按钮异常，强化已停止！");
-                    return FALSE;
-                }
-                threadSafeSleep(30);
-            }
+BOOL EnhancementWorker::performEnhancementOnce(const QVector<CardInfo>& cardVector)
+{
+    qDebug() << "开始分析卡片强化配置";
+    
+    EnhancementPlan plan = planEnhancement(cardVector);
+    if (!plan.valid) {
+        // 未找到可以强化的卡片，启动制卡流程
+        return FALSE;
+    }
+    return executeEnhancementPlan(plan);
+}
 
-            // 等待副卡位置为空
-            for (int i = 0; i < 100 && m_parent->isEnhancing; i++)
-            {
-                QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
-                if (m_parent->checkSynHousePosState(screenshot, m_parent->SUB_CARD_POS, "subCardEmpty"))
-                {
-                    // emit logMessage("副卡位置为空，强化完成，等待强化结果", LogType::Success);
-                    break;
-                }
-                else if(i == 99)
-                {
-                    m_parent->isEnhancing = false;
-                    emit showWarningMessage("错误", "副卡位置异常，强化已停止！");
-                    return FALSE;
-                }
-                threadSafeSleep(50);
-            }
+BOOL EnhancementWorker::executeEnhancementPlan(const EnhancementPlan& plan)
+{
+    const int level = plan.level;
+    const auto levelConfig = g_enhancementConfig.getLevelConfig(level - 1, level);
+    const CardInfo& mainCard = plan.mainCard;
+    const QVector<CardInfo>& selectedSubcards = plan.subcards;
+    
+    
+    // 3. 点击选中的卡片
+    // 首先点击主卡
+    m_parent->leftClickDPI(m_parent->hwndGame, mainCard.centerPosition.x(), mainCard.centerPosition.y());
+    // qDebug() << "点击主卡：(" << mainCard.centerPosition.x() << "," << mainCard.centerPosition.y() << ")";
+    
+    // 然后点击副卡
+    for (const auto& subcard : selectedSubcards) {
+        m_parent->leftClickDPI(m_parent->hwndGame, subcard.centerPosition.x(), subcard.centerPosition.y());
+        // qDebug() << "点击副卡：(" << subcard.centerPosition.x() << "," << subcard.centerPosition.y() << ")";
+    }
+    
+    // 点击卡片后，动态检查卡片是否加载完成
+    qDebug() << "等待并检查卡片加载状态...";
+    
+    bool cardCheckPassed = false;
+    int maxAttempts = 200;      // 最多尝试200次（2秒）
+    int checkInterval = 10;     // 每10ms检查一次
+    int totalWaitTime = 0;
+    
+    for (int attempt = 1; attempt <= maxAttempts && isRunning(); attempt++) {
+        threadSafeSleep(checkInterval);
+        totalWaitTime += checkInterval;
+        
+        // 调用检查函数
+        if (m_parent->checkCardSelectionBeforeEnhancement(mainCard, selectedSubcards)) {
+            cardCheckPassed = true;
+            qDebug() << "卡片加载完成（第" << attempt << "次检查，耗时" << totalWaitTime << "ms）";
+            break;
+        }
+        
+        // 如果还在循环中，说明检查未通过，继续等待
+        if (attempt < maxAttempts) {
+            qDebug() << QString("第%1次检查未通过，继续等待...").arg(attempt);
+        }
+    }
+    
+    // 检查最终结果
+    if (!cardCheckPassed) {
+        qDebug() << "卡片选择检查失败（已尝试" << maxAttempts << "次，总耗时" << totalWaitTime << "ms）";
+        m_parent->cancelAllCardSelections();
+        qDebug() << "卡片选择已取消";
+        stopToken->requestStop();
+        emit sessionAnomaly("卡片选择错误");
+        emit showWarningMessage("卡片选择错误", "检测到卡片选择错误，已取消所有选择。");
+        return FALSE;
+    }
+    qDebug() << "卡片选择状态检查通过，继续强化流程";
+    
+    // 4. 检查是否需要四叶草
+    if (levelConfig.clover != "无" && levelConfig.clover != "") {
+        qDebug() << "检查四叶草：" << levelConfig.clover;
+        
+        QPair<bool, bool> cloverResult = m_parent->recognizeClover(levelConfig.clover, 
+                                                        levelConfig.cloverBound, 
+                                                        levelConfig.cloverUnbound);
+        if (cloverResult.first) {
+            qDebug() << "成功添加四叶草：" << levelConfig.clover << "(" << (cloverResult.second ? "绑定" : "未绑定") << ")";
+            m_parent->cloverStripIndex.consume(levelConfig.clover, cloverResult.second, 1);
+        } else {
+            emit logMessage(QString("四叶草识别失败: %1四叶草已用完，强化流程终止").arg(levelConfig.clover), LogType::Error);
+            emit showWarningMessage("四叶草已用完", QString("未找到四叶草 %1，可能已用完！强化流程已停止。").arg(levelConfig.clover));
+            stopToken->requestStop();
+            return FALSE;
+        }
+    }
+    
+    qDebug() << "等级" << (level - 1) << "-" << level << "的强化材料准备完成";
 
-            // 强化完成后清空主卡位置
-            m_parent->leftClickDPI(m_parent->hwndGame, 288, 350); // 点击主卡位置卸下主卡
-            for (int i = 0; i < 100 && m_parent->isEnhancing; i++)
-            {
-                QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
-                if (m_parent->checkSynHousePosState(screenshot, m_parent->MAIN_CARD_POS, "mainCardEmpty"))
-                {
-                    // emit logMessage(QString("主卡位置为空，卸卡完成，%1-%2星强化完成").arg(level - 1).arg(level), LogType::Success);
-                    return TRUE;
-                }
-                else if(i == 99)
-                {
-                    m_parent->isEnhancing = false;
-                    emit showWarningMessage("错误", "主卡位置异常，强化已停止！");
-                    return FALSE;
-                }
-                threadSafeSleep(50);
+    // 等待强化按钮就绪
+    QString emptyStarHash;
+    for (int i = 0; i < 100 && isRunning(); i++)
+    {
+        QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+        if (!handlePopups(screenshot)) {
+            stopToken->requestStop();
+            emit sessionAnomaly("未知弹窗");
+            emit showWarningMessage("错误", "检测到未知弹窗遮挡，强化已停止！");
+            return FALSE;
+        }
+
+        if (m_parent->checkSynHousePosState(screenshot, m_parent->ENHANCE_BUTTON_POS, "enhanceButtonReady"))
+        {
+            qDebug() << "强化按钮已就绪，点击强化按钮";
+            // 0星主卡没有星级图标，记录强化前的星级区域作为该卡的0星模板
+            if (level - 1 == 0) {
+                emptyStarHash = m_parent->mainCardStarHash(screenshot);
             }
+            m_parent->leftClickDPI(m_parent->hwndGame, 285, 435); // 点击强化按钮
+            break;
+        }
+        else if(i == 99)
+        {
+            stopToken->requestStop();
+            emit sessionAnomaly("强化按钮异常");
+            emit showWarningMessage("错误", "强化按钮异常，强化已停止！");
+            return FALSE;
+        }
+        threadSafeSleep(30);
+    }
+
+    // 等待副卡位置为空
+    for (int i = 0; i < 100 && isRunning(); i++)
+    {
+        QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+        if (!handlePopups(screenshot)) {
+            stopToken->requestStop();
+            emit sessionAnomaly("未知弹窗");
+            emit showWarningMessage("错误", "检测到未知弹窗遮挡，强化已停止！");
+            return FALSE;
+        }
+        if (m_parent->checkSynHousePosState(screenshot, m_parent->SUB_CARD_POS, "subCardEmpty"))
+        {
+            // emit logMessage("副卡位置为空，强化完成，等待强化结果", LogType::Success);
+            break;
+        }
+        else if(i == 99)
+        {
+            stopToken->requestStop();
+            emit sessionAnomaly("副卡位置异常");
+            emit showWarningMessage("错误", "副卡位置异常，强化已停止！");
+            return FALSE;
+        }
+        threadSafeSleep(50);
+    }
+
+    // 副卡已消耗，主卡动画期间识别背包，与下面的结果识别和卸卡重叠
+    beginSpeculation();
+
+    // 识别强化结果并记录成功率统计
+    EnhanceOutcome outcome = m_parent->recognizeEnhancementOutcome(level - 1, emptyStarHash);
+    if (outcome != EnhanceOutcome::Unknown) {
+        QVector<int> subcardLevels;
+        for (const auto& subcard : selectedSubcards) {
+            subcardLevels.push_back(subcard.level);
+        }
+        QString cloverName = levelConfig.clover.isEmpty() ? "无" : levelConfig.clover;
+        bool success = (outcome == EnhanceOutcome::Success);
+        m_parent->addEnhancementRecord(mainCard.name, level - 1, subcardLevels, cloverName, success);
+
+        QString key = EnhancementStatistics::makeKey(mainCard.name, level - 1, subcardLevels, cloverName);
+        const auto& count = g_enhancementStats.outcomeStats[key];
+        QPair<double, double> interval = count.wilsonInterval();
+        emit logMessage(QString("%1-%2星强化%3，该组合成功率 %4% (95%区间 %5%-%6%，样本 %7)")
+            .arg(level - 1).arg(level).arg(success ? "成功" : "失败")
+            .arg(count.successRate() * 100, 0, 'f', 1)
+            .arg(interval.first * 100, 0, 'f', 1).arg(interval.second * 100, 0, 'f', 1)
+            .arg(count.total()), success ? LogType::Success : LogType::Warning);
+    }
+
+    // 强化完成后清空主卡位置
+    m_parent->leftClickDPI(m_parent->hwndGame, 288, 350); // 点击主卡位置卸下主卡
+    for (int i = 0; i < 100 && isRunning(); i++)
+    {
+        QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+        if (!handlePopups(screenshot)) {
+            stopToken->requestStop();
+            emit sessionAnomaly("未知弹窗");
+            emit showWarningMessage("错误", "检测到未知弹窗遮挡，强化已停止！");
+            discardSpeculation();
+            return FALSE;
+        }
+        if (m_parent->checkSynHousePosState(screenshot, m_parent->MAIN_CARD_POS, "mainCardEmpty"))
+        {
+            // emit logMessage(QString("主卡位置为空，卸卡完成，%1-%2星强化完成").arg(level - 1).arg(level), LogType::Success);
+            finishSpeculation(mainCard);
+            return TRUE;
         }
+        else if(i == 99)
+        {
+            stopToken->requestStop();
+            emit sessionAnomaly("主卡位置异常");
+            emit showWarningMessage("错误", "主卡位置异常，强化已停止！");
+            discardSpeculation();
+            return FALSE;
+        }
+        threadSafeSleep(50);
     }
 
-    // 未找到可以强化的卡片，启动制卡流程
+    // 会话已停止
+    discardSpeculation();
     return FALSE;
 }
 
+void EnhancementWorker::beginSpeculation()
+{
+    speculativePlan = EnhancementPlan();
+    m_parent->waitForScreenSettle(m_parent->BACKPACK_CARD_AREA, SettleOptions(300, 2));
+    speculativeFrame = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+
+    auto cards = std::make_shared<QVector<CardInfo>>();
+    speculativeCards = cards;
+    const auto recognize = m_parent->backpackCardRecognition(speculationCardTypes);
+    speculation = m_parent->frameAnalyzer->submit(speculativeFrame, [recognize, cards](const QImage& frame) {
+        QElapsedTimer recognizeTimer;
+        recognizeTimer.start();
+        *cards = recognize(frame);
+        return QVariant(recognizeTimer.elapsed());
+    });
+}
+
+void EnhancementWorker::discardSpeculation()
+{
+    if (speculation.isValid()) {
+        speculation.wait();
+        speculation = PendingFrameResult();
+    }
+    speculativeCards.reset();
+    speculativeFrame = QImage();
+    speculativePlan = EnhancementPlan();
+}
+
+void EnhancementWorker::finishSpeculation(const CardInfo& formerMainCard)
+{
+    if (!speculation.isValid()) {
+        return;
+    }
+    const qint64 recognizeMs = speculation.wait().toLongLong();
+    speculation = PendingFrameResult();
+    m_parent->sessionRecorder->recordRecognition("卡片识别", QString("%1张").arg(speculativeCards->size()), recognizeMs);
+
+    // 识别时主卡仍在强化位，它在背包中的格子星级即将变化，不参与预选
+    QVector<CardInfo> cards;
+    for (const CardInfo& card : *speculativeCards) {
+        if (card.centerPosition != formerMainCard.centerPosition) {
+            cards.push_back(card);
+        }
+    }
+    speculativePlan = planEnhancement(cards);
+    if (speculativePlan.valid) {
+        qDebug() << QString("已预选下一次强化材料：%1-%2星，主卡(%3,%4)")
+                    .arg(speculativePlan.level - 1).arg(speculativePlan.level)
+                    .arg(speculativePlan.mainCard.row).arg(speculativePlan.mainCard.col);
+    }
+}
+
+bool EnhancementWorker::confirmSpeculativePlan(const EnhancementPlan& plan)
+{
+    // 卸下的主卡回到背包后可能引起重排，所有材料格子与预选时的画面一致才说明点击位置仍然有效
+    const double CELL_DIFF_THRESHOLD = 3.0;
+    QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+    QVector<CardInfo> cards = plan.subcards;
+    cards.prepend(plan.mainCard);
+    for (const CardInfo& card : cards) {
+        QRect cell(card.centerPosition - QPoint(m_parent->BACKPACK_CARD_SIZE.width() / 2,
+                                                m_parent->BACKPACK_CARD_SIZE.height() / 2),
+                   m_parent->BACKPACK_CARD_SIZE);
+        double difference = SettleDetector::regionDifference(speculativeFrame, screenshot, cell);
+        if (difference > CELL_DIFF_THRESHOLD) {
+            qDebug() << QString("预选材料格子(%1,%2)已变化，差异%3").arg(card.row).arg(card.col).arg(difference, 0, 'f', 2);
+            return false;
+        }
+    }
+    return true;
+}
+
 BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
 {
     emit logMessage("开始制卡流程", LogType::Info);
@@ -7519,6 +8652,9 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
     
     // 1.2 记录已用完的香料（初始为空）
     QSet<QString> exhaustedSpices;
+    // 预检时识别到的香料数量（-1表示未能识别），用于按实际库存确定制卡数量
+    const int SPICE_PER_CARD = 5;
+    QMap<QString, int> spiceQuantities;
     
     // 1.3 获取所有已启用的香料
     QStringList availableSpices = g_spiceConfig.getUsedSpiceNames();
@@ -7531,19 +8667,15 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         emit logMessage("无法进入制卡页面，制卡流程终止", LogType::Error);
         return FALSE;
     }
-    threadSafeSleep(150);
+    m_parent->waitForScreenSettle(m_parent->ITEM_STRIP_AREA, SettleOptions(500, 2));
     
-    // 翻页到顶部
-    for (int attempt = 0; attempt < 20; ++attempt) {
-        if (m_parent->isPageAtTop()) {
-            qDebug() << "翻页到顶部成功";
-            break;
-        }
-        m_parent->leftClickDPI(m_parent->hwndGame, 532, 539);
-        threadSafeSleep(100);
+    // 一次翻页建立香料物品栏索引，之后逐个香料直接查表（不点击，但要检查绑定状态）
+    if (!m_parent->spiceStripIndex.isBuilt() &&
+        !m_parent->buildStripIndex(m_parent->spiceStripIndex, m_parent->spiceSlotClassifier())) {
+        qDebug() << "香料物品栏索引建立失败，所有需要的香料按缺失处理";
     }
     
-    // 遍历所有需要的香料，逐个检查是否存在（不点击，但要检查绑定状态）
+    bool spiceIndexRebuilt = false;
     for (const QString& spiceName : allRequiredSpices) {
         qDebug() << "预检香料:" << spiceName;
         
@@ -7557,68 +8689,27 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         bool spice_unbound = !spiceItem->bound;
         qDebug() << "预检香料绑定要求: 绑定=" << (spice_bound ? "是" : "否") << ", 不绑=" << (spice_unbound ? "是" : "否");
         
-        bool found = false;
-        
-        // 从顶部开始翻页查找
-        for (int pageIndex = 0; pageIndex < 30; ++pageIndex) {
-            QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "预检香料");
-            if (screenshot.isNull()) {
-                continue;
-            }
-            
-            // 检查当前页面的10个香料位置
-            for (int i = 0; i < 10; ++i) {
-                int x_offset = 33 + i * 49;
-                QRect spiceRect(x_offset, 526, 49, 49);
-                QImage spiceImage = screenshot.copy(spiceRect);
-                
-                if (spiceImage.isNull()) {
-                    continue;
-                }
-                
-                // 检查香料类型是否匹配
-                if (m_parent->spiceTemplateHashes[spiceName] != m_parent->calculateImageHash(spiceImage, m_parent->spiceTemplateRoi)) {
-                    continue;
-                }
-                
-                // 检查绑定状态是否匹配
-                bool actualBindState = false;
-                if (!m_parent->checkSpiceBindState(spiceImage, spice_bound, spice_unbound, actualBindState)) {
-                    continue;  // 绑定状态不匹配，继续查找
-                }
-                
-                // 找到了匹配的香料（类型和绑定状态都符合）
-                qDebug() << "预检找到香料:" << spiceName << "(绑定=" << (actualBindState ? "是" : "否") << ")";
-                found = true;
-                break;
-            }
-            
-            if (found) {
-                break;
-            }
-            
-            // 翻页
-            m_parent->leftClickDPI(m_parent->hwndGame, 535, 563);
-            threadSafeSleep(200);
-            
-            // 检查是否到底部
-            if (m_parent->isPageAtBottom()) {
-                break;
+        const StripSlotEntry* entry = m_parent->spiceStripIndex.find(spiceName, spice_bound, spice_unbound);
+        if (!entry && !spiceIndexRebuilt) {
+            // 与recognizeSpice一致：索引建立后物品可能有增减，或个别格子识别失败，重建一次索引再判定
+            qDebug() << "香料物品栏索引中没有" << spiceName << "，重新建立索引";
+            spiceIndexRebuilt = true;
+            m_parent->spiceStripIndex.invalidate();
+            if (m_parent->buildStripIndex(m_parent->spiceStripIndex, m_parent->spiceSlotClassifier())) {
+                entry = m_parent->spiceStripIndex.find(spiceName, spice_bound, spice_unbound);
             }
         }
-        
-        if (!found) {
+        if (!entry) {
             exhaustedSpices.insert(spiceName);
             qDebug() << "预检未找到符合绑定要求的香料:" << spiceName;
+            continue;
         }
         
-        // 返回顶部准备检查下一个香料
-        for (int attempt = 0; attempt < 20; ++attempt) {
-            if (m_parent->isPageAtTop()) {
-                break;
-            }
-            m_parent->leftClickDPI(m_parent->hwndGame, 532, 539);
-            threadSafeSleep(100);
+        spiceQuantities[spiceName] = entry->quantity;
+        qDebug() << "预检找到香料:" << spiceName << "(绑定=" << (entry->bound ? "是" : "否") << ", 数量=" << entry->quantity << ")";
+        if (entry->quantity >= 0 && entry->quantity < SPICE_PER_CARD) {
+            exhaustedSpices.insert(spiceName);
+            qDebug() << "预检香料数量不足" << SPICE_PER_CARD << "个:" << spiceName;
         }
     }
     
@@ -7630,7 +8721,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         if (availableSpices.size() == 1) {
             emit logMessage(QString("仅启用一种香料且缺失，制卡流程终止"), LogType::Error);
             emit showWarningMessage("香料缺失", QString("香料 %1 不存在或已用完！制卡流程已停止。").arg(exhaustedSpices.values().join(", ")));
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -7646,7 +8737,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         if (allExhausted) {
             emit logMessage(QString("所有已启用的香料均缺失，制卡流程终止"), LogType::Error);
             emit showWarningMessage("香料缺失", QString("所有已启用的香料均不存在或已用完！制卡流程已停止。\n缺失的香料: %1").arg(exhaustedSpices.values().join(", ")));
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -7754,7 +8845,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
                 .arg(m_parent->maxEnhancementLevel)
                 .arg(unobtainableLevelsInRange.join("、")));
             
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -7783,6 +8874,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         // 特殊处理：0星卡片不使用香料
         bool useSpice = (targetLevel >= 1 && targetLevel <= 9);
         GlobalSpiceConfig::SpiceItem* spiceItem = nullptr;
+        bool selectedSpiceBound = false;
         
         if (useSpice) {
             // 检查该等级对应的香料是否启用
@@ -7833,6 +8925,20 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
             continue;
         }
         
+        // 已识别到香料数量时，按实际库存确定制作数量，避免制作中途才发现香料不足
+        if (useSpice && spiceItem && spiceQuantities.value(spiceItem->name, -1) >= 0) {
+            int affordableCount = spiceQuantities[spiceItem->name] / SPICE_PER_CARD;
+            if (affordableCount < needProduceCount) {
+                qDebug() << spiceItem->name << "剩余" << spiceQuantities[spiceItem->name] << "个，最多制作" << affordableCount << "张";
+                needProduceCount = affordableCount;
+            }
+            if (needProduceCount <= 0) {
+                exhaustedSpices.insert(spiceItem->name);
+                qDebug() << spiceItem->name << "数量不足，跳过该制卡需求";
+                continue;
+            }
+        }
+        
         qDebug() << "需要制作" << cardType << targetLevel << "星卡片:" << needProduceCount << "张";
         
         // 以g_spiceConfig中的绑定状态为主来确定制作参数
@@ -7890,7 +8996,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         if (!m_parent->performRecipeRecognitionAndClick(cardType)) {
             emit logMessage(QString("配方识别失败: %1配方已用完，制卡流程终止").arg(cardType), LogType::Error);
             emit showWarningMessage("配方已用完", QString("未找到配方 %1，可能已用完！制卡流程已停止。").arg(cardType));
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -7918,8 +9024,9 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
                 continue;  // 跳过当前制卡需求，继续尝试其他香料
             }
 
+            selectedSpiceBound = spiceResult.second;
             qDebug() << "香料识别成功:" << spiceItem->name;
-            threadSafeSleep(500);
+            m_parent->waitForScreenSettle(m_parent->SPICE_AREA_HOUSE, SettleOptions(800, 3, 1.5, 15, 200));
         }
         else
         {
@@ -7932,13 +9039,13 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
             m_parent->leftClickDPI(m_parent->hwndGame, spiceClickX, spiceClickY);
             
             qDebug() << "已点击香料区域取消香料: (" << spiceClickX << "," << spiceClickY << ")";
-            threadSafeSleep(300);
+            m_parent->waitForScreenSettle(m_parent->SPICE_AREA_HOUSE, SettleOptions(600, 3, 1.5, 15, 200));
         }
 
         // 循环制作卡片
         int successCount = 0;
         for (int i = 0; i < needProduceCount; ++i) {
-            if (m_parent->isEnhancing == false)
+            if (!isRunning())
             {
                 qDebug() << "强化已停止，制卡流程终止";
                 return FALSE;
@@ -7997,6 +9104,14 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         
         qDebug() << cardType << targetLevel << "星卡片制作完成: 成功" << successCount << "张，失败" << (needProduceCount - successCount) << "张";
         
+        // 扣除本次消耗的香料数量
+        if (useSpice && spiceItem && spiceQuantities.value(spiceItem->name, -1) >= 0) {
+            spiceQuantities[spiceItem->name] = qMax(0, spiceQuantities[spiceItem->name] - successCount * SPICE_PER_CARD);
+        }
+        if (useSpice && spiceItem && successCount > 0) {
+            m_parent->spiceStripIndex.consume(spiceItem->name, selectedSpiceBound, successCount * SPICE_PER_CARD);
+        }
+        
         // 完成当前类型卡片制作后的等待时间
         if (&produceItem != &g_cardProduceConfig.produceItems.last()) {
             threadSafeSleep(100);
@@ -8012,7 +9127,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         if (availableSpices.size() == 1) {
             emit logMessage(QString("仅启用一种香料且已用完，制卡流程终止"), LogType::Error);
             emit showWarningMessage("香料已用完", QString("香料 %1 已用完！制卡流程已停止。").arg(exhaustedSpices.values().join(", ")));
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -8028,7 +9143,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
         if (allExhausted) {
             emit logMessage(QString("所有已启用的香料均已用完，制卡流程终止"), LogType::Error);
             emit showWarningMessage("香料已用完", QString("所有已启用的香料均已用完！制卡流程已停止。\n已用完的香料: %1").arg(exhaustedSpices.values().join(", ")));
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -8125,7 +9240,7 @@ BOOL EnhancementWorker::performCardProduce(const QVector<CardInfo> &cardVector)
                 .arg(m_parent->maxEnhancementLevel)
                 .arg(unobtainableLevelsInRange.join("、")));
             
-            m_parent->isEnhancing = false;
+            stopToken->requestStop();
             return FALSE;
         }
         
@@ -8148,32 +9263,8 @@ bool EnhancementWorker::checkBackpackFull()
         return false;
     }
     
-    // 提取(270,356)位置的20*20区域
-    QRect recipeSlotRect(270, 356, 20, 20);
-    QImage recipeSlotImage = screenshot.copy(recipeSlotRect);
-    
-    if (recipeSlotImage.isNull()) {
-        qDebug() << "提取背包检测区域失败";
-        return false;
-    }
-    
-    // 加载配方槽模板
-    QString recipeSlotPath = ":/images/position/(270,356)配方槽.png";
-    QImage recipeSlotTemplate(recipeSlotPath);
-    
-    if (recipeSlotTemplate.isNull()) {
-        qDebug() << "无法加载配方槽模板，路径:" << recipeSlotPath;
-        return false;
-    }
-    
-    // 计算哈希值并对比
-    QString templateHash = m_parent->calculateImageHash(recipeSlotTemplate, QRect(0, 0, 20, 20));
-    QString currentHash = m_parent->calculateImageHash(recipeSlotImage, QRect(0, 0, 20, 20));
-    
-    qDebug() << "模板哈希:" << templateHash;
-    qDebug() << "当前哈希:" << currentHash;
-    
-    bool isFull = (templateHash == currentHash);
+    // 对比(270,356)位置的20*20区域与缓存的配方槽模板哈希
+    bool isFull = m_parent->checkSynHousePosState(screenshot, m_parent->RECIPE_SLOT_EMPTY_POS, "recipeSlotEmpty");
     
     if (isFull) {
         qDebug() << "检测到背包已满（配方槽图案出现在(270,356)）";
@@ -8191,26 +9282,57 @@ BOOL EnhancementWorker::performCardProduceOnce()
     while(waitTime < 100)
     {
         screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "主页面");
+
+        // 制卡按钮未就绪时可能被弹窗挡住
+        PopupCheckResult popupResult = m_parent->checkPopups(screenshot);
+        if (popupResult == PopupCheckResult::Blocking) {
+            emit logMessage("检测到需要中断流程的弹窗，停止制卡", LogType::Warning);
+            return FALSE;
+        }
+        if (popupResult == PopupCheckResult::UnknownOverlay) {
+            emit logMessage("检测到未知弹窗遮挡游戏画面，流程中断", LogType::Warning);
+            return FALSE;
+        }
+
         if(m_parent->checkSynHousePosState(screenshot, m_parent->PRODUCE_READY_POS, "produceReady"))
         {
             m_parent->leftClickDPI(m_parent->hwndGame, 287, 427); // 点击制卡按钮
             
-            // 等待100ms后开始检测制卡状态，最多等待0.5秒
-            QThread::msleep(100);  // 识别前加100ms延迟
+            // 最多等待0.15秒制卡区域开始变化，变化后再等它稳定，合计不超过0.5秒
+            m_parent->waitForScreenSettle(m_parent->PRODUCE_READY_POS, SettleOptions(500, 1, 1.5, 10, 150));
+            // 每帧同时检测制卡中和配方槽空两个状态，结果在本线程记录
+            const QVector<FrameJob> produceJobs = {
+                [this](const QImage& frame) -> QVariant {
+                    return m_parent->matchPosTemplate(frame, m_parent->PRODUCE_READY_POS, "producing");
+                },
+                [this](const QImage& frame) -> QVariant {
+                    return m_parent->matchPosTemplate(frame, m_parent->RECIPE_SLOT_EMPTY_POS, "recipeSlotEmpty");
+                },
+            };
+            bool checkedSlot = false;
+            bool slotEmpty = false;
             QElapsedTimer timer;
             timer.start();
             while (timer.elapsed() < 500) {
                 QImage screenshot = m_parent->captureWindowByHandle(m_parent->hwndGame, "检测制卡状态");
-                if (m_parent->checkSynHousePosState(screenshot, m_parent->PRODUCE_READY_POS, "producing")) {
-                    // 识别到producing状态，背包未满
-                    qDebug() << "检测到制卡进行中，背包未满";
-                    return TRUE;
+                if (!screenshot.isNull()) {
+                    const QVector<QVariant> states = m_parent->frameAnalyzer->run(screenshot, produceJobs);
+                    const bool producing = states[0].toBool();
+                    checkedSlot = true;
+                    slotEmpty = states[1].toBool();
+                    m_parent->sessionRecorder->recordRecognition("producing", producing ? "1" : "0", 0);
+                    m_parent->sessionRecorder->recordRecognition("recipeSlotEmpty", slotEmpty ? "1" : "0", 0);
+                    if (producing) {
+                        // 识别到producing状态，背包未满
+                        qDebug() << "检测到制卡进行中，背包未满";
+                        return TRUE;
+                    }
                 }
-                QThread::msleep(50);
+                threadSafeSleep(50);
             }
             
-            // 0.5秒内没识别到producing，检测背包是否满
-            if (checkBackpackFull()) {
+            // 0.5秒内没识别到producing，用最后一帧的配方槽状态判断背包是否满，一帧都没截到时重新检测
+            if (checkedSlot ? slotEmpty : checkBackpackFull()) {
                 qDebug() << "检测到背包已满，停止制卡";
                 return 3;  // 返回特殊值表示背包满
             }
@@ -8338,57 +9460,48 @@ void EnhancementWorker::getCardNeedProduce()
     }
 }
 
+bool EnhancementWorker::handlePopups(const QImage& screenshot)
+{
+    PopupCheckResult result = m_parent->checkPopups(screenshot);
+    if (result == PopupCheckResult::Dismissed) {
+        emit logMessage("检测到弹窗，已自动关闭", LogType::Info);
+    } else if (result == PopupCheckResult::UnknownOverlay) {
+        emit logMessage("检测到未知弹窗遮挡游戏画面，流程中断", LogType::Warning);
+        return false;
+    }
+    return true;
+}
+
 void EnhancementWorker::threadSafeSleep(int ms)
 {
-    QThread::msleep(ms);
+    stopToken->sleepFor(ms);
 }
 
 // ==================== 滚动条拖动相关 ====================
 
 void StarryCard::fastMouseDrag(int startX, int startY, int distance, bool downward)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         qDebug() << "无效的窗口句柄，无法执行快速鼠标拖动";
         return;
     }
 
-    // 获取DPI
-    int DPI = getDPIFromDC();
-
-    double scaleFactor = static_cast<double>(DPI) / 96.0;
-    
-    // 计算结束坐标（仅垂直移动）
-    int endX = startX;
-    int endY = downward ? (startY + distance) : (startY - distance);
-    
-    // 计算DPI缩放后的坐标
-    POINT startPoint = {static_cast<int>(startX * scaleFactor), static_cast<int>(startY * scaleFactor)};
-    POINT endPoint = {static_cast<int>(endX * scaleFactor), static_cast<int>(endY * scaleFactor)};
+    sessionRecorder->recordDrag(startX, startY, distance, downward);
+    captureGovernor->notifyInput();
     
-    // 构造LPARAM参数
-    LPARAM startLParam = MAKELPARAM(startPoint.x, startPoint.y);
-    LPARAM endLParam = MAKELPARAM(endPoint.x, endPoint.y);
-    
-    // 快速拖动：最少步骤完成拖动
-    // 步骤1: 鼠标按下
-    PostMessage(hwndGame, WM_LBUTTONDOWN, MK_LBUTTON, startLParam);
-    
-    // 步骤2: 移动到目标位置
-    PostMessage(hwndGame, WM_MOUSEMOVE, MK_LBUTTON, endLParam);
-    
-    // 步骤3: 鼠标释放
-    PostMessage(hwndGame, WM_LBUTTONUP, 0, endLParam);
+    // 快速拖动：按下、移动到目标位置、释放，坐标由输入端按DPI缩放
+    gameInputSink()->drag(QPoint(startX, startY), distance, downward);
 }
 
 // 重置滚动条到顶端
 BOOL StarryCard::resetScrollBar()
 {
-    leftClickDPI(hwndGame, 910, 112);
+    leftClickIdempotent(910, 112);
     int i = 0;
     QRect scrollTopRoi = QRect(902, 98, 16, 16);
     while(i < 100)
     {
-        if(checkSynHousePosState(captureWindowByHandle(hwndGame, "主页面"), scrollTopRoi, "enhanceScrollTop"))
+        if(checkSynHousePosState(scrollTopRoi, "enhanceScrollTop"))
         {
             return TRUE;
         }
@@ -8401,12 +9514,12 @@ BOOL StarryCard::resetScrollBar()
 // 重置配方滚动条到顶端（专用于配方识别）
 BOOL StarryCard::resetRecipeScrollBar()
 {
-    leftClickDPI(hwndGame, 910, 112);
+    leftClickIdempotent(910, 112);
     int i = 0;
     QRect scrollTopRoi = QRect(902, 98, 16, 16);
     while(i < 100)
     {
-        if(checkSynHousePosState(captureWindowByHandle(hwndGame, "主页面"), scrollTopRoi, "enhanceScrollTop"))
+        if(checkSynHousePosState(scrollTopRoi, "enhanceScrollTop"))
         {
             qDebug() << "配方滚动条已重置到顶部";
             return TRUE;
@@ -8435,28 +9548,13 @@ int StarryCard::getRecipeScrollDistance(int scrollBarLength)
     return scrollDistance;
 }
 
-// 配方专属滚动方法：严格翻页，确保不漏配方
-void StarryCard::fastMouseDragForRecipe(int scrollBarPosition, int scrollBarLength, bool downward)
+// 配方翻页：学到行距后每页滚动可见行数减一行，保留一行重叠；否则退回半个滚动条长度
+int StarryCard::scrollRecipePage(int scrollBarLength, int scrollBarPosition)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
-        qDebug() << "无效的窗口句柄，无法执行配方滚动";
-        return;
+    if (recipeScroll->rowPitch() > 0) {
+        return recipeScroll->scrollRows(RecipeRecognizer::RECIPE_SCROLL_ROWS - 1, scrollBarPosition);
     }
-
-    // 获取配方精确滚动距离（基于滚动条长度）
-    int scrollDistance = getRecipeScrollDistance(scrollBarLength);
-    
-    // 使用固定的滚动起始位置和距离
-    int startX = RecipeRecognizer::RECIPE_SCROLL_X;
-    int startY = RecipeRecognizer::RECIPE_SCROLL_START_Y + scrollBarPosition;
-    
-    qDebug() << QString("配方滚动: 起始位置(%1,%2), 滚动条长度=%3, 滚动距离=%4, 方向=%5")
-                .arg(startX).arg(startY).arg(scrollBarLength).arg(scrollDistance).arg(downward ? "向下" : "向上");
-    
-    // 调用基础滚动方法
-    fastMouseDrag(startX, startY, scrollDistance, downward);
-    
-    qDebug() << QString("执行配方翻页: 滚动条移动%1像素 (1/2长度)").arg(scrollDistance);
+    return recipeScroll->scrollBy(getRecipeScrollDistance(scrollBarLength), scrollBarPosition);
 }
 
 // 获取滚动条长度
@@ -8467,20 +9565,7 @@ int StarryCard::getLengthOfScrollBar(QImage screenshot)
         qDebug() << "截图尺寸异常，无法获取滚动条长度";
         return 0;
     }
-
-    // 目标颜色 #0A486F (RGB: 10, 72, 111)
-    QColor targetColor(10, 72, 111);
-    int targetRgb = targetColor.rgb();
-
-    for(int i = 0; i < 450; i++)
-    {
-        QColor pixelColor = screenshot.pixelColor(903, 108 + i);
-        if(pixelColor.rgb() == targetRgb)
-        {
-            return i;
-        }
-    }
-    return 0;
+    return scanScrollBarColumn(screenshot, SCROLL_BAR_COLUMN.topLeft(), true);
 }
 
 int StarryCard::getPositionOfScrollBar(QImage screenshot)
@@ -8490,15 +9575,31 @@ int StarryCard::getPositionOfScrollBar(QImage screenshot)
         qDebug() << "截图尺寸异常，无法获取滚动条长度";
         return 0;
     }
+    return scanScrollBarColumn(screenshot, SCROLL_BAR_COLUMN.topLeft(), false);
+}
+
+int StarryCard::getPositionOfScrollBar()
+{
+    RegionFrame column = captureGameRegions({SCROLL_BAR_COLUMN});
+    if (column.isNull())
+    {
+        qDebug() << "滚动条区域截图失败，无法获取滚动条位置";
+        return 0;
+    }
+    return scanScrollBarColumn(column.image(0), QPoint(0, 0), false);
+}
 
+// 从top开始沿滚动条列向下扫描，stopAtBarColor为true时返回第一个滚动条颜色像素的偏移，否则返回第一个非滚动条颜色像素的偏移
+int StarryCard::scanScrollBarColumn(const QImage& image, const QPoint& top, bool stopAtBarColor)
+{
     // 目标颜色 #0A486F (RGB: 10, 72, 111)
     QColor targetColor(10, 72, 111);
     int targetRgb = targetColor.rgb();
 
-    for(int i = 0; i < 450; i++)
+    for(int i = 0; i < SCROLL_BAR_COLUMN.height(); i++)
     {
-        QColor pixelColor = screenshot.pixelColor(903, 108 + i);
-        if(pixelColor.rgb() != targetRgb)
+        QColor pixelColor = image.pixelColor(top.x(), top.y() + i);
+        if((pixelColor.rgb() == targetRgb) == stopAtBarColor)
         {
             return i;
         }
@@ -8560,7 +9661,7 @@ QStringList StarryCard::getSelectedSpices()
 
 bool StarryCard::recognizeMakeButton()
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法识别制作按钮", LogType::Error);
         return false;
     }
@@ -8613,7 +9714,7 @@ bool StarryCard::recognizeMakeButton()
 
 bool StarryCard::verifyRecipeTemplate(const QString& targetRecipe)
 {
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，无法验证配方模板", LogType::Error);
         return false;
     }
@@ -8680,7 +9781,7 @@ void StarryCard::performCardMaking()
     addLog("开始执行制卡流程", LogType::Info);
     
     // 步骤1: 检查游戏窗口
-    if (!hwndGame || !IsWindow(hwndGame)) {
+    if (!hasGameWindow()) {
         addLog("游戏窗口无效，制卡流程终止", LogType::Error);
         return;
     }
@@ -38,11 +38,34 @@
 #include <QPair>
 #include <QMutex>
 #include <QWaitCondition>
+#include <QEventLoop>
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <cmath>
 #include "../ui/custombutton.h"
 #include "utils.h"
+#include "settledetector.h"
+#include "popupregistry.h"
+#include "stripinventory.h"
+#include "sceneclassifier.h"
+#include "frameanalyzer.h"
+#include "framesource.h"
+#include "capturegovernor.h"
+#include "stoptoken.h"
+#include "clickverifier.h"
+#include "gdiframesource.h"
+#include "inputsink.h"
+#include "asynccapturesource.h"
+#include "orderednavigator.h"
+#include "scrollcontroller.h"
+#include "scenerouter.h"
+#include "sessionrecorder.h"
+#include "framearchive.h"
+#include "recognitionhost.h"
 #include "../recognition/cardrecognizer.h"
 #include "../recognition/reciperecognizer.h"
+#include "../recognition/digitrecognizer.h"
 #include <windows.h>
 #include <winuser.h>
 
@@ -71,21 +94,55 @@ public:
     void setParent(StarryCard* parent) { m_parent = parent; }
 
 public slots:
-    void startEnhancement();
+    // stopToken为本次会话的停止令牌，会话期间工作线程只通过它检查和等待停止
+    void startEnhancement(std::shared_ptr<StopToken> token);
 
 signals:
     void logMessage(const QString& message, LogType type);
     void showWarningMessage(const QString& title, const QString& message);
+    // 识别结果与画面不符导致流程中止，界面线程据此导出会话录制；正常结束和资源用完不发出
+    void sessionAnomaly(const QString& reason);
     void enhancementFinished();
     void stopEnhancementRequested();
 
 private:
     StarryCard* m_parent;
+    std::shared_ptr<StopToken> stopToken; // 本次会话的停止令牌，只在工作线程中读写
+    bool isRunning() const { return stopToken && !stopToken->stopRequested(); }
     void performEnhancement();
+    BOOL scanBackpackPipelined(const QStringList& cardTypes, int maxLevel, int& scrollBarPosition,
+                               int singlePageScrollLength, int singleLineScrollLength,
+                               QVector<CardInfo>& cardVector); // 边滚动边识别，定位第一张可强化卡片
     BOOL performEnhancementOnce(const QVector<CardInfo>& cardVector);
+    // 翻页前后两次识别结果中背包内容上移的行数，按整行卡片排列比对，无法确定时返回-1
+    static int backpackRowShift(const QVector<CardInfo>& before, const QVector<CardInfo>& after);
+
+    // 一次强化选用的材料：按强化配置从识别结果中选出的主卡和副卡
+    struct EnhancementPlan {
+        bool valid = false;
+        int level = 0;              // 强化目标星级
+        CardInfo mainCard;
+        QVector<CardInfo> subcards;
+    };
+    EnhancementPlan planEnhancement(const QVector<CardInfo>& cardVector) const;
+    BOOL executeEnhancementPlan(const EnhancementPlan& plan);
+
+    // 强化动画期间识别背包并预选下一次强化的材料，动画结束后确认格子未变化再使用
+    void beginSpeculation();
+    void finishSpeculation(const CardInfo& formerMainCard);
+    void discardSpeculation(); // 强化中途失败返回时等待并丢弃预选识别
+    bool confirmSpeculativePlan(const EnhancementPlan& plan);
+    QStringList speculationCardTypes;
+    PendingFrameResult speculation;
+    std::shared_ptr<QVector<CardInfo>> speculativeCards;
+    QImage speculativeFrame;
+    EnhancementPlan speculativePlan;
+    int speculationCommitted = 0;
+    int speculationDiscarded = 0;
     BOOL performCardProduce(const QVector<CardInfo>& cardVector);
     BOOL performCardProduceOnce();
     bool checkBackpackFull(); // 检测背包是否满了
+    bool handlePopups(const QImage& screenshot); // 处理弹窗，返回false表示被未知弹窗遮挡需中断
     void getCardNeedProduce(); // 分析强化配置提取制卡需求
     void threadSafeSleep(int ms);
 };
@@ -384,6 +441,75 @@ struct ProductionStatistics {
 
 extern ProductionStatistics g_productionStats;
 
+// 强化结果
+enum class EnhanceOutcome {
+    Unknown,    // 无法识别
+    Success,    // 强化成功（星级+1）
+    Failure     // 强化失败（星级未提升）
+};
+
+// 强化成功率统计数据结构
+struct EnhancementStatistics {
+    // 单个材料组合的结果计数
+    struct OutcomeCount {
+        int success = 0;
+        int failure = 0;
+
+        int total() const { return success + failure; }
+        double successRate() const { return total() > 0 ? static_cast<double>(success) / total() : 0.0; }
+
+        // Wilson置信区间，z=1.96对应95%置信度，返回(下限, 上限)
+        QPair<double, double> wilsonInterval(double z = 1.96) const {
+            int n = total();
+            if (n == 0) {
+                return qMakePair(0.0, 1.0);
+            }
+            double p = successRate();
+            double z2 = z * z;
+            double denominator = 1.0 + z2 / n;
+            double center = (p + z2 / (2.0 * n)) / denominator;
+            double margin = z * std::sqrt(p * (1.0 - p) / n + z2 / (4.0 * n * n)) / denominator;
+            return qMakePair(qMax(0.0, center - margin), qMin(1.0, center + margin));
+        }
+    };
+
+    QMap<QString, OutcomeCount> outcomeStats; // 组合键 -> 结果计数
+
+    // 组合键格式：卡片|起始星级|副卡星级(逗号分隔)|四叶草
+    static QString makeKey(const QString& cardType, int fromLevel, const QVector<int>& subcardLevels, const QString& clover) {
+        QStringList levels;
+        for (int subLevel : subcardLevels) {
+            levels.append(QString::number(subLevel));
+        }
+        return QString("%1|%2|%3|%4").arg(cardType).arg(fromLevel).arg(levels.join(",")).arg(clover.isEmpty() ? "无" : clover);
+    }
+
+    // 添加强化结果记录
+    void addOutcome(const QString& key, bool success) {
+        if (success) {
+            outcomeStats[key].success++;
+        } else {
+            outcomeStats[key].failure++;
+        }
+    }
+
+    // 获取强化总次数
+    int getTotalAttempts() const {
+        int total = 0;
+        for (auto it = outcomeStats.begin(); it != outcomeStats.end(); ++it) {
+            total += it.value().total();
+        }
+        return total;
+    }
+
+    // 清空统计数据
+    void clear() {
+        outcomeStats.clear();
+    }
+};
+
+extern EnhancementStatistics g_enhancementStats;
+
 // 卡片设置对话框
 class CardSettingDialog : public QDialog
 {
@@ -437,7 +563,14 @@ public:
     ~StarryCard();
     
     // 任务延时
-    void sleepByQElapsedTimer(int ms);
+    bool sleepByQElapsedTimer(int ms); // 停止强化时立即返回false，等待期间不占用CPU
+    // 当前会话是否仍在进行：界面线程读取sessionStop，其他线程读取本线程绑定的会话令牌（StopToken::current()）
+    bool isEnhancing() const;
+    void requestStop(); // 结束当前会话（非界面线程结束本线程绑定的会话），唤醒所有等待
+    // 等待游戏画面指定区域稳定（替代点击后的固定延时），roi为空时检测整个主页面
+    SettleResult waitForScreenSettle(const QRect& roi, const SettleOptions& options = SettleOptions());
+    // 回放模式：识别流程读取录制的会话、帧归档或帧目录（见openRecordedFrames），游戏窗口输入只记录不发送
+    bool startReplay(const QString& path);
     
     // 声明EnhancementWorker为友元类
     friend class EnhancementWorker;
@@ -472,7 +605,7 @@ private slots:
     void clickRefresh();
 
 signals:
-    void startEnhancementSignal();
+    void startEnhancementSignal(std::shared_ptr<StopToken> stopToken);
 
 protected:
     void mouseMoveEvent(QMouseEvent *event) override;
@@ -485,6 +618,23 @@ private:
     void setupUI();
     void updateCurrentBgLabel();
     QImage captureWindowByHandle(HWND hwnd, const QString& windowName = "");
+    void setFrameSource(FrameSource* source); // 切换识别使用的帧源，nullptr恢复实时截图
+    bool isReplaying() const; // 当前帧源是录制回放
+    bool hasGameWindow() const; // 已绑定有效的游戏窗口，回放时始终为true
+    InputSink* gameInputSink(); // 游戏窗口输入出口，回放时为只记录的输入端
+    void stopAsyncCapture(); // 停止异步截图线程并恢复同步实时截图
+    RegionFrame captureGameRegions(const QVector<QRect>& regions); // 只截取游戏画面中的指定区域
+    // 异步截图期间只返回序号大于lastSequence的帧并更新lastSequence，超时没有新帧返回空图像
+    // 稳定检测和点击确认逐帧比较，重复读到同一缓存帧会被误判为画面静止
+    QImage captureNewGameFrame(quint64& lastSequence);
+    RegionFrame captureNewGameRegions(const QVector<QRect>& regions, quint64& lastSequence);
+    // 等待下一帧的超时：异步截图间隔加上节流器当前的截图间隔（画面静止时最长idleIntervalMs），再留出余量
+    int newFrameTimeoutMs() const;
+    QVector<CardInfo> recognizeBackpackCards(const QImage& frame, const QStringList& cardTypes); // 优先交给识别进程，不可用时本进程识别
+    // 只读帧的背包识别，可在FrameAnalyzer线程池中执行：不访问界面对象，也不写识别记录
+    std::function<QVector<CardInfo>(const QImage&)> backpackCardRecognition(const QStringList& cardTypes);
+    void dumpSessionRecording(const QString& reason); // 在后台导出会话录制到sessions目录，只保留最近的若干个文件
+    void archiveDebugFrame(const QImage& image, const QString& label); // 调试图像写入帧归档
     QImage captureImageRegion(const QImage& sourceImage, const QRect& rect, const QString& filename = "");
     void showRecognitionResults(const QVector<CardInfo>& results);
     QWidget* createEnhancementConfigPage();
@@ -531,7 +681,16 @@ private:
     
     // 动态识别方法 - 每10ms识别一次，匹配度<1时立即下一次，2秒超时
     QPair<bool, bool> dynamicRecognizeSpice(const QString& spiceType, bool spice_bound, bool spice_unbound);
-    
+
+    // 物品栏索引（会话内有效）
+    bool rewindItemStrip(); // 翻页到物品栏顶部
+    bool buildStripIndex(StripInventory& index, const StripInventory::SlotClassifier& classify); // 自上而下翻页一次建立索引
+    bool jumpToStripPage(StripInventory& index, int page); // 按记录的当前页直接翻到目标页
+    bool locateStripItem(StripInventory& index, const StripInventory::SlotClassifier& classify, const QString& item,
+                         bool acceptBound, bool acceptUnbound, StripSlotEntry& entry); // 查找物品并翻到所在页
+    StripInventory::SlotClassifier cloverSlotClassifier();
+    StripInventory::SlotClassifier spiceSlotClassifier();
+
     // 香料配置相关方法
     QList<QPair<QString, int>> calculateSpiceAllocation(int totalCardCount);
     
@@ -549,25 +708,41 @@ private:
     // 配方识别和点击的统一处理方法
     bool performRecipeRecognitionAndClick(const QString& targetRecipe); // 执行配方识别和点击的完整流程
     void performRecipePageNavigation(int clickX, int clickY); // 执行配方页面导航点击
+    
+    // 配方位置索引（会话内有效）
+    bool buildRecipeIndex(); // 一次滚动遍历配方列表，记录所有配方位置
+    bool clickIndexedRecipe(const QString& targetRecipe); // 按索引直接滚动到配方所在页并点击
+    void invalidateRecipeIndex(); // 配方列表变化后清空索引
+    bool navigateToRecipeByOrder(const QString& targetRecipe); // 按已知配方顺序二分查找，列表重排后仍可用
+    QHash<QString, RecipeLocation> recipeLocationIndex; // 配方名称 -> 位置
+    bool recipeIndexBuilt = false;
+    OrderedListNavigator recipeNavigator; // 配方在列表中的先后顺序（建立索引时学习）
+    int recipeScrollBarLength = 0; // 建立索引时的配方滚动条长度
 
     // 配方识别相关方法（已迁移到 RecipeRecognizer）
     QStringList getAvailableRecipeTypes() const; // 获取所有可用的配方类型
     
     // 鼠标点击相关方法
     BOOL leftClickDPI(HWND hwnd, int x, int y);
+    BOOL leftClickIdempotent(int x, int y); // 游戏窗口内重复点击无额外效果的按钮，画面未变时限流端可合并
     BOOL leftClick(HWND hwnd, int x, int y);
     BOOL closeHealthTip(uint8_t retryCount = 10);
     
+    // 弹窗检测相关方法
+    void loadPopupTemplates();
+    PopupCheckResult checkPopups(const QImage& screenshot); // 每帧检查弹窗，已知弹窗直接关闭
+    bool isKnownSceneVisible(const QImage& screenshot); // 是否能看到任一页面定位锚点
+    
     // 窗口相关方法
     HWND GetHallWindow(HWND hWnd);
     bool IsGameWindowVisible(HWND hWnd);
     
     // 窗口位图获取方法
-    BOOL getWindowBitmap(HWND hwnd, int& width, int& height, COLORREF*& pixelData);
+    BOOL getWindowBitmap(HWND hwnd, FrameHandle& frame);
     
     // 颜色识别相关方法
     BOOL isGamePlatformColor(COLORREF color, int platformType);
-    int recognizeBitmapRegionColor(int platformType, COLORREF *pHallShot[4320], const QRect& region);
+    int recognizeBitmapRegionColor(int platformType, const FrameView& hallShot, const QRect& region);
 
     // 图像哈希对比
     // uint64_t calculateImageHash(const QImage& image, const QRect& roi);
@@ -603,15 +778,12 @@ private:
     QSpinBox *minEnhancementLevelSpinBox = nullptr;
     
     bool isTracking = false;
-    bool isEnhancing = false;
+    std::shared_ptr<StopToken> sessionStop = std::make_shared<StopToken>(true); // 当前强化会话的停止令牌，未强化时为已停止；只在界面线程读写
+    QEventLoop* guiWaitLoop = nullptr; // 主线程当前等待所在的事件循环，停止强化时退出
+    bool sessionOpen = false; // 主线程：当前会话尚未收尾
     HWND hwndGame = nullptr; // 游戏窗口
     HWND hwndHall = nullptr;   // 大厅窗口
     HWND hwndServer = nullptr; // 选服窗口
-    
-    // 全局位图数据
-    COLORREF* globalPixelData = nullptr;
-    int globalBitmapWidth = 0;
-    int globalBitmapHeight = 0;
 
     QString defaultBgPath = ":/images/background/default.png";
     QString customBgPath = "";
@@ -653,28 +825,47 @@ private:
     // 位置模板相关方法
     void loadPositionTemplates();
     QString recognizeCurrentPosition(QImage screenshot);
+    SceneInfo classifyScene(const QImage& screenshot); // 一帧截图识别当前页面和子状态
 
     // 加载合成屋内卡片位置模板
     void loadSynHousePosTemplates();
     QHash<QString, QString> synHousePosTemplateHashes; // 合成屋内卡片位置模板名称 -> 哈希值
     BOOL checkSynHousePosState(QImage screenshot, const QRect& pos, const QString& templateName);
+    BOOL checkSynHousePosState(const QRect& pos, const QString& templateName); // 只截取pos区域检测
+    // 只比较不记录识别结果，可在FrameAnalyzer任务中调用
+    bool matchPosTemplate(const QImage& frame, const QRect& pos, const QString& templateName);
     
     // 卡片状态检查方法
     bool checkCardSelectionBeforeEnhancement(const CardInfo& expectedMainCard, const QVector<CardInfo>& expectedSubcards);
+    // 识别主卡位置的卡片星级：匹配星级模板返回1-16，匹配emptyStarHash（0星卡片自身的星级区域）返回0，否则返回-1
+    int recognizeMainCardLevel(const QImage& screenshot, const QString& emptyStarHash = QString());
+    QString mainCardStarHash(const QImage& screenshot); // 主卡位置星级区域的哈希，强化前记录作为0星模板
+    EnhanceOutcome recognizeEnhancementOutcome(int fromLevel, const QString& emptyStarHash); // 根据主卡位置的星级判断强化结果
     void cancelAllCardSelections();
     
     // 配方状态检查方法
     bool checkRecipeSelectionBeforeProduction(const QString& expectedRecipe);
     bool clickRecipeAndVerify(const QPoint& clickPos, const QString& targetRecipe, int maxRetries = 3);
+    ClickVerifier::Options recipeSlotOptions(const QString& targetRecipe); // 配方槽与目标配方一致即确认
     
     const QRect MAIN_CARD_POS = QRect(269, 332, 32, 32); // 主卡位置
+    const QRect MAIN_CARD_STAR_ROI = QRect(272, 328, 6, 8); // 主卡星级图标区域
     const QRect SUB_CARD_POS = QRect(269, 261, 32, 32);  // 副卡位置
     const QRect INSURANCE_POS = QRect(382, 423, 20, 20); // 保险位置
     const QRect PRODUCE_READY_POS = QRect(375, 364, 32, 32); // 制卡准备位置
     const QRect ENHANCE_BUTTON_POS = QRect(261, 425, 20, 20); // 强化按钮位置
     const QRect ENHANCE_SCROLL_BAR_BOTTOM = QRect(902, 526, 16, 16); // 强化滚动条底部位置
+    const QRect BACKPACK_CARD_AREA = QRect(559, 91, 343, 456); // 卡片背包区域
+    const QSize BACKPACK_CARD_SIZE = QSize(49, 57); // 背包中单张卡片格子大小
+    const QRect SCROLL_BAR_COLUMN = QRect(903, 108, 1, 450); // 滚动条检测列
     const QRect RECIPE_SCROLL_BAR_BOTTOM = QRect(902, 265, 16, 16);  // 配方滚动条底部位置
     const QRect RECIPE_SLOT_POS = QRect(268, 344, 38, 24); // 合成屋配方显示位置（ROI区域）
+    const QRect RECIPE_SLOT_EMPTY_POS = QRect(270, 356, 20, 20); // 配方槽为空的检测区域，制卡后为空表示背包已满
+    const QRect ITEM_STRIP_AREA = QRect(33, 526, 490, 49); // 四叶草/香料物品栏区域
+    // 物品栏索引（会话内有效），在ITEM_STRIP_AREA之后声明以保证初始化顺序
+    StripInventory cloverStripIndex{"四叶草", ITEM_STRIP_AREA};
+    StripInventory spiceStripIndex{"香料", ITEM_STRIP_AREA};
+    const QRect RECIPE_RECOGNITION_AREA = QRect(555, 88, 365, 149); // 配方列表识别区域
 
     // 页面跳转枚举
     enum class PageType {
@@ -683,15 +874,18 @@ private:
     };
 
     BOOL goToPage(PageType targetPage, uint8_t retryCount = 12);
+    QString currentPageName(const QImage& screenshot); // 当前页面描述，如"卡片强化"，未识别为空
     
     // 滚动条相关方法
     void fastMouseDrag(int startX, int startY, int distance, bool downward = true);
-    void fastMouseDragForRecipe(int scrollBarPosition, int scrollBarLength, bool downward = true); // 配方专属滚动方法
     BOOL resetScrollBar();
     BOOL resetRecipeScrollBar(); // 配方专属滚动条重置
     int getLengthOfScrollBar(QImage screenshot);
+    int getPositionOfScrollBar(); // 只截取滚动条所在列
+    int scanScrollBarColumn(const QImage& image, const QPoint& top, bool stopAtBarColor);
     int getPositionOfScrollBar(QImage screenshot);
     int getRecipeScrollDistance(int scrollBarLength); // 计算配方翻页的精确滚动距离（基于滚动条长度）
+    int scrollRecipePage(int scrollBarLength, int scrollBarPosition); // 配方翻页，已学到行距时按行滚动
 
     // 位置模板相关数据
     QHash<QString, QString> positionTemplateHashes; // 位置模板名称 -> 哈希值
@@ -700,6 +894,7 @@ private:
     static const QPoint CARD_ENHANCE_POS;       // 卡片强化按钮位置 (94,326)
     static const QPoint CARD_PRODUCE_POS;       // 卡片制作按钮位置 (94,260)
     static const QPoint SYNTHESIS_HOUSE_POS;    // 合成屋按钮位置 (675,556)
+    static const QPoint SYNTHESIS_HOUSE_CLOSE_POS; // 合成屋关闭按钮位置 (914,40)
     static const QPoint RANKING_POS;            // 排行榜位置 (178,96)
     static const QPoint ENHANCE_SCROLL_TOP;     // 强化滚动条顶部位置 (902, 98)
 
@@ -708,6 +903,32 @@ private:
     int minEnhancementLevel = 1;
 
     RecipeRecognizer* recipeRecognizer; // 新增成员变量
+    DigitRecognizer* digitRecognizer = nullptr; // 物品数量识别
+    PopupRegistry* popupRegistry = nullptr; // 弹窗注册表
+    SceneClassifier* sceneClassifier = nullptr; // 场景分类器
+    FrameAnalyzer* frameAnalyzer = nullptr; // 单帧多识别任务并行执行
+    RecognitionHost* recognitionHost = nullptr; // 独立识别进程，第一次强化时启动，崩溃不影响主进程
+    GdiFrameSource* liveFrameSource = nullptr; // 实时截取游戏窗口
+    CaptureGovernor* captureGovernor = nullptr; // 实时截图节流，限制每秒截图次数和CPU耗时
+    Win32InputSink* gameInput = nullptr; // 向游戏窗口发送鼠标消息
+    RateLimitedInputSink* inputSink = nullptr; // 游戏窗口输入出口（限流、合并冗余点击）
+    RecordingInputSink* replayInput = nullptr; // 回放时记录本应发给游戏窗口的输入
+    std::unique_ptr<FrameSource> replaySource; // --replay打开的录制帧源
+    ScrollController* backpackScroll = nullptr; // 卡片背包滚动条闭环控制
+    ScrollController* recipeScroll = nullptr; // 配方列表滚动条闭环控制
+    SceneRouter* pageRouter = nullptr; // 合成屋页面导航图
+    ClickVerifier* clickVerifier = nullptr; // 点击后只比较预期变化区域确认点击生效
+    AsyncCaptureSource* asyncCapture = nullptr; // 强化期间的异步截图线程
+    const int NEW_FRAME_MARGIN_MS = 100; // 等待新帧时在截图间隔之外多等的时间（截图本身耗时和CPU预算推迟）
+    SessionRecorder* sessionRecorder = nullptr; // 会话录制（截图、操作、识别结果）
+    const int MAX_SESSION_FILES = 20; // sessions目录保留的会话文件数
+    FrameArchiveWriter* debugArchive = nullptr; // 调试图像帧归档，首次使用时打开
+    QMutex debugArchiveMutex; // 保护debugArchive的创建和追加
+    std::atomic<FrameSource*> frameSource{nullptr}; // 识别使用的帧源（实时、异步或回放），界面线程切换，工作线程每次使用时读取一次
+    qint64 unknownOverlaySince = 0; // 开始无法识别页面锚点的时间戳（毫秒），0表示当前可识别
+    qint64 lastPopupCheckAt = 0; // 上一次checkPopups的时间戳（毫秒）
+    bool overlayFallbackTried = false; // 本次遮挡是否已尝试过注册表中没有签名的关闭方式
+    const int POPUP_CHECK_GAP_MS = 500; // 两次弹窗检查间隔超过该值视为新的等待循环，遮挡计时重新开始
     
     // 线程相关
     QThread* enhancementThread;
@@ -733,6 +954,10 @@ private slots:
     void loadProductionStatistics(); // 加载制卡统计数据
     void saveProductionStatistics(); // 保存制卡统计数据
     void addProductionRecord(const QString& spiceName, const QString& recipeName); // 添加制卡记录（仅累计，不保存）
+    void loadEnhancementStatistics(); // 加载强化成功率统计
+    void saveEnhancementStatistics(); // 保存强化成功率统计
+    void addEnhancementRecord(const QString& cardType, int fromLevel, const QVector<int>& subcardLevels,
+                              const QString& clover, bool success); // 添加强化结果记录（仅累计，不保存）
     
 public:
     void updateRecipeCombo(); // 更新配方选择下拉框
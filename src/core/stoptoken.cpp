@@ -0,0 +1,68 @@
+#include "stoptoken.h"
+#include <QDeadlineTimer>
+
+namespace {
+
+thread_local std::shared_ptr<StopToken> threadToken;
+
+} // namespace
+
+StopToken::StopToken(bool initiallyStopped)
+    : stopped(initiallyStopped), finished(initiallyStopped)
+{
+}
+
+void StopToken::requestStop()
+{
+    // 持锁修改，保证检查标志后进入等待的线程不会错过唤醒
+    QMutexLocker locker(&mutex);
+    stopped.store(true, std::memory_order_release);
+    changed.wakeAll();
+}
+
+bool StopToken::sleepFor(int ms)
+{
+    if (ms <= 0) {
+        return !stopRequested();
+    }
+
+    QDeadlineTimer deadline(ms);
+    QMutexLocker locker(&mutex);
+    while (!stopRequested() && !deadline.hasExpired()) {
+        changed.wait(&mutex, deadline);
+    }
+    return !stopRequested();
+}
+
+void StopToken::markFinished()
+{
+    QMutexLocker locker(&mutex);
+    finished = true;
+    changed.wakeAll();
+}
+
+bool StopToken::waitForFinished(int timeoutMs)
+{
+    QDeadlineTimer deadline(timeoutMs);
+    QMutexLocker locker(&mutex);
+    while (!finished && !deadline.hasExpired()) {
+        changed.wait(&mutex, deadline);
+    }
+    return finished;
+}
+
+std::shared_ptr<StopToken> StopToken::current()
+{
+    return threadToken;
+}
+
+StopToken::Binding::Binding(std::shared_ptr<StopToken> token)
+    : previous(std::move(threadToken))
+{
+    threadToken = std::move(token);
+}
+
+StopToken::Binding::~Binding()
+{
+    threadToken = std::move(previous);
+}
@@ -0,0 +1,56 @@
+#ifndef STOPTOKEN_H
+#define STOPTOKEN_H
+
+#include <QMetaType>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <memory>
+
+// 会话停止令牌：每次强化会话新建一个，界面线程请求停止，工作线程检查和等待
+// 停止标志是原子变量，可在任意线程无锁读取；等待在条件变量上进行，
+// 请求停止时立即唤醒所有等待中的线程，等待期间不占用CPU
+class StopToken
+{
+public:
+    // initiallyStopped为true时创建一个已停止且已结束的令牌，表示当前没有会话
+    explicit StopToken(bool initiallyStopped = false);
+
+    void requestStop();
+    bool stopRequested() const { return stopped.load(std::memory_order_acquire); }
+
+    // 等待ms毫秒，期间请求停止则立即返回；完整等待了ms毫秒返回true
+    bool sleepFor(int ms);
+
+    // 会话线程退出时调用，唤醒waitForFinished
+    void markFinished();
+    // 等待会话线程退出，超时返回false
+    bool waitForFinished(int timeoutMs);
+
+    // 当前线程绑定的令牌，未绑定返回nullptr
+    // 会话线程在开始时绑定自己的令牌，线程内调用的等待函数都从这里取得，不读取界面线程会替换的共享成员
+    static std::shared_ptr<StopToken> current();
+
+    // 作用域内把令牌绑定到当前线程，析构时恢复之前的绑定
+    class Binding
+    {
+    public:
+        explicit Binding(std::shared_ptr<StopToken> token);
+        ~Binding();
+        Binding(const Binding&) = delete;
+        Binding& operator=(const Binding&) = delete;
+
+    private:
+        std::shared_ptr<StopToken> previous;
+    };
+
+private:
+    std::atomic<bool> stopped;
+    bool finished;              // 由mutex保护
+    QMutex mutex;
+    QWaitCondition changed;
+};
+
+Q_DECLARE_METATYPE(std::shared_ptr<StopToken>)
+
+#endif // STOPTOKEN_H
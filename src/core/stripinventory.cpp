@@ -0,0 +1,101 @@
+#include "stripinventory.h"
+#include <QDebug>
+
+StripInventory::StripInventory(const QString& name, const QRect& stripArea)
+    : inventoryName(name), area(stripArea)
+{
+}
+
+void StripInventory::clear()
+{
+    entries.clear();
+    pages = 0;
+    built = false;
+}
+
+int StripInventory::addPage(const QImage& screenshot, int page, const SlotClassifier& classify)
+{
+    int found = 0;
+    for (int slot = 0; slot < SLOTS_PER_PAGE; ++slot) {
+        QImage image = slotImage(screenshot, slot);
+        if (image.isNull()) {
+            continue;
+        }
+
+        StripSlotEntry entry;
+        if (!classify(image, entry)) {
+            continue;
+        }
+        entry.page = page;
+        entry.slot = slot;
+        entries.append(entry);
+        found++;
+    }
+    return found;
+}
+
+void StripInventory::finishBuild(int pageCount)
+{
+    pages = pageCount;
+    built = true;
+    qDebug() << QString("%1物品栏索引建立完成：%2页，%3个格子").arg(inventoryName).arg(pages).arg(entries.size());
+}
+
+const StripSlotEntry* StripInventory::find(const QString& item, bool acceptBound, bool acceptUnbound) const
+{
+    for (const StripSlotEntry& entry : entries) {
+        if (entry.item == item && bindAccepted(entry.bound, acceptBound, acceptUnbound)) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+void StripInventory::consume(const QString& item, bool bound, int amount)
+{
+    for (int i = 0; i < entries.size(); ++i) {
+        StripSlotEntry& entry = entries[i];
+        if (entry.item != item || entry.bound != bound) {
+            continue;
+        }
+
+        if (entry.quantity < 0) {
+            return;
+        }
+
+        entry.quantity -= amount;
+        if (entry.quantity <= 0) {
+            qDebug() << QString("%1 %2 已用完，%3物品栏索引失效").arg(item).arg(bound ? "(绑定)" : "(不绑)").arg(inventoryName);
+            invalidate();
+        }
+        return;
+    }
+}
+
+void StripInventory::invalidate()
+{
+    clear();
+}
+
+bool StripInventory::bindAccepted(bool bound, bool acceptBound, bool acceptUnbound)
+{
+    // 与checkCloverBindState/checkSpiceBindState一致：都不勾选表示不限制
+    if (!acceptBound && !acceptUnbound) {
+        return true;
+    }
+    return bound ? acceptBound : acceptUnbound;
+}
+
+QImage StripInventory::slotImage(const QImage& screenshot, int slot) const
+{
+    QRect rect(area.x() + slot * SLOT_SIZE, area.y(), SLOT_SIZE, SLOT_SIZE);
+    if (screenshot.isNull() || !screenshot.rect().contains(rect)) {
+        return QImage();
+    }
+    return screenshot.copy(rect);
+}
+
+QPoint StripInventory::slotCenter(int slot) const
+{
+    return QPoint(area.x() + slot * SLOT_SIZE + 24, area.y() + 24);
+}
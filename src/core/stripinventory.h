@@ -0,0 +1,68 @@
+#ifndef STRIPINVENTORY_H
+#define STRIPINVENTORY_H
+
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+#include <QString>
+#include <QVector>
+#include <functional>
+
+// 物品栏（四叶草/香料）单个格子的索引记录
+struct StripSlotEntry {
+    QString item;          // 物品名称
+    int page = 0;          // 所在页，从顶部开始计数
+    int slot = 0;          // 页内位置 0-9
+    bool bound = false;    // 是否绑定
+    int quantity = -1;     // 堆叠数量，-1表示未能识别
+};
+
+// 物品栏索引：自上而下翻页一次，记录每个物品所在的页和格子，会话内有效
+// 物品只会因消耗而减少，因此只有消耗动作涉及的条目才可能失效
+class StripInventory
+{
+public:
+    static constexpr int SLOTS_PER_PAGE = 10;
+    static constexpr int SLOT_SIZE = 49;
+
+    // 识别单个格子，空格子或未知物品返回false
+    using SlotClassifier = std::function<bool(const QImage& slotImage, StripSlotEntry& entry)>;
+
+    // stripArea为物品栏区域（游戏窗口坐标），由页面布局定义方传入
+    StripInventory(const QString& name, const QRect& stripArea);
+
+    // 建立索引：clear后逐页调用addPage，最后调用finishBuild
+    void clear();
+    int addPage(const QImage& screenshot, int page, const SlotClassifier& classify);
+    void finishBuild(int pageCount);
+
+    bool isBuilt() const { return built; }
+    int pageCount() const { return pages; }
+    int size() const { return entries.size(); }
+    const QString& name() const { return inventoryName; }
+
+    // 按页、格子顺序查找第一个符合绑定要求的物品，未找到返回nullptr
+    const StripSlotEntry* find(const QString& item, bool acceptBound, bool acceptUnbound) const;
+
+    // 记录消耗：数量已知时扣减，整组用完后其后的格子会前移，整个索引失效；
+    // 数量未知时保留条目，由使用前的画面校验发现不符
+    void consume(const QString& item, bool bound, int amount);
+
+    // 条目与画面不符时丢弃整个索引（当前页位置仍然有效）
+    void invalidate();
+
+    static bool bindAccepted(bool bound, bool acceptBound, bool acceptUnbound);
+    QImage slotImage(const QImage& screenshot, int slot) const;
+    QPoint slotCenter(int slot) const;
+
+    int currentPage = -1;  // 物品栏当前所在页，-1表示未知
+
+private:
+    QString inventoryName;
+    QRect area;
+    QVector<StripSlotEntry> entries;
+    int pages = 0;
+    bool built = false;
+};
+
+#endif // STRIPINVENTORY_H
@@ -0,0 +1,210 @@
+#include "x11framesource.h"
+
+#ifdef STARRYCARD_X11
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+namespace {
+
+// 窗口未映射或已销毁时Xlib默认的错误处理会直接退出进程，这里只记录错误码
+int lastXError = 0;
+
+int recordXError(Display*, XErrorEvent* event)
+{
+    lastXError = event->error_code;
+    return 0;
+}
+
+} // namespace
+
+struct X11FrameSource::Private
+{
+    Display* display = nullptr;
+    bool shmAvailable = false;
+    XImage* image = nullptr;
+    XShmSegmentInfo shmInfo{};
+
+    bool ensureImage(int width, int height);
+    void releaseImage();
+};
+
+bool X11FrameSource::Private::ensureImage(int width, int height)
+{
+    if (image && image->width == width && image->height == height) {
+        return true;
+    }
+    releaseImage();
+
+    const int screen = DefaultScreen(display);
+    image = XShmCreateImage(display, DefaultVisual(display, screen), DefaultDepth(display, screen),
+                            ZPixmap, nullptr, &shmInfo, width, height);
+    if (!image) {
+        return false;
+    }
+
+    shmInfo.shmid = shmget(IPC_PRIVATE, size_t(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+    if (shmInfo.shmid < 0) {
+        XDestroyImage(image);
+        image = nullptr;
+        return false;
+    }
+    shmInfo.shmaddr = image->data = static_cast<char*>(shmat(shmInfo.shmid, nullptr, 0));
+    shmInfo.readOnly = False;
+
+    lastXError = 0;
+    bool attached = XShmAttach(display, &shmInfo);
+    XSync(display, False);
+    attached = attached && lastXError == 0;
+    // 标记删除，两端都分离后由内核回收，进程崩溃也不会泄漏共享内存段
+    shmctl(shmInfo.shmid, IPC_RMID, nullptr);
+    if (!attached) {
+        shmdt(shmInfo.shmaddr);
+        image->data = nullptr;
+        XDestroyImage(image);
+        image = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void X11FrameSource::Private::releaseImage()
+{
+    if (!image) {
+        return;
+    }
+    XShmDetach(display, &shmInfo);
+    XSync(display, False);
+    shmdt(shmInfo.shmaddr);
+    image->data = nullptr; // 像素位于共享内存段，不能由XDestroyImage释放
+    XDestroyImage(image);
+    image = nullptr;
+}
+
+X11FrameSource::X11FrameSource(WindowProvider windowProvider, const QRect& area, const QString& displayName)
+    : d(new Private), currentWindow(std::move(windowProvider)), captureArea(area)
+{
+    const QByteArray name = displayName.toLocal8Bit();
+    d->display = XOpenDisplay(displayName.isEmpty() ? nullptr : name.constData());
+    if (!d->display) {
+        qDebug() << "无法连接X服务器:" << (displayName.isEmpty() ? qgetenv("DISPLAY") : name);
+        return;
+    }
+    XSetErrorHandler(recordXError);
+    d->shmAvailable = XShmQueryExtension(d->display);
+    if (!d->shmAvailable) {
+        qDebug() << "X服务器不支持MIT-SHM，使用XGetImage截图";
+    }
+}
+
+X11FrameSource::~X11FrameSource()
+{
+    if (d->display) {
+        d->releaseImage();
+        XCloseDisplay(d->display);
+    }
+}
+
+bool X11FrameSource::isValid() const
+{
+    return d->display != nullptr;
+}
+
+bool X11FrameSource::usesSharedMemory() const
+{
+    return d->shmAvailable;
+}
+
+QImage X11FrameSource::grab()
+{
+    FrameHandle frame;
+    if (!grabInto(frame)) {
+        return QImage();
+    }
+    return frame.toImage();
+}
+
+bool X11FrameSource::grabInto(FrameHandle& target)
+{
+    if (!d->display) {
+        return false;
+    }
+    if (target.isNull() || target.isShared() || target.width() != captureArea.width()
+        || target.height() != captureArea.height() || target.format() != QImage::Format_ARGB32_Premultiplied) {
+        target = FrameBufferPool::shared().acquire(captureArea.width(), captureArea.height());
+    }
+
+    if (governor) {
+        governor->acquire();
+    }
+    QElapsedTimer timer;
+    timer.start();
+    bool success = capture(target.bits(), target.bytesPerLine());
+    lastTimestamp = QDateTime::currentMSecsSinceEpoch();
+    if (governor) {
+        const quint64 signature = success ? CaptureGovernor::signature(target.bits(), target.bytesPerLine(),
+                                                                      target.width(), target.height()) : 0;
+        governor->record(timer.nsecsElapsed() / 1000, signature);
+    }
+    return success;
+}
+
+bool X11FrameSource::capture(uchar* bits, int bytesPerLine)
+{
+    const Window window = static_cast<Window>(currentWindow());
+    if (!window) {
+        qDebug() << "X11窗口无效";
+        return false;
+    }
+
+    const int width = captureArea.width();
+    const int height = captureArea.height();
+    XImage* source = nullptr;
+    bool ownsImage = false;
+
+    lastXError = 0;
+    if (d->shmAvailable && d->ensureImage(width, height)) {
+        if (XShmGetImage(d->display, window, d->image, captureArea.x(), captureArea.y(), AllPlanes)) {
+            source = d->image;
+        }
+    }
+    if (!source) {
+        source = XGetImage(d->display, window, captureArea.x(), captureArea.y(), width, height, AllPlanes, ZPixmap);
+        ownsImage = true;
+    }
+    XSync(d->display, False);
+    if (!source || lastXError != 0) {
+        qDebug() << QString("X11截图失败，错误码%1").arg(lastXError);
+        if (source && ownsImage) {
+            XDestroyImage(source);
+        }
+        return false;
+    }
+
+    bool success = source->bits_per_pixel == 32;
+    if (success) {
+        // 24/32位TrueColor的ZPixmap在小端机器上与ARGB32内存布局一致，只需补上不透明的alpha
+        for (int y = 0; y < height; ++y) {
+            const quint32* src = reinterpret_cast<const quint32*>(source->data + size_t(y) * source->bytes_per_line);
+            quint32* dst = reinterpret_cast<quint32*>(bits + size_t(y) * bytesPerLine);
+            for (int x = 0; x < width; ++x) {
+                dst[x] = src[x] | 0xff000000u;
+            }
+        }
+    } else {
+        qDebug() << QString("不支持的X11像素格式：%1位").arg(source->bits_per_pixel);
+    }
+
+    if (ownsImage) {
+        XDestroyImage(source);
+    }
+    return success;
+}
+
+#endif // STARRYCARD_X11
@@ -0,0 +1,49 @@
+#ifndef X11FRAMESOURCE_H
+#define X11FRAMESOURCE_H
+
+#ifdef STARRYCARD_X11
+
+#include "capturegovernor.h"
+#include "framesource.h"
+#include <QString>
+#include <functional>
+#include <memory>
+
+// Linux实时帧源：通过MIT-SHM截取X11窗口，X服务器把像素直接写入共享内存段，再复制一次到池缓冲区
+// X服务器不支持MIT-SHM（如远程显示）时退化为XGetImage
+// Xlib头文件只在实现文件中包含，避免其宏（None、Bool、Status等）污染Qt代码
+class X11FrameSource : public FrameSource
+{
+public:
+    using WindowProvider = std::function<unsigned long()>;
+
+    // windowProvider返回目标窗口的XID；displayName为空时使用DISPLAY环境变量（Xvfb下同样适用）
+    explicit X11FrameSource(WindowProvider windowProvider, const QRect& area = QRect(0, 0, 950, 596),
+                            const QString& displayName = QString());
+    ~X11FrameSource() override;
+
+    bool isValid() const;
+    bool usesSharedMemory() const;
+
+    QImage grab() override;
+    bool grabInto(FrameHandle& target) override;
+    qint64 timestamp() const override { return lastTimestamp; }
+
+    // 与GdiFrameSource相同，设置后截图经过节流器；所有权由调用方保留
+    void setGovernor(CaptureGovernor* captureGovernor) { governor = captureGovernor; }
+
+private:
+    struct Private;
+
+    bool capture(uchar* bits, int bytesPerLine);
+
+    std::unique_ptr<Private> d;
+    WindowProvider currentWindow;
+    QRect captureArea;
+    qint64 lastTimestamp = 0;
+    CaptureGovernor* governor = nullptr;
+};
+
+#endif // STARRYCARD_X11
+
+#endif // X11FRAMESOURCE_H
@@ -0,0 +1,77 @@
+#include "x11input.h"
+
+#ifdef STARRYCARD_X11
+
+#include <QDebug>
+#include <X11/Xlib.h>
+#include <X11/extensions/XTest.h>
+
+X11Input::X11Input(const QString& displayName)
+{
+    const QByteArray name = displayName.toLocal8Bit();
+    display = XOpenDisplay(displayName.isEmpty() ? nullptr : name.constData());
+    if (!display) {
+        qDebug() << "无法连接X服务器:" << (displayName.isEmpty() ? qgetenv("DISPLAY") : name);
+        return;
+    }
+
+    int eventBase = 0, errorBase = 0, major = 0, minor = 0;
+    if (!XTestQueryExtension(display, &eventBase, &errorBase, &major, &minor)) {
+        qDebug() << "X服务器不支持XTest扩展，无法发送鼠标事件";
+        XCloseDisplay(display);
+        display = nullptr;
+    }
+}
+
+X11Input::~X11Input()
+{
+    if (display) {
+        XCloseDisplay(display);
+    }
+}
+
+bool X11Input::toRoot(unsigned long window, int x, int y, QPoint& rootPos)
+{
+    if (!display || !window) {
+        return false;
+    }
+    Window child = 0;
+    int rootX = 0, rootY = 0;
+    if (!XTranslateCoordinates(display, static_cast<Window>(window), DefaultRootWindow(display),
+                               x, y, &rootX, &rootY, &child)) {
+        qDebug() << "X11坐标换算失败，窗口可能不在同一屏幕";
+        return false;
+    }
+    rootPos = QPoint(rootX, rootY);
+    return true;
+}
+
+bool X11Input::click(unsigned long window, int x, int y)
+{
+    QPoint pos;
+    if (!toRoot(window, x, y, pos)) {
+        return false;
+    }
+    XTestFakeMotionEvent(display, -1, pos.x(), pos.y(), CurrentTime);
+    XTestFakeButtonEvent(display, Button1, True, CurrentTime);
+    XTestFakeButtonEvent(display, Button1, False, CurrentTime);
+    XFlush(display);
+    return true;
+}
+
+bool X11Input::drag(unsigned long window, int x, int y, int distance, bool downward)
+{
+    QPoint start, end;
+    const int endY = downward ? y + distance : y - distance;
+    if (!toRoot(window, x, y, start) || !toRoot(window, x, endY, end)) {
+        return false;
+    }
+    XTestFakeMotionEvent(display, -1, start.x(), start.y(), CurrentTime);
+    XTestFakeButtonEvent(display, Button1, True, CurrentTime);
+    XTestFakeMotionEvent(display, -1, end.x(), end.y(), CurrentTime);
+    XTestFakeButtonEvent(display, Button1, False, CurrentTime);
+    XFlush(display);
+    return true;
+}
+
+#endif // STARRYCARD_X11
@@ -0,0 +1,38 @@
+#ifndef X11INPUT_H
+#define X11INPUT_H
+
+#ifdef STARRYCARD_X11
+
+#include <QPoint>
+#include <QString>
+
+typedef struct _XDisplay Display;
+
+// Linux输入后端：通过XTest合成鼠标事件，对应Windows下向游戏窗口PostMessage
+// 坐标为目标窗口内的坐标，发送前换算成根窗口坐标；XTest事件作用于真实指针，Xvfb下不影响桌面
+class X11Input
+{
+public:
+    // displayName为空时使用DISPLAY环境变量
+    explicit X11Input(const QString& displayName = QString());
+    ~X11Input();
+
+    X11Input(const X11Input&) = delete;
+    X11Input& operator=(const X11Input&) = delete;
+
+    bool isValid() const { return display != nullptr; }
+
+    // 与leftClick相同：在(x, y)按下并释放左键
+    bool click(unsigned long window, int x, int y);
+    // 与fastMouseDrag相同：按下、移动到终点、释放，三步完成
+    bool drag(unsigned long window, int x, int y, int distance, bool downward);
+
+private:
+    bool toRoot(unsigned long window, int x, int y, QPoint& rootPos);
+
+    Display* display = nullptr;
+};
+
+#endif // STARRYCARD_X11
+
+#endif // X11INPUT_H
@@ -1,12 +1,27 @@
 #include "core/starrycard.h"
+#include "core/recognitionhost.h"
 #include <QApplication>
 #include <QIcon>
+#include <QStringList>
 
 int main(int argc, char *argv[])
 {
+    // 以识别进程身份启动时不创建界面
+    for (int i = 1; i < argc; ++i) {
+        if (qstrcmp(argv[i], RecognitionProtocol::WORKER_ARGUMENT) == 0) {
+            return runRecognitionWorker(argc, argv);
+        }
+    }
+
     QApplication a(argc, argv);
     a.setWindowIcon(QIcon(":/icons/icon512.ico"));
     StarryCard w;
+    // --replay <文件>：识别流程读取录制的会话、帧归档或帧目录，用于离线复现问题
+    const QStringList arguments = a.arguments();
+    const int replayIndex = arguments.indexOf("--replay");
+    if (replayIndex >= 0 && replayIndex + 1 < arguments.size()) {
+        w.startReplay(arguments[replayIndex + 1]);
+    }
     w.show();
     return a.exec();
 }
@@ -0,0 +1,227 @@
+#include "digitrecognizer.h"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <algorithm>
+#include <cstdlib>
+
+const QRect DigitRecognizer::SLOT_QUANTITY_ROI(2, 34, 45, 10);
+
+DigitRecognizer::DigitRecognizer() : glyphsLoaded(false)
+{
+}
+
+bool DigitRecognizer::loadGlyphTemplates(const QString& dirPath)
+{
+    int loadedCount = 0;
+    for (int digit = 0; digit <= 9; ++digit) {
+        QString path = QString("%1/%2.png").arg(dirPath).arg(digit);
+        QImage image(path);
+        if (image.isNull()) {
+            qDebug() << "数字模板加载失败:" << path;
+            glyphTemplates[digit] = Glyph();
+            continue;
+        }
+
+        // 模板图片可能带有留白，取所有前景连通域的外接矩形作为字形
+        QRect roi = image.rect();
+        QVector<quint8> mask = binarize(image, roi);
+        QVector<quint8> work = mask;
+        QVector<Component> comps = findComponents(work, roi.width(), roi.height());
+        if (comps.isEmpty()) {
+            qDebug() << "数字模板无前景像素:" << path;
+            glyphTemplates[digit] = Glyph();
+            continue;
+        }
+
+        Component bounds = comps.first();
+        for (const Component& comp : comps) {
+            bounds.left = std::min(bounds.left, comp.left);
+            bounds.top = std::min(bounds.top, comp.top);
+            bounds.right = std::max(bounds.right, comp.right);
+            bounds.bottom = std::max(bounds.bottom, comp.bottom);
+        }
+        glyphTemplates[digit] = cropGlyph(mask, roi.width(), bounds);
+        loadedCount++;
+    }
+
+    glyphsLoaded = (loadedCount == 10);
+    qDebug() << "数字模板加载完成:" << loadedCount << "/ 10";
+    return glyphsLoaded;
+}
+
+QVector<quint8> DigitRecognizer::binarize(const QImage& image, const QRect& roi)
+{
+    QVector<quint8> mask(roi.width() * roi.height(), 0);
+    const QImage source = image.depth() == 32 ? image : image.convertToFormat(QImage::Format_RGB32);
+
+    for (int y = 0; y < roi.height(); ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(source.constScanLine(roi.y() + y));
+        for (int x = 0; x < roi.width(); ++x) {
+            QRgb pixel = line[roi.x() + x];
+            // 白色数字：三个通道都足够亮
+            int minChannel = std::min({qRed(pixel), qGreen(pixel), qBlue(pixel)});
+            mask[y * roi.width() + x] = (minChannel >= FOREGROUND_THRESHOLD) ? 1 : 0;
+        }
+    }
+    return mask;
+}
+
+QVector<DigitRecognizer::Component> DigitRecognizer::findComponents(QVector<quint8>& mask, int width, int height)
+{
+    QVector<Component> components;
+    QVector<int> stack;
+    stack.reserve(width * height);
+
+    for (int start = 0; start < mask.size(); ++start) {
+        if (mask[start] != 1) {
+            continue;
+        }
+
+        // 8连通泛洪，已访问像素标记为2
+        Component comp = {start % width, start / width, start % width, start / width};
+        mask[start] = 2;
+        stack.push_back(start);
+        while (!stack.isEmpty()) {
+            int index = stack.takeLast();
+            int cx = index % width;
+            int cy = index / width;
+            comp.left = std::min(comp.left, cx);
+            comp.right = std::max(comp.right, cx);
+            comp.top = std::min(comp.top, cy);
+            comp.bottom = std::max(comp.bottom, cy);
+
+            for (int dy = -1; dy <= 1; ++dy) {
+                for (int dx = -1; dx <= 1; ++dx) {
+                    int nx = cx + dx;
+                    int ny = cy + dy;
+                    if (nx < 0 || ny < 0 || nx >= width || ny >= height) {
+                        continue;
+                    }
+                    int neighbor = ny * width + nx;
+                    if (mask[neighbor] == 1) {
+                        mask[neighbor] = 2;
+                        stack.push_back(neighbor);
+                    }
+                }
+            }
+        }
+        components.push_back(comp);
+    }
+
+    // 按横坐标排序，并合并横向大部分重叠的碎片（同一字符被描边断开的情况）
+    // 只擦边的不合并，避免物品图案的高光把相邻数字吞掉
+    std::sort(components.begin(), components.end(),
+              [](const Component& a, const Component& b) { return a.left < b.left; });
+    QVector<Component> merged;
+    for (const Component& comp : components) {
+        const int overlap = merged.isEmpty() ? 0 : std::min(merged.last().right, comp.right) - comp.left + 1;
+        const int narrower = merged.isEmpty() ? 0 : std::min(merged.last().right - merged.last().left,
+                                                             comp.right - comp.left) + 1;
+        if (overlap > 0 && overlap * 2 >= narrower) {
+            Component& last = merged.last();
+            last.right = std::max(last.right, comp.right);
+            last.top = std::min(last.top, comp.top);
+            last.bottom = std::max(last.bottom, comp.bottom);
+        } else {
+            merged.push_back(comp);
+        }
+    }
+    return merged;
+}
+
+DigitRecognizer::Glyph DigitRecognizer::cropGlyph(const QVector<quint8>& mask, int width, const Component& comp)
+{
+    Glyph glyph;
+    glyph.width = comp.right - comp.left + 1;
+    glyph.height = comp.bottom - comp.top + 1;
+    glyph.bits.resize(glyph.width * glyph.height);
+    for (int y = 0; y < glyph.height; ++y) {
+        for (int x = 0; x < glyph.width; ++x) {
+            glyph.bits[y * glyph.width + x] = mask[(comp.top + y) * width + comp.left + x] ? 1 : 0;
+        }
+    }
+    return glyph;
+}
+
+int DigitRecognizer::matchGlyph(const Glyph& glyph) const
+{
+    int bestDigit = -1;
+    double bestRatio = 1.0;
+
+    for (int digit = 0; digit <= 9; ++digit) {
+        const Glyph& tpl = glyphTemplates[digit];
+        if (tpl.width == 0 || std::abs(tpl.height - glyph.height) > 2) {
+            continue;
+        }
+
+        // 最近邻缩放到模板尺寸后逐像素比较
+        int mismatch = 0;
+        for (int y = 0; y < tpl.height; ++y) {
+            int sy = y * glyph.height / tpl.height;
+            for (int x = 0; x < tpl.width; ++x) {
+                int sx = x * glyph.width / tpl.width;
+                mismatch += (glyph.at(sx, sy) != tpl.at(x, y));
+            }
+        }
+
+        double ratio = static_cast<double>(mismatch) / (tpl.width * tpl.height);
+        if (ratio < bestRatio) {
+            bestRatio = ratio;
+            bestDigit = digit;
+        }
+    }
+
+    return bestRatio <= MAX_MISMATCH_RATIO ? bestDigit : -1;
+}
+
+int DigitRecognizer::recognizeNumber(const QImage& image, const QRect& roi) const
+{
+    if (!glyphsLoaded || image.isNull()) {
+        return -1;
+    }
+
+    QRect area = roi.intersected(image.rect());
+    if (area.isEmpty()) {
+        return -1;
+    }
+
+    QVector<quint8> mask = binarize(image, area);
+    QVector<quint8> work = mask;
+    QVector<Component> comps = findComponents(work, area.width(), area.height());
+
+    int value = 0;
+    int digitCount = 0;
+    for (const Component& comp : comps) {
+        // 物品图案和绑定锁图标也是白色：贴着区域左右边界（被截断）、过矮或过宽的连通域不是数字
+        if (comp.left == 0 || comp.right == area.width() - 1 ||
+            comp.bottom - comp.top + 1 < MIN_GLYPH_HEIGHT || comp.right - comp.left + 1 > MAX_GLYPH_WIDTH) {
+            continue;
+        }
+
+        Glyph glyph = cropGlyph(mask, area.width(), comp);
+        int digit = matchGlyph(glyph);
+        if (digit < 0) {
+#ifdef DEBUG_BUILD
+            // 保存未识别的字形，便于补充模板
+            QString dirPath = QCoreApplication::applicationDirPath() + "/screenshots/digits";
+            QDir().mkpath(dirPath);
+            QRect glyphRect(area.x() + comp.left, area.y() + comp.top, glyph.width, glyph.height);
+            image.copy(glyphRect).save(QString("%1/unknown_%2.png").arg(dirPath)
+                .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss_zzz")));
+#endif
+            return -1;
+        }
+
+        value = value * 10 + digit;
+        digitCount++;
+    }
+
+    return digitCount > 0 ? value : -1;
+}
+
+int DigitRecognizer::recognizeSlotQuantity(const QImage& slotImage) const
+{
+    return recognizeNumber(slotImage, SLOT_QUANTITY_ROI);
+}
@@ -0,0 +1,59 @@
+#ifndef DIGITRECOGNIZER_H
+#define DIGITRECOGNIZER_H
+
+#include <QImage>
+#include <QRect>
+#include <QVector>
+#include <QString>
+
+// 数量数字识别器：识别物品栏格子（四叶草/香料）和配方格子右下角的堆叠数量
+// 流程：二值化 -> 连通域分割 -> 按字形模板逐个匹配，单个格子耗时为微秒级
+class DigitRecognizer {
+public:
+    // 数量文字在49x49格子内的区域（底部一整行，五位数会向左延伸到格子左侧）
+    static const QRect SLOT_QUANTITY_ROI;
+    // 二值化亮度阈值：数量文字为白色描边字，笔画边缘亮度在170~200之间
+    static constexpr int FOREGROUND_THRESHOLD = 170;
+    // 单个字符的最小高度（字形高8像素），过滤描边噪点和被区域截断的图标
+    static constexpr int MIN_GLYPH_HEIGHT = 7;
+    // 单个字符的最大宽度，更宽的连通域是物品图案的高光
+    static constexpr int MAX_GLYPH_WIDTH = 12;
+    // 字形匹配允许的最大不一致像素比例
+    static constexpr double MAX_MISMATCH_RATIO = 0.2;
+
+    DigitRecognizer();
+
+    // 从资源目录加载0-9字形模板（:/images/digits/0.png ~ 9.png）
+    bool loadGlyphTemplates(const QString& dirPath = ":/images/digits");
+    bool isLoaded() const { return glyphsLoaded; }
+
+    // 识别区域内的数字，失败返回-1
+    int recognizeNumber(const QImage& image, const QRect& roi) const;
+    // 识别49x49格子的堆叠数量，失败返回-1
+    int recognizeSlotQuantity(const QImage& slotImage) const;
+
+private:
+    // 二值字形
+    struct Glyph {
+        int width = 0;
+        int height = 0;
+        QVector<quint8> bits;   // 行优先，1为前景
+
+        quint8 at(int x, int y) const { return bits[y * width + x]; }
+    };
+
+    // 连通域外接矩形
+    struct Component {
+        int left, top, right, bottom;
+    };
+
+    static QVector<quint8> binarize(const QImage& image, const QRect& roi);
+    static QVector<Component> findComponents(QVector<quint8>& mask, int width, int height);
+    static Glyph cropGlyph(const QVector<quint8>& mask, int width, const Component& comp);
+    int matchGlyph(const Glyph& glyph) const;
+
+    Glyph glyphTemplates[10];
+    bool glyphsLoaded;
+};
+
+#endif // DIGITRECOGNIZER_H
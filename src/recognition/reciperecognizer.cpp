@@ -8,7 +8,6 @@
 #include <QDebug>
 #include <chrono>
 #include <algorithm>
-#include <windows.h>
 
 // 构造函数
 RecipeRecognizer::RecipeRecognizer() : recipeTemplatesLoaded(false), DPI(96)
@@ -20,105 +19,6 @@ RecipeRecognizer::~RecipeRecognizer()
 {
 }
 
-
-
-
-QImage RecipeRecognizer::captureWindowByHandle(void* hwnd, const QString& windowName)
-{
-    // 将void*转换为HWND
-    HWND hWnd = static_cast<HWND>(hwnd);
-    
-    // 检查窗口句柄有效性
-    if (!hWnd || !IsWindow(hWnd)) {
-        qDebug() << QString("无效的窗口句柄: %1").arg(windowName);
-        return QImage();
-    }
-
-    // 获取窗口位置和大小
-    RECT rect;
-    if(windowName == "主页面") // 主页面截图区域
-    {
-        rect.left = 0;
-        rect.top = 0;
-        rect.right = 950;
-        rect.bottom = 596;
-    }
-    else if (!GetWindowRect(hWnd, &rect)) {
-        qDebug() << QString("获取窗口位置失败: %1").arg(windowName);
-        return QImage();
-    }
-    
-    // 获取窗口DC
-    HDC hdcWindow = GetDC(hWnd);
-    if (!hdcWindow) {
-        qDebug() << QString("获取窗口DC失败: %1").arg(windowName);
-        return QImage();
-    }
-
-    // 创建兼容DC和位图
-    HDC hdcMemDC = CreateCompatibleDC(hdcWindow);
-    if (!hdcMemDC) {
-        qDebug() << QString("创建兼容DC失败: %1").arg(windowName);
-        ReleaseDC(hWnd, hdcWindow);
-        return QImage();
-    }
-
-    int width = rect.right - rect.left;
-    int height = rect.bottom - rect.top;
-    
-    HBITMAP hBitmap = CreateCompatibleBitmap(hdcWindow, width, height);
-    if (!hBitmap) {
-        qDebug() << QString("创建兼容位图失败: %1").arg(windowName);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hWnd, hdcWindow);
-        return QImage();
-    }
-
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMemDC, hBitmap);
-
-    // 复制窗口内容到位图
-    if (!BitBlt(hdcMemDC, 0, 0, width, height, hdcWindow, 0, 0, SRCCOPY)) {
-        qDebug() << QString("复制窗口内容失败: %1").arg(windowName);
-        SelectObject(hdcMemDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hWnd, hdcWindow);
-        return QImage();
-    }
-
-    // 转换为QImage
-    QImage image(width, height, QImage::Format_ARGB32_Premultiplied);
-    
-    // 设置BITMAPINFO结构
-    BITMAPINFO bmi;
-    ZeroMemory(&bmi, sizeof(BITMAPINFO));
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = width;
-    bmi.bmiHeader.biHeight = -height; // 负值表示自上而下的位图
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-
-    // 获取位图数据
-    if (!GetDIBits(hdcMemDC, hBitmap, 0, height, image.bits(), &bmi, DIB_RGB_COLORS)) {
-        qDebug() << QString("获取位图数据失败: %1").arg(windowName);
-        SelectObject(hdcMemDC, hOldBitmap);
-        DeleteObject(hBitmap);
-        DeleteDC(hdcMemDC);
-        ReleaseDC(hWnd, hdcWindow);
-        return QImage();
-    }
-
-    // 清理资源
-    SelectObject(hdcMemDC, hOldBitmap);
-    DeleteObject(hBitmap);
-    DeleteDC(hdcMemDC);
-    ReleaseDC(hWnd, hdcWindow);
-
-    qDebug() << QString("成功截取%1窗口图像：%2x%3").arg(windowName).arg(width).arg(height);
-    return image;
-}
-
 // 计算图像哈希值
 QString RecipeRecognizer::calculateImageHash(const QImage& image, const QRect& roi) const
 {
@@ -298,6 +198,7 @@ bool RecipeRecognizer::loadRecipeTemplates()
 {
     recipeTemplateHashes.clear();
     recipeTemplateImages.clear();
+    recipeRoiHashIndex.clear();
     
     // 从资源文件中动态读取配方模板
     QDir resourceDir(":/images/recipe");
@@ -329,6 +230,14 @@ bool RecipeRecognizer::loadRecipeTemplates()
         QString hash = calculateImageHash(template_image);
         recipeTemplateHashes[recipeType] = hash;
         
+        // 建立ROI哈希反向索引，整页识别时每个格子只需一次查表
+        QString roiHash = calculateImageHash(template_image.copy(RECIPE_ROI));
+        if (recipeRoiHashIndex.contains(roiHash)) {
+            qDebug() << "配方ROI哈希冲突:" << recipeType << "与" << recipeRoiHashIndex[roiHash];
+        } else {
+            recipeRoiHashIndex[roiHash] = recipeType;
+        }
+        
         // qDebug() << "成功加载配方模板:" << recipeType << "哈希值:" << hash;
     }
     
@@ -623,6 +532,42 @@ RecipeClickInfo RecipeRecognizer::recognizeRecipeInCurrentPage(const QImage& scr
     return RecipeClickInfo(false, QPoint(), 0.0);
 }
 
+QList<RecipeCellInfo> RecipeRecognizer::indexRecipesInCurrentPage(const QImage& screenshot) const
+{
+    QList<RecipeCellInfo> cells;
+    if (!recipeTemplatesLoaded || screenshot.isNull()) {
+        return cells;
+    }
+    
+    // 只识别上149像素内的完整格子
+    QImage recognitionArea = screenshot.copy(RECIPE_AREA_X, RECIPE_AREA_Y, RECIPE_AREA_WIDTH, RECIPE_RECOGNITION_HEIGHT);
+    QVector<int> xLines, yLines;
+    getRecipeGridLines(recognitionArea, xLines, yLines);
+    
+    for (int row = 0; row + 1 < yLines.size(); ++row) {
+        for (int col = 0; col + 1 < xLines.size(); ++col) {
+            int x0 = xLines[col];
+            int y0 = yLines[row];
+            int w = xLines[col + 1] - x0;
+            int h = yLines[row + 1] - y0;
+            if (w <= 0 || h <= 0) continue;
+            
+            QImage gridROI = recognitionArea.copy(QRect(x0, y0, w, h)).copy(RECIPE_ROI);
+            if (gridROI.isNull()) continue;
+            
+            auto it = recipeRoiHashIndex.constFind(calculateImageHash(gridROI));
+            if (it == recipeRoiHashIndex.constEnd()) continue;
+            
+            RecipeCellInfo cell;
+            cell.name = it.value();
+            cell.clickPosition = QPoint(RECIPE_AREA_X + x0 + 24, RECIPE_AREA_Y + y0 + 24);
+            cells.append(cell);
+        }
+    }
+    
+    return cells;
+}
+
 void RecipeRecognizer::drawDebugGridLines(QImage& debugImage, int startY) {
     QPainter painter(&debugImage);
     painter.setPen(QPen(Qt::red, 2));
@@ -792,9 +737,9 @@ bool RecipeRecognizer::findFirstCompleteLine(const QImage& image, int& outY) {
 }
 
 // 动态配方识别方法 - 每10ms识别一次，匹配度<1时立即返回进行翻页
-RecipeClickInfo RecipeRecognizer::dynamicRecognizeRecipe(void* hwnd, const QString& windowName, const QString& targetRecipe)
+RecipeClickInfo RecipeRecognizer::dynamicRecognizeRecipe(FrameSource& source, const QString& targetRecipe)
 {
-    qDebug() << QString("开始动态配方识别: 目标=%1, 窗口=%2").arg(targetRecipe).arg(windowName);
+    qDebug() << QString("开始动态配方识别: 目标=%1").arg(targetRecipe);
     
     // 检查配方模板是否加载
     if (!recipeTemplatesLoaded || !recipeTemplateHashes.contains(targetRecipe)) {
@@ -831,16 +776,15 @@ RecipeClickInfo RecipeRecognizer::dynamicRecognizeRecipe(void* hwnd, const QStri
         attemptCount++;
         
         // 截取当前窗口图像（覆盖前一次截图以节省内存）
-        QImage currentScreenshot = captureWindowByHandle(hwnd, windowName);
+        QImage currentScreenshot = source.grab();
         previousScreenshot = QImage(); // 释放前一次截图内存
         
         if (currentScreenshot.isNull()) {
             qDebug() << QString("第%1次截图失败，继续尝试...").arg(attemptCount);
-            // 使用类似sleepByQElapsedTimer的方式避免卡住
-            QElapsedTimer intervalTimer;
-            intervalTimer.start();
-            while (intervalTimer.elapsed() < RECOGNITION_INTERVAL_MS) {
-                QCoreApplication::processEvents(); // 保持程序响应
+            if (sleeper) {
+                sleeper(RECOGNITION_INTERVAL_MS);
+            } else {
+                QThread::msleep(RECOGNITION_INTERVAL_MS);
             }
             continue;
         }
@@ -890,11 +834,11 @@ RecipeClickInfo RecipeRecognizer::dynamicRecognizeRecipe(void* hwnd, const QStri
         }
         
         // 如果有一定相似度但未达到阈值，继续等待
-        // 使用类似sleepByQElapsedTimer的方式避免卡住
-        QElapsedTimer intervalTimer;
-        intervalTimer.start();
-        while (intervalTimer.elapsed() < RECOGNITION_INTERVAL_MS) {
-            QCoreApplication::processEvents(); // 保持程序响应
+        // 等待期间不空转，停止强化时立即返回
+        if (sleeper) {
+            sleeper(RECOGNITION_INTERVAL_MS);
+        } else {
+            QThread::msleep(RECOGNITION_INTERVAL_MS);
         }
         
         // 将当前截图保存到previousScreenshot以便下次覆盖
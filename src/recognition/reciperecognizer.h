@@ -20,6 +20,8 @@
 #include <QElapsedTimer>
 #include <QWindow>  // Qt中包含Windows类型定义
 #include <chrono>
+#include <functional>
+#include "../core/framesource.h"
 
 
 
@@ -34,6 +36,18 @@ struct RecipeClickInfo {
         : found(f), clickPosition(pos), similarity(sim) {}
 };
 
+// 单个配方格子的识别结果
+struct RecipeCellInfo {
+    QString name;                // 配方名称
+    QPoint clickPosition;        // 点击位置坐标（游戏窗口坐标）
+};
+
+// 配方位置索引项
+struct RecipeLocation {
+    int scrollBarPosition = 0;   // 配方所在页的滚动条位置
+    QPoint clickPosition;        // 配方在该页的点击位置
+};
+
 class RecipeRecognizer {
 public:
     // 常量定义
@@ -58,7 +72,7 @@ public:
     ~RecipeRecognizer();
 
     // 现有的网格线相关方法
-    void getRecipeGridLines(const QImage& recipeArea, QVector<int>& xLines, QVector<int>& yLines);
+    static void getRecipeGridLines(const QImage& recipeArea, QVector<int>& xLines, QVector<int>& yLines);
     void debugGridLines(const QImage& source);
     void drawDebugGridLines(QImage& debugImage, int startY);
     static bool isGridLineColor(const QColor& color);
@@ -89,14 +103,20 @@ public:
     RecipeClickInfo recognizeRecipeInGrid(const QImage& screenshot, const QString& targetRecipe);
     RecipeClickInfo recognizeRecipeInCurrentPage(const QImage& screenshot, const QString& targetRecipe);
     
+    // 一次遍历当前页面所有配方格子，与全部配方模板比对
+    QList<RecipeCellInfo> indexRecipesInCurrentPage(const QImage& screenshot) const;
+    
     // 动态识别方法 - 每10ms识别一次，匹配度<1时立即下一次，2秒超时
-    RecipeClickInfo dynamicRecognizeRecipe(void* hwnd, const QString& windowName, const QString& targetRecipe);
+    RecipeClickInfo dynamicRecognizeRecipe(FrameSource& source, const QString& targetRecipe);
     
     QStringList getAvailableRecipeTypes() const;
     
     // 获取配方模板哈希值
     QString getRecipeHash(const QString& recipeName) const;
 
+    // 动态识别两次识别之间的等待，由调用方提供可中断的实现；未设置时直接休眠
+    void setSleeper(std::function<void(int ms)> sleeperFunction) { sleeper = std::move(sleeperFunction); }
+
     // 设置DPI值
     void setDPI(int dpi) { DPI = dpi; }
     int getDPI() const { return DPI; }
@@ -111,14 +131,14 @@ private:
     // 配方模板数据
     QMap<QString, QImage> recipeTemplateImages;        // 配方模板图像
     QMap<QString, QString> recipeTemplateHashes;       // 配方模板哈希值 (替代直方图)
+    QHash<QString, QString> recipeRoiHashIndex;        // 配方ROI哈希值 -> 配方名称（整页索引用）
     // QMap<QString, QVector<double>> recipeTemplateHistograms; // 配方模板直方图 (已弃用)
     bool recipeTemplatesLoaded;                        // 模板是否已加载
     
     // DPI设置
     int DPI;
 
-    // 内部辅助方法
-    QImage captureWindowByHandle(void* hwnd, const QString& windowName);
+    std::function<void(int ms)> sleeper;
 };
 
 #endif // RECIPERECOGNIZER_H 
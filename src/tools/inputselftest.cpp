@@ -0,0 +1,85 @@
+// 输入端自测：记录输入端按顺序记下点击和拖动，限流输入端只合并标记为幂等、且画面没有变化的重复点击
+// 用法：input_selftest
+#include "../core/inputsink.h"
+#include <QCoreApplication>
+#include <QVector>
+#include <cstdio>
+
+namespace {
+
+bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "失败：%s\n", what);
+    }
+    return condition;
+}
+
+// 记录一段典型操作：点击制卡按钮、拖动滚动条、点击配方，序列和参数必须与发出的一致
+bool testRecordingSequence()
+{
+    RecordingInputSink recorder;
+    recorder.click(QPoint(287, 427));
+    recorder.drag(QPoint(910, 120), 84, true);
+    recorder.drag(QPoint(910, 204), 30, false);
+    recorder.clickIdempotent(QPoint(532, 539));
+
+    const QVector<InputEvent> events = recorder.events();
+    bool ok = check(events.size() == 4, "应记录4条输入");
+    if (!ok) {
+        return false;
+    }
+    ok = check(events[0].type == InputEvent::Click && events[0].position == QPoint(287, 427), "第1条为点击(287,427)") && ok;
+    ok = check(events[1].type == InputEvent::Drag && events[1].position == QPoint(910, 120)
+               && events[1].distance == 84 && events[1].downward, "第2条为从(910,120)向下拖动84") && ok;
+    ok = check(events[2].type == InputEvent::Drag && events[2].position == QPoint(910, 204)
+               && events[2].distance == 30 && !events[2].downward, "第3条为从(910,204)向上拖动30") && ok;
+    ok = check(events[3].type == InputEvent::Click && events[3].position == QPoint(532, 539), "第4条为点击(532,539)") && ok;
+    for (int i = 1; i < events.size(); ++i) {
+        ok = check(events[i].timestamp >= events[i - 1].timestamp, "时间戳不递减") && ok;
+    }
+
+    recorder.clear();
+    return check(recorder.events().isEmpty(), "clear后没有记录") && ok;
+}
+
+// 画面计数不变时：普通点击全部发出，幂等点击只发第一次；画面变化后幂等点击再次发出
+bool testCoalescing()
+{
+    RecordingInputSink target;
+    quint64 changes = 0;
+    RateLimitedInputSink limiter(&target, 1000.0, 10, 10000);
+    limiter.setChangeCounter([&changes]() { return changes; });
+
+    limiter.click(QPoint(288, 360));
+    limiter.click(QPoint(288, 360));
+    bool ok = check(target.events().size() == 2, "重试的普通点击不能被合并");
+
+    limiter.clickIdempotent(QPoint(532, 539));
+    limiter.clickIdempotent(QPoint(532, 539));
+    ok = check(target.events().size() == 3, "画面未变化时重复的幂等点击应合并") && ok;
+
+    changes++;
+    limiter.clickIdempotent(QPoint(532, 539));
+    ok = check(target.events().size() == 4, "画面变化后幂等点击应发出") && ok;
+
+    limiter.drag(QPoint(910, 120), 50, true);
+    limiter.clickIdempotent(QPoint(532, 539));
+    ok = check(target.events().size() == 6, "拖动后幂等点击应发出") && ok;
+
+    const RateLimitedInputSink::Stats stats = limiter.stats();
+    ok = check(stats.sent == 6 && stats.coalesced == 1, "统计应为发送6次、合并1次") && ok;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const bool recording = testRecordingSequence();
+    const bool coalescing = testCoalescing();
+    const bool ok = recording && coalescing;
+    std::printf("输入端自测%s\n", ok ? "通过" : "失败");
+    return ok ? 0 : 1;
+}
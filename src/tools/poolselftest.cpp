@@ -0,0 +1,131 @@
+// 截图缓冲池自测：预热后连续截图N次，FrameBufferPool的新分配次数不能增长，只有复用次数增长
+// 覆盖同步截图（grabInto + 多区域截图）和异步截图线程两条路径，消费者始终持有上一帧模拟识别线程的用法
+// 用法：pool_selftest
+#include "../core/asynccapturesource.h"
+#include "../core/framebufferpool.h"
+#include "../core/framesource.h"
+#include <QCoreApplication>
+#include <QImage>
+#include <QVector>
+#include <cstdio>
+
+namespace {
+
+const int WARMUP_CAPTURES = 20;
+const int MEASURED_CAPTURES = 200;
+const QSize GAME_SIZE(950, 596);
+
+// 替身帧源：每次返回同一尺寸的画面，左上角像素随截图次数变化，模拟实时截图不断产生新画面
+class PatternFrameSource : public FrameSource
+{
+public:
+    PatternFrameSource() : frame(GAME_SIZE, QImage::Format_ARGB32_Premultiplied)
+    {
+        frame.fill(qRgb(0, 45, 81));
+    }
+
+    QImage grab() override
+    {
+        frame.setPixel(0, 0, qRgb(0, 0, int(++count & 0xff)));
+        return frame;
+    }
+    qint64 timestamp() const override { return count; }
+
+private:
+    QImage frame;
+    qint64 count = 0;
+};
+
+bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "失败：%s\n", what);
+    }
+    return condition;
+}
+
+// 同步截图：整帧写入复用的句柄，同时截取两个检测区域，上一帧的QImage保留到下一次截图之后
+bool testSynchronousCaptures()
+{
+    PatternFrameSource source;
+    const QVector<QRect> regions = {QRect(287, 427, 40, 20), QRect(270, 356, 20, 20)};
+    FrameHandle handle;
+    QImage previous;
+    auto captureOnce = [&]() {
+        if (!source.grabInto(handle)) {
+            return false;
+        }
+        const QImage current = handle.toImage();
+        const RegionFrame regionFrame = source.grabRegions(regions);
+        previous = current;
+        return !regionFrame.isNull() && !current.isNull();
+    };
+
+    bool ok = true;
+    for (int i = 0; i < WARMUP_CAPTURES; ++i) {
+        ok = captureOnce() && ok;
+    }
+    const FrameBufferPool::Stats before = FrameBufferPool::shared().stats();
+    for (int i = 0; i < MEASURED_CAPTURES; ++i) {
+        ok = captureOnce() && ok;
+    }
+    const FrameBufferPool::Stats after = FrameBufferPool::shared().stats();
+
+    ok = check(ok, "同步截图失败") && ok;
+    ok = check(after.allocations == before.allocations, "同步截图预热后不应再新分配缓冲区") && ok;
+    ok = check(after.reuses > before.reuses, "同步截图应从池中复用缓冲区") && ok;
+    std::printf("同步截图%d次：新分配%llu次，复用%llu次\n", MEASURED_CAPTURES,
+                static_cast<unsigned long long>(after.allocations - before.allocations),
+                static_cast<unsigned long long>(after.reuses - before.reuses));
+    return ok;
+}
+
+// 异步截图：截图线程按1毫秒间隔写入三缓冲，消费者每次等到新帧再取，持有的帧不被改写
+bool testAsyncCaptures()
+{
+    PatternFrameSource inner;
+    AsyncCaptureSource source(&inner, 1, GAME_SIZE);
+    source.startCapture();
+
+    QImage previous;
+    quint64 lastSequence = 0;
+    auto captureOnce = [&]() {
+        if (!source.waitForFrameAfter(lastSequence, 1000)) {
+            return false;
+        }
+        const QImage current = source.grab();
+        lastSequence = source.sequence();
+        previous = current;
+        return !current.isNull();
+    };
+
+    bool ok = true;
+    for (int i = 0; i < WARMUP_CAPTURES; ++i) {
+        ok = captureOnce() && ok;
+    }
+    const FrameBufferPool::Stats before = FrameBufferPool::shared().stats();
+    for (int i = 0; i < MEASURED_CAPTURES; ++i) {
+        ok = captureOnce() && ok;
+    }
+    const FrameBufferPool::Stats after = FrameBufferPool::shared().stats();
+    source.stopCapture();
+
+    ok = check(ok, "异步截图等待新帧超时") && ok;
+    ok = check(after.allocations == before.allocations, "异步截图预热后不应再新分配缓冲区") && ok;
+    std::printf("异步截图%d次：新分配%llu次，复用%llu次\n", MEASURED_CAPTURES,
+                static_cast<unsigned long long>(after.allocations - before.allocations),
+                static_cast<unsigned long long>(after.reuses - before.reuses));
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const bool synchronous = testSynchronousCaptures();
+    const bool async = testAsyncCaptures();
+    const bool ok = synchronous && async;
+    std::printf("截图缓冲池自测%s\n", ok ? "通过" : "失败");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,377 @@
+// 回放基准：在录制的会话（.fvmsession）、帧归档（.fvar）或帧目录上逐帧运行识别器，统计每个识别器的耗时
+// 用法：replay_benchmark <录制文件或目录>
+//       replay_benchmark --self-test  用内置的合成屋截图生成归档和会话，检查原图和回放后的识别结果都与已知的卡片、配方和物品数量一致
+//       replay_benchmark --import <会话文件> <归档文件>  把会话中的帧追加到归档
+#include "../core/framearchive.h"
+#include "../core/framesource.h"
+#include "../core/sessionrecorder.h"
+#include "../recognition/cardrecognizer.h"
+#include "../recognition/digitrecognizer.h"
+#include "../recognition/reciperecognizer.h"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QVector>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+// 与StarryCard::ITEM_STRIP_AREA一致：物品栏10个49x49格子
+const QRect ITEM_STRIP_AREA(33, 526, 490, 49);
+const int ITEM_SLOT_SIZE = 49;
+const QSize GAME_SIZE(950, 596);
+
+// 自测画面中贴模板的位置：背包区与CardRecognizer一致，顶部一行分隔线后是卡片格子；
+// 配方区与RecipeRecognizer一致，横格线之间一行49像素的格子，每格只比较(4,4,38,24)区域
+const QRect PANEL_AREA(555, 88, 365, 460); // 背包区和配方区所在的面板，贴模板前整体涂黑
+const QRect CARD_AREA(559, 91, 343, 456);
+const QRgb CARD_SEPARATOR = qRgb(0, 45, 81);
+const QPoint RECIPE_AREA_ORIGIN(555, 88);
+const QRgb RECIPE_GRID_LINE = qRgb(27, 53, 74);
+const QRect RECIPE_ROI(4, 4, 38, 24);
+const int RECIPE_GRID_START = 4;
+const int GRID_STEP = 49;
+// 合成屋截图物品栏上印的数量；第一格四叶草图案与数字粘连读不出来，只允许返回-1，不允许读错
+const QVector<int> STRIP_QUANTITIES = {-1, 150, 754, 241, 405, 11217, 408, 13606, 7946, 1594};
+// 卡片和配方模板中各挑7个，配方的ROI哈希两两相差较远，不会被索引成别的配方
+const QStringList SYNTHETIC_TEMPLATES = {"中卡：冰冻小笼包", "中卡：冰激凌", "中卡：换气扇", "中卡：汉堡包",
+                                        "中卡：火盆", "中卡：猫猫盒", "中卡：鱼刺"};
+
+struct Recognizers {
+    CardRecognizer cards;
+    RecipeRecognizer recipes;
+    DigitRecognizer digits;
+    QStringList cardTypes;
+
+    bool load()
+    {
+        const bool ok = cards.loadTemplates() && recipes.loadRecipeTemplates() && digits.loadGlyphTemplates();
+        cardTypes = cards.getRegisteredCards();
+        return ok;
+    }
+};
+
+// 一帧的识别结果，回放前后逐项比较
+struct FrameResult {
+    int cardCount = 0;
+    QStringList recipes;
+    QVector<int> quantities;
+
+    bool operator==(const FrameResult& other) const
+    {
+        return cardCount == other.cardCount && recipes == other.recipes && quantities == other.quantities;
+    }
+};
+
+struct Timing {
+    qint64 totalUs = 0;
+    qint64 maxUs = 0;
+
+    void add(qint64 us)
+    {
+        totalUs += us;
+        maxUs = qMax(maxUs, us);
+    }
+};
+
+struct Timings {
+    Timing cards;
+    Timing recipes;
+    Timing digits;
+};
+
+FrameResult recognize(Recognizers& recognizers, const QImage& frame, Timings* timings = nullptr)
+{
+    FrameResult result;
+    QElapsedTimer timer;
+
+    timer.start();
+    result.cardCount = recognizers.cards.recognizeCards(frame, recognizers.cardTypes).size();
+    if (timings) {
+        timings->cards.add(timer.nsecsElapsed() / 1000);
+    }
+
+    timer.restart();
+    for (const RecipeCellInfo& cell : recognizers.recipes.indexRecipesInCurrentPage(frame)) {
+        result.recipes.append(cell.name);
+    }
+    if (timings) {
+        timings->recipes.add(timer.nsecsElapsed() / 1000);
+    }
+
+    timer.restart();
+    for (int x = ITEM_STRIP_AREA.left(); x + ITEM_SLOT_SIZE <= ITEM_STRIP_AREA.right() + 1; x += ITEM_SLOT_SIZE) {
+        const QImage slot = frame.copy(x, ITEM_STRIP_AREA.top(), ITEM_SLOT_SIZE, ITEM_SLOT_SIZE);
+        result.quantities.append(recognizers.digits.recognizeSlotQuantity(slot));
+    }
+    if (timings) {
+        timings->digits.add(timer.nsecsElapsed() / 1000);
+    }
+    return result;
+}
+
+void printTiming(const char* name, const Timing& timing, int frames)
+{
+    std::printf("%-12s 平均 %8.1f us  最长 %8lld us\n", name,
+                frames > 0 ? double(timing.totalUs) / frames : 0.0, static_cast<long long>(timing.maxUs));
+}
+
+// 把会话录制中的帧追加到帧归档，异常会话导出后可以收进回归语料
+int importSession(const QString& sessionPath, const QString& archivePath)
+{
+    FrameArchiveWriter writer(archivePath);
+    if (!writer.open()) {
+        std::fprintf(stderr, "无法打开归档: %s\n", qPrintable(archivePath));
+        return 1;
+    }
+    const int appended = writer.appendSession(sessionPath);
+    std::printf("%s：追加%d帧，归档共%d帧\n", qPrintable(archivePath), appended, writer.frameCount());
+    return appended > 0 ? 0 : 1;
+}
+
+int runBenchmark(const QString& path)
+{
+    std::unique_ptr<FrameSource> source = openRecordedFrames(path, false);
+    if (!source) {
+        std::fprintf(stderr, "无法打开录制文件: %s\n", qPrintable(path));
+        return 1;
+    }
+
+    Recognizers recognizers;
+    if (!recognizers.load()) {
+        std::fprintf(stderr, "识别模板加载失败\n");
+        return 1;
+    }
+
+    Timings timings;
+    int frames = 0;
+    while (!source->atEnd()) {
+        const QImage frame = source->grab();
+        if (frame.isNull()) {
+            break;
+        }
+        recognize(recognizers, frame, &timings);
+        frames++;
+    }
+
+    std::printf("%s：%d帧\n", qPrintable(path), frames);
+    printTiming("卡片识别", timings.cards, frames);
+    printTiming("配方索引", timings.recipes, frames);
+    printTiming("物品数量", timings.digits, frames);
+    return frames > 0 ? 0 : 1;
+}
+
+void fillArea(QImage& frame, const QRect& area, QRgb color)
+{
+    for (int y = area.top(); y <= area.bottom(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(frame.scanLine(y));
+        std::fill(line + area.left(), line + area.right() + 1, color);
+    }
+}
+
+void pasteImage(QImage& frame, const QImage& image, const QPoint& at)
+{
+    const QImage converted = image.convertToFormat(frame.format());
+    for (int y = 0; y < converted.height(); ++y) {
+        memcpy(frame.scanLine(at.y() + y) + at.x() * 4, converted.constScanLine(y), converted.width() * 4);
+    }
+}
+
+// 背包画面：面板涂黑后画分隔线，第一行贴7张卡片模板，应识别出7张卡、没有配方
+bool makeBackpackFrame(QImage& frame)
+{
+    fillArea(frame, PANEL_AREA, qRgb(0, 0, 0));
+    fillArea(frame, QRect(CARD_AREA.left(), CARD_AREA.top(), CARD_AREA.width(), 1), CARD_SEPARATOR);
+    for (int i = 0; i < SYNTHETIC_TEMPLATES.size(); ++i) {
+        const QImage card(QString(":/images/card/%1.png").arg(SYNTHETIC_TEMPLATES[i]));
+        if (card.isNull()) {
+            return false;
+        }
+        pasteImage(frame, card, QPoint(CARD_AREA.left() + i * GRID_STEP, CARD_AREA.top() + 1));
+    }
+    return true;
+}
+
+// 配方画面：面板涂黑后画两条横格线，格子里按顺序贴7个配方模板的ROI，应按顺序识别出7个配方、没有卡片
+bool makeRecipeFrame(QImage& frame)
+{
+    fillArea(frame, PANEL_AREA, qRgb(0, 0, 0));
+    for (int y : {0, GRID_STEP}) {
+        fillArea(frame, QRect(PANEL_AREA.left(), RECIPE_AREA_ORIGIN.y() + y, PANEL_AREA.width(), 1), RECIPE_GRID_LINE);
+    }
+    for (int i = 0; i < SYNTHETIC_TEMPLATES.size(); ++i) {
+        const QImage recipe(QString(":/images/recipe/%1.png").arg(SYNTHETIC_TEMPLATES[i]));
+        if (recipe.isNull()) {
+            return false;
+        }
+        const QPoint cell = RECIPE_AREA_ORIGIN + QPoint(RECIPE_GRID_START + i * GRID_STEP, 0);
+        pasteImage(frame, recipe.copy(RECIPE_ROI), cell + RECIPE_ROI.topLeft());
+    }
+    return true;
+}
+
+// 逐帧回放source，识别结果必须与预期一致
+bool replayMatches(FrameSource& source, Recognizers& recognizers, const QVector<QImage>& originals,
+                   const QVector<FrameResult>& expected, const char* name)
+{
+    for (int i = 0; i < originals.size(); ++i) {
+        if (source.atEnd()) {
+            std::fprintf(stderr, "%s：只回放出%d帧，应为%d帧\n", name, i, int(originals.size()));
+            return false;
+        }
+        const QImage frame = source.grab();
+        if (frame != originals[i]) {
+            std::fprintf(stderr, "%s：第%d帧像素与原图不一致\n", name, i);
+            return false;
+        }
+        if (!(recognize(recognizers, frame) == expected[i])) {
+            std::fprintf(stderr, "%s：第%d帧识别结果与原图不一致\n", name, i);
+            return false;
+        }
+    }
+    return source.atEnd();
+}
+
+int runSelfTest()
+{
+    Recognizers recognizers;
+    if (!recognizers.load()) {
+        std::fprintf(stderr, "识别模板加载失败\n");
+        return 1;
+    }
+
+    // 合成屋截图为1.5倍缩放，缩回游戏窗口尺寸后在面板上贴模板，卡片和配方的识别结果是确定的；
+    // 第二帧与第一帧相同（归档写引用记录），第三帧换成配方格子并涂黑物品栏
+    QImage base(":/images/gameImage/SyntheticHouse.png");
+    if (base.isNull()) {
+        std::fprintf(stderr, "内置截图加载失败\n");
+        return 1;
+    }
+    base = base.scaled(GAME_SIZE, Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+               .convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    QImage backpack = base.copy();
+    QImage changed = base.copy();
+    changed.fill(Qt::black);
+    for (int y = 0; y < ITEM_STRIP_AREA.top(); ++y) {
+        memcpy(changed.scanLine(y), base.constScanLine(y), base.bytesPerLine());
+    }
+    if (!makeBackpackFrame(backpack) || !makeRecipeFrame(changed)) {
+        std::fprintf(stderr, "卡片或配方模板加载失败\n");
+        return 1;
+    }
+    const QVector<QImage> originals = {backpack, backpack, changed};
+
+    // 第三帧物品栏涂黑，每格都应返回-1
+    QVector<FrameResult> expected(originals.size());
+    expected[0].cardCount = SYNTHETIC_TEMPLATES.size();
+    expected[0].quantities = STRIP_QUANTITIES;
+    expected[1] = expected[0];
+    expected[2].recipes = SYNTHETIC_TEMPLATES;
+    expected[2].quantities = QVector<int>(STRIP_QUANTITIES.size(), -1);
+    for (int i = 0; i < originals.size(); ++i) {
+        const FrameResult actual = recognize(recognizers, originals[i]);
+        if (actual.cardCount != expected[i].cardCount || actual.recipes != expected[i].recipes) {
+            std::fprintf(stderr, "第%d帧原图识别出卡片%d张、配方%d个，应为%d张、%d个\n", i, actual.cardCount,
+                         int(actual.recipes.size()), expected[i].cardCount, int(expected[i].recipes.size()));
+            return 1;
+        }
+        for (int slot = 0; slot < expected[i].quantities.size(); ++slot) {
+            const int quantity = slot < actual.quantities.size() ? actual.quantities[slot] : -2;
+            if (quantity != expected[i].quantities[slot]) {
+                std::fprintf(stderr, "第%d帧物品栏第%d格识别为%d，应为%d\n", i, slot + 1, quantity,
+                             expected[i].quantities[slot]);
+                return 1;
+            }
+        }
+    }
+    const int recognizedSlots = int(std::count_if(STRIP_QUANTITIES.begin(), STRIP_QUANTITIES.end(),
+                                                  [](int quantity) { return quantity >= 0; }));
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        std::fprintf(stderr, "无法创建临时目录\n");
+        return 1;
+    }
+
+    const QString sessionPath = dir.filePath("selftest.fvmsession");
+    {
+        SessionRecorder recorder(4096, 200, 0);
+        for (const QImage& frame : originals) {
+            recorder.recordFrame(frame);
+            recorder.recordClick(100, 100);
+        }
+        if (!recorder.dump(sessionPath)) {
+            std::fprintf(stderr, "会话导出失败\n");
+            return 1;
+        }
+    }
+
+    // 归档先写第一帧，再模拟写记录中途退出留下半条记录；续写时应截掉半条记录，再把整个会话追加进来
+    const QString archivePath = dir.filePath("selftest.fvar");
+    {
+        FrameArchiveWriter writer(archivePath);
+        if (!writer.open() || writer.append(originals[0], "selftest") != 0) {
+            std::fprintf(stderr, "归档创建失败\n");
+            return 1;
+        }
+    }
+    {
+        QFile archive(archivePath);
+        if (!archive.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            std::fprintf(stderr, "无法打开归档\n");
+            return 1;
+        }
+        const char partial[] = {char(FrameArchiveFormat::FrameRecord), char(0x40), 0, 0, 0, 1, 2, 3};
+        archive.write(partial, sizeof(partial));
+    }
+    {
+        FrameArchiveWriter writer(archivePath);
+        if (!writer.open() || writer.appendSession(sessionPath, "selftest") != originals.size()) {
+            std::fprintf(stderr, "会话追加到归档失败\n");
+            return 1;
+        }
+    }
+    const QVector<QImage> archived = QVector<QImage>{originals[0]} + originals;
+    const QVector<FrameResult> archivedExpected = QVector<FrameResult>{expected[0]} + expected;
+
+    bool ok = true;
+    for (const QString& path : {archivePath, sessionPath}) {
+        std::unique_ptr<FrameSource> source = openRecordedFrames(path, false);
+        if (!source) {
+            std::fprintf(stderr, "无法打开%s\n", qPrintable(path));
+            ok = false;
+            continue;
+        }
+        const bool isArchive = (path == archivePath);
+        ok = replayMatches(*source, recognizers, isArchive ? archived : originals,
+                           isArchive ? archivedExpected : expected, qPrintable(path)) && ok;
+    }
+
+    std::printf("回放自测%s：物品栏识别出%d个数量，卡片%d张，配方%d个\n", ok ? "通过" : "失败",
+                recognizedSlots, expected[0].cardCount, int(expected[2].recipes.size()));
+    return ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() == 4 && args[1] == "--import") {
+        return importSession(args[2], args[3]);
+    }
+    if (args.size() != 2) {
+        std::fprintf(stderr, "用法: replay_benchmark <录制文件或目录> | --self-test | --import <会话文件> <归档文件>\n");
+        return 2;
+    }
+    if (args[1] == "--self-test") {
+        return runSelfTest();
+    }
+    return runBenchmark(args[1]);
+}
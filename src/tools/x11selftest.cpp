@@ -0,0 +1,236 @@
+// X11后端自测：在Xvfb（或任意X服务器）中创建一个游戏窗口大小的替身窗口，把画面贴到窗口上，
+// 用X11FrameSource截图逐像素比较，再用X11InputSink发送点击和拖动，检查窗口收到的鼠标事件
+// 用法：x11_selftest [录制文件或目录]  指定录制文件时逐帧贴录制的画面，否则使用生成的测试图案
+#include "../core/framesource.h"
+#include "../core/inputsink.h"
+#include "../core/x11framesource.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QStringList>
+#include <QThread>
+#include <QVector>
+#include <cstdio>
+#include <cstring>
+// Xlib的宏（None、Bool、Status等）会与Qt冲突，放在所有Qt头文件之后
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+namespace {
+
+const int WINDOW_WIDTH = 950;
+const int WINDOW_HEIGHT = 596;
+const int EVENT_TIMEOUT_MS = 1000;
+
+// 生成的测试图案：横向渐变叠加格线，每个像素的颜色随坐标变化，错位和通道顺序错误都能发现
+QImage makePattern()
+{
+    QImage image(WINDOW_WIDTH, WINDOW_HEIGHT, QImage::Format_RGB32);
+    for (int y = 0; y < image.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+        for (int x = 0; x < image.width(); ++x) {
+            const bool grid = (x % 49 == 0) || (y % 49 == 0);
+            line[x] = grid ? qRgb(255, 255, 255) : qRgb(x & 0xff, y & 0xff, (x + y) & 0xff);
+        }
+    }
+    return image;
+}
+
+// 游戏窗口替身：无边框顶层窗口，画面设为窗口背景，X服务器重绘时不需要客户端参与
+class StandInWindow
+{
+public:
+    bool create()
+    {
+        display = XOpenDisplay(nullptr);
+        if (!display) {
+            return false;
+        }
+        const int screen = DefaultScreen(display);
+        if (DefaultDepth(display, screen) != 24) {
+            std::fprintf(stderr, "X服务器色深为%d，需要24位（xvfb-run -s \"-screen 0 1280x1024x24\"）\n",
+                         DefaultDepth(display, screen));
+            return false;
+        }
+        XSetWindowAttributes attributes{};
+        attributes.override_redirect = True;
+        attributes.event_mask = ButtonPressMask | ButtonReleaseMask | StructureNotifyMask;
+        window = XCreateWindow(display, RootWindow(display, screen), 40, 30, WINDOW_WIDTH, WINDOW_HEIGHT, 0,
+                               CopyFromParent, InputOutput, CopyFromParent, CWOverrideRedirect | CWEventMask,
+                               &attributes);
+        XMapRaised(display, window);
+        XEvent event;
+        do {
+            XWindowEvent(display, window, StructureNotifyMask, &event);
+        } while (event.type != MapNotify);
+        return true;
+    }
+
+    ~StandInWindow()
+    {
+        if (display) {
+            if (window) {
+                XDestroyWindow(display, window);
+            }
+            XCloseDisplay(display);
+        }
+    }
+
+    void show(const QImage& frame)
+    {
+        QImage image = frame.convertToFormat(QImage::Format_RGB32);
+        const int screen = DefaultScreen(display);
+        XImage* ximage = XCreateImage(display, DefaultVisual(display, screen), 24, ZPixmap, 0,
+                                      reinterpret_cast<char*>(image.bits()), image.width(), image.height(), 32,
+                                      image.bytesPerLine());
+        const Pixmap pixmap = XCreatePixmap(display, window, image.width(), image.height(), 24);
+        const GC gc = XCreateGC(display, pixmap, 0, nullptr);
+        XPutImage(display, pixmap, gc, ximage, 0, 0, 0, 0, image.width(), image.height());
+        XSetWindowBackgroundPixmap(display, window, pixmap);
+        XClearWindow(display, window);
+        XFreeGC(display, gc);
+        XFreePixmap(display, pixmap);
+        ximage->data = nullptr; // 像素属于QImage
+        XDestroyImage(ximage);
+        XSync(display, False);
+    }
+
+    // 等待下一个鼠标按键事件，超时返回false
+    bool nextButtonEvent(int& type, QPoint& position)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < EVENT_TIMEOUT_MS) {
+            XEvent event;
+            if (XCheckWindowEvent(display, window, ButtonPressMask | ButtonReleaseMask, &event)) {
+                type = event.type;
+                position = QPoint(event.xbutton.x, event.xbutton.y);
+                return true;
+            }
+            QThread::msleep(5);
+        }
+        return false;
+    }
+
+    Display* display = nullptr;
+    Window window = 0;
+};
+
+bool framesMatch(const QImage& captured, const QImage& expected, int index)
+{
+    if (captured.size() != expected.size()) {
+        std::fprintf(stderr, "第%d帧：截图尺寸%dx%d，应为%dx%d\n", index, captured.width(), captured.height(),
+                     expected.width(), expected.height());
+        return false;
+    }
+    const QImage reference = expected.convertToFormat(QImage::Format_RGB32);
+    for (int y = 0; y < reference.height(); ++y) {
+        const QRgb* got = reinterpret_cast<const QRgb*>(captured.constScanLine(y));
+        const QRgb* want = reinterpret_cast<const QRgb*>(reference.constScanLine(y));
+        for (int x = 0; x < reference.width(); ++x) {
+            if ((got[x] & 0xffffff) != (want[x] & 0xffffff)) {
+                std::fprintf(stderr, "第%d帧：(%d,%d)像素为%06x，应为%06x\n", index, x, y,
+                             unsigned(got[x] & 0xffffff), unsigned(want[x] & 0xffffff));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool expectButton(StandInWindow& stage, int expectedType, const QPoint& expectedPosition, const char* step)
+{
+    int type = 0;
+    QPoint position;
+    if (!stage.nextButtonEvent(type, position)) {
+        std::fprintf(stderr, "%s：窗口没有收到鼠标事件\n", step);
+        return false;
+    }
+    if (type != expectedType || position != expectedPosition) {
+        std::fprintf(stderr, "%s：收到%s(%d,%d)，应为%s(%d,%d)\n", step, type == ButtonPress ? "按下" : "释放",
+                     position.x(), position.y(), expectedType == ButtonPress ? "按下" : "释放",
+                     expectedPosition.x(), expectedPosition.y());
+        return false;
+    }
+    return true;
+}
+
+int runSelfTest(const QString& recordingPath)
+{
+    QVector<QImage> frames;
+    if (recordingPath.isEmpty()) {
+        frames.append(makePattern());
+    } else {
+        std::unique_ptr<FrameSource> recording = openRecordedFrames(recordingPath, false);
+        if (!recording) {
+            std::fprintf(stderr, "无法打开录制文件: %s\n", qPrintable(recordingPath));
+            return 1;
+        }
+        while (!recording->atEnd()) {
+            const QImage frame = recording->grab();
+            if (frame.isNull()) {
+                break;
+            }
+            frames.append(frame.size() == QSize(WINDOW_WIDTH, WINDOW_HEIGHT)
+                              ? frame : frame.scaled(WINDOW_WIDTH, WINDOW_HEIGHT));
+        }
+    }
+
+    StandInWindow stage;
+    if (!stage.create()) {
+        std::fprintf(stderr, "无法创建替身窗口，请在Xvfb中运行（DISPLAY=%s）\n", qgetenv("DISPLAY").constData());
+        return 1;
+    }
+    const unsigned long window = stage.window;
+
+    X11FrameSource source([window]() { return window; }, QRect(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT));
+    if (!source.isValid()) {
+        return 1;
+    }
+    bool ok = true;
+    for (int i = 0; i < frames.size() && ok; ++i) {
+        stage.show(frames[i]);
+        ok = framesMatch(source.grab(), frames[i], i);
+    }
+
+    X11InputSink x11Input([window]() { return window; });
+    if (!x11Input.isValid()) {
+        return 1;
+    }
+    RecordingInputSink recorder(&x11Input);
+    if (ok) {
+        ok = recorder.click(QPoint(287, 427))
+             && expectButton(stage, ButtonPress, QPoint(287, 427), "点击")
+             && expectButton(stage, ButtonRelease, QPoint(287, 427), "点击");
+    }
+    if (ok) {
+        ok = recorder.drag(QPoint(600, 200), 120, true)
+             && expectButton(stage, ButtonPress, QPoint(600, 200), "下拉")
+             && expectButton(stage, ButtonRelease, QPoint(600, 320), "下拉");
+    }
+    if (ok) {
+        const QVector<InputEvent> events = recorder.events();
+        ok = events.size() == 2 && events[0].type == InputEvent::Click && events[1].type == InputEvent::Drag
+             && events[1].distance == 120;
+        if (!ok) {
+            std::fprintf(stderr, "记录的输入序列不正确：%d条\n", int(events.size()));
+        }
+    }
+
+    std::printf("X11自测%s：%d帧，截图方式%s\n", ok ? "通过" : "失败", int(frames.size()),
+                source.usesSharedMemory() ? "MIT-SHM" : "XGetImage");
+    return ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    if (args.size() > 2) {
+        std::fprintf(stderr, "用法: x11_selftest [录制文件或目录]\n");
+        return 2;
+    }
+    return runSelfTest(args.size() == 2 ? args[1] : QString());
+}